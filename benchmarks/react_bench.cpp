@@ -0,0 +1,555 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <sched.h>
+
+#include "rapidjson/reader.h"
+#include "rapidjson/prettywriter.h"
+#include "rapidjson/stringbuffer.h"
+
+#include "react/react.hpp"
+
+namespace {
+
+typedef std::chrono::steady_clock bench_clock_t;
+
+/*!
+ * \brief Keeps compiler from merging or removing iterations of benchmark loops
+ */
+inline void clobber_memory() {
+	asm volatile("" : : : "memory");
+}
+
+int64_t elapsed_ns(const bench_clock_t::time_point &start_time) {
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock_t::now() - start_time).count();
+}
+
+const int ACTION = react_define_new_action("BENCH_ACTION");
+const int DISABLED_ACTION = react_define_new_action("BENCH_DISABLED_ACTION");
+
+const size_t RECURSION_DEPTH = 16;
+const size_t DEEP_RECURSION_DEPTH = 1000;
+
+/*!
+ * \brief Benchmark case, runs \a iterations of measured operation and returns their time in nanoseconds
+ */
+struct bench_case_t {
+	const char *name;
+	int64_t (*run)(size_t iterations);
+
+	/*!
+	 * \brief Number of operations made by one step of case, iterations are rounded up to multiple of it
+	 */
+	size_t step;
+};
+
+int64_t run_loop_baseline(size_t iterations) {
+	const bench_clock_t::time_point start_time = bench_clock_t::now();
+	for (size_t i = 0; i < iterations; ++i) {
+		clobber_memory();
+	}
+	return elapsed_ns(start_time);
+}
+
+int64_t run_inactive_start_stop(size_t iterations) {
+	const bench_clock_t::time_point start_time = bench_clock_t::now();
+	for (size_t i = 0; i < iterations; ++i) {
+		react_start_action(ACTION);
+		react_stop_action(ACTION);
+	}
+	return elapsed_ns(start_time);
+}
+
+int64_t run_inactive_start_stop_fast(size_t iterations) {
+	const bench_clock_t::time_point start_time = bench_clock_t::now();
+	for (size_t i = 0; i < iterations; ++i) {
+		react_start_action_fast(ACTION);
+		clobber_memory();
+		react_stop_action_fast(ACTION);
+		clobber_memory();
+	}
+	return elapsed_ns(start_time);
+}
+
+int64_t run_inactive_start_stop_fast_metrics(size_t iterations) {
+	react_set_inactive_metrics(1);
+	const int64_t time = run_inactive_start_stop_fast(iterations);
+	react_set_inactive_metrics(0);
+	return time;
+}
+
+int64_t run_inactive_action_guard(size_t iterations) {
+	const bench_clock_t::time_point start_time = bench_clock_t::now();
+	for (size_t i = 0; i < iterations; ++i) {
+		react::action_guard guard(ACTION);
+		clobber_memory();
+	}
+	return elapsed_ns(start_time);
+}
+
+int64_t run_start_stop(size_t iterations) {
+	react_activate(NULL);
+	const bench_clock_t::time_point start_time = bench_clock_t::now();
+	for (size_t i = 0; i < iterations; ++i) {
+		react_start_action(ACTION);
+		react_stop_action(ACTION);
+	}
+	const int64_t time = elapsed_ns(start_time);
+	react_deactivate();
+	return time;
+}
+
+int64_t run_action_guard(size_t iterations) {
+	react_activate(NULL);
+	const bench_clock_t::time_point start_time = bench_clock_t::now();
+	for (size_t i = 0; i < iterations; ++i) {
+		react::action_guard guard(ACTION);
+	}
+	const int64_t time = elapsed_ns(start_time);
+	react_deactivate();
+	return time;
+}
+
+int64_t run_disabled_action(size_t iterations) {
+	react_set_action_state(DISABLED_ACTION, REACT_ACTION_DISABLED);
+	react_activate(NULL);
+	const bench_clock_t::time_point start_time = bench_clock_t::now();
+	for (size_t i = 0; i < iterations; ++i) {
+		react_start_action(DISABLED_ACTION);
+		react_stop_action(DISABLED_ACTION);
+	}
+	const int64_t time = elapsed_ns(start_time);
+	react_deactivate();
+	return time;
+}
+
+void recurse_baseline(size_t depth) {
+	if (depth > 1) {
+		recurse_baseline(depth - 1);
+	}
+	clobber_memory();
+}
+
+void recurse(size_t depth) {
+	react::action_guard guard(ACTION);
+	if (depth > 1) {
+		recurse(depth - 1);
+	}
+	clobber_memory();
+}
+
+void recurse_start_stop(size_t depth) {
+	react_start_action(ACTION);
+	if (depth > 1) {
+		recurse_start_stop(depth - 1);
+	}
+	clobber_memory();
+	react_stop_action(ACTION);
+}
+
+int64_t run_recursion_baseline(size_t iterations) {
+	const bench_clock_t::time_point start_time = bench_clock_t::now();
+	for (size_t i = 0; i < iterations; i += RECURSION_DEPTH) {
+		recurse_baseline(RECURSION_DEPTH);
+	}
+	return elapsed_ns(start_time);
+}
+
+int64_t run_recursion(size_t iterations) {
+	react_activate(NULL);
+	const bench_clock_t::time_point start_time = bench_clock_t::now();
+	for (size_t i = 0; i < iterations; i += RECURSION_DEPTH) {
+		recurse(RECURSION_DEPTH);
+	}
+	const int64_t time = elapsed_ns(start_time);
+	react_deactivate();
+	return time;
+}
+
+int64_t run_recursion_start_stop(size_t iterations) {
+	react_activate(NULL);
+	const bench_clock_t::time_point start_time = bench_clock_t::now();
+	for (size_t i = 0; i < iterations; i += RECURSION_DEPTH) {
+		recurse_start_stop(RECURSION_DEPTH);
+	}
+	const int64_t time = elapsed_ns(start_time);
+	react_deactivate();
+	return time;
+}
+
+int64_t run_deep_recursion(size_t iterations) {
+	react_activate(NULL);
+	const bench_clock_t::time_point start_time = bench_clock_t::now();
+	for (size_t i = 0; i < iterations; i += DEEP_RECURSION_DEPTH) {
+		recurse_start_stop(DEEP_RECURSION_DEPTH);
+	}
+	const int64_t time = elapsed_ns(start_time);
+	react_deactivate();
+	return time;
+}
+
+int64_t run_activate_deactivate(size_t iterations) {
+	const bench_clock_t::time_point start_time = bench_clock_t::now();
+	for (size_t i = 0; i < iterations; ++i) {
+		react_activate(NULL);
+		react_deactivate();
+	}
+	return elapsed_ns(start_time);
+}
+
+int64_t run_activate_record_off(size_t iterations) {
+	react_set_record_mode(REACT_RECORD_MODE_OFF, 0);
+	const bench_clock_t::time_point start_time = bench_clock_t::now();
+	for (size_t i = 0; i < iterations; ++i) {
+		react_activate(NULL);
+		react_deactivate();
+	}
+	const int64_t time = elapsed_ns(start_time);
+	react_set_record_mode(REACT_RECORD_MODE_FULL, 1);
+	return time;
+}
+
+const bench_case_t BENCH_CASES[] = {
+	{"loop_baseline", run_loop_baseline, 1},
+	{"inactive_start_stop", run_inactive_start_stop, 1},
+	{"inactive_start_stop_fast", run_inactive_start_stop_fast, 1},
+	{"inactive_start_stop_fast_metrics", run_inactive_start_stop_fast_metrics, 1},
+	{"inactive_action_guard", run_inactive_action_guard, 1},
+	{"start_stop", run_start_stop, 1},
+	{"action_guard", run_action_guard, 1},
+	{"disabled_action", run_disabled_action, 1},
+	{"recursion_baseline", run_recursion_baseline, RECURSION_DEPTH},
+	{"recursion", run_recursion, RECURSION_DEPTH},
+	{"recursion_start_stop", run_recursion_start_stop, RECURSION_DEPTH},
+	{"deep_recursion", run_deep_recursion, DEEP_RECURSION_DEPTH},
+	{"activate_deactivate", run_activate_deactivate, 1},
+	{"activate_record_off", run_activate_record_off, 1}
+};
+
+/*!
+ * \brief Time of single operation of benchmark case over repetitions
+ */
+struct bench_result_t {
+	bench_result_t(): median(0), mad(0) {}
+
+	std::string name;
+
+	/*!
+	 * \brief Median time of operation in nanoseconds
+	 */
+	double median;
+
+	/*!
+	 * \brief Median absolute deviation of operation time from median in nanoseconds
+	 */
+	double mad;
+};
+
+struct bench_options_t {
+	bench_options_t(): warmup(3), repetitions(15), iterations(100000), cpu(-2), max_regression(10) {}
+
+	size_t warmup;
+	size_t repetitions;
+	size_t iterations;
+
+	/*!
+	 * \brief CPU where benchmarks are pinned, -1 disables pinning, -2 pins to the current CPU
+	 */
+	int cpu;
+
+	/*!
+	 * \brief Maximum allowed increase of median time over baseline in percents
+	 */
+	double max_regression;
+
+	std::string filter;
+	std::string baseline;
+	std::string output;
+};
+
+void usage(const char *program) {
+	std::cerr << "Usage: " << program << " [options]" << std::endl
+	          << "Runs react benchmarks and prints median and MAD of every case as json." << std::endl
+	          << "  --warmup N           discarded repetitions before measurement (default 3)" << std::endl
+	          << "  --repetitions N      measured repetitions (default 15)" << std::endl
+	          << "  --iterations N       operations in a repetition (default 100000)" << std::endl
+	          << "  --cpu N              pin to CPU N, -1 disables pinning (default - current CPU)" << std::endl
+	          << "  --filter STR         run only cases whose names contain STR" << std::endl
+	          << "  --output FILE        write json to FILE instead of stdout" << std::endl
+	          << "  --baseline FILE      compare with json written by previous run" << std::endl
+	          << "  --max-regression P   fail if median of a case is P percents above baseline (default 10)" << std::endl
+	          << "  --list               print names of cases" << std::endl;
+}
+
+double median(std::vector<double> values) {
+	std::sort(values.begin(), values.end());
+	const size_t middle = values.size() / 2;
+	return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+bench_result_t run_case(const bench_case_t &bench_case, const bench_options_t &options) {
+	const size_t iterations = (options.iterations + bench_case.step - 1) / bench_case.step * bench_case.step;
+
+	for (size_t i = 0; i < options.warmup; ++i) {
+		bench_case.run(iterations);
+	}
+
+	std::vector<double> times;
+	for (size_t i = 0; i < options.repetitions; ++i) {
+		times.push_back(static_cast<double>(bench_case.run(iterations)) / iterations);
+	}
+
+	bench_result_t result;
+	result.name = bench_case.name;
+	result.median = median(times);
+	for (auto it = times.begin(); it != times.end(); ++it) {
+		*it = *it > result.median ? *it - result.median : result.median - *it;
+	}
+	result.mad = median(times);
+	return result;
+}
+
+bool pin_to_cpu(int cpu) {
+	if (cpu == -2) {
+		cpu = sched_getcpu();
+	}
+	if (cpu < 0) {
+		return cpu == -1;
+	}
+
+	cpu_set_t cpu_set;
+	CPU_ZERO(&cpu_set);
+	CPU_SET(cpu, &cpu_set);
+	return sched_setaffinity(0, sizeof(cpu_set), &cpu_set) == 0;
+}
+
+std::string to_json(const std::vector<bench_result_t> &results, const bench_options_t &options) {
+	rapidjson::StringBuffer buffer;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+
+	writer.StartObject();
+	writer.String("time_unit");
+	writer.String("ns");
+	writer.String("repetitions");
+	writer.Uint64(options.repetitions);
+	writer.String("iterations");
+	writer.Uint64(options.iterations);
+	writer.String("cases");
+	writer.StartObject();
+	for (auto it = results.begin(); it != results.end(); ++it) {
+		writer.String(it->name.c_str(), it->name.size());
+		writer.StartObject();
+		writer.String("median");
+		writer.Double(it->median);
+		writer.String("mad");
+		writer.Double(it->mad);
+		writer.EndObject();
+	}
+	writer.EndObject();
+	writer.EndObject();
+
+	return std::string(buffer.GetString(), buffer.Size());
+}
+
+/*!
+ * \brief Sax handler that collects medians of cases from json written by to_json
+ */
+class baseline_handler_t {
+public:
+	typedef char Ch;
+
+	void Null() { value(); }
+	void Bool(bool) { value(); }
+	void Int(int i) { number(i); }
+	void Uint(unsigned i) { number(i); }
+	void Int64(int64_t i) { number(i); }
+	void Uint64(uint64_t i) { number(i); }
+	void Double(double d) { number(d); }
+
+	void String(const Ch *str, rapidjson::SizeType length, bool) {
+		if (!frames.empty() && frames.back().is_object && frames.back().expects_key) {
+			frames.back().key.assign(str, length);
+			frames.back().expects_key = false;
+		} else {
+			value();
+		}
+	}
+
+	void StartObject() { frames.push_back(frame_t(true)); }
+	void EndObject(rapidjson::SizeType) { frames.pop_back(); value(); }
+	void StartArray() { frames.push_back(frame_t(false)); }
+	void EndArray(rapidjson::SizeType) { frames.pop_back(); value(); }
+
+	/*!
+	 * \brief Medians of cases in nanoseconds by names of cases
+	 */
+	std::map<std::string, double> medians;
+
+private:
+	struct frame_t {
+		explicit frame_t(bool is_object): is_object(is_object), expects_key(true) {}
+
+		bool is_object;
+		bool expects_key;
+		std::string key;
+	};
+
+	void value() {
+		if (!frames.empty()) {
+			frames.back().expects_key = true;
+		}
+	}
+
+	void number(double number) {
+		if (frames.size() == 3 && frames[0].key == "cases" && frames[2].key == "median") {
+			medians[frames[1].key] = number;
+		}
+		value();
+	}
+
+	std::vector<frame_t> frames;
+};
+
+/*!
+ * \brief Prints change of every case against baseline file of \a options
+ * \return Number of cases that regressed more than allowed, -1 if baseline can't be read
+ */
+int compare_with_baseline(const std::vector<bench_result_t> &results, const bench_options_t &options) {
+	std::ifstream file(options.baseline.c_str());
+	std::stringstream content;
+	content << file.rdbuf();
+	if (!file) {
+		std::cerr << "react-bench: can't read baseline " << options.baseline << std::endl;
+		return -1;
+	}
+
+	baseline_handler_t baseline;
+	rapidjson::Reader reader;
+	const std::string json = content.str();
+	rapidjson::StringStream stream(json.c_str());
+	if (!reader.Parse<0>(stream, baseline)) {
+		std::cerr << "react-bench: malformed baseline " << options.baseline << ": "
+		          << reader.GetParseError() << std::endl;
+		return -1;
+	}
+
+	int regressions = 0;
+	fprintf(stderr, "%-28s %12s %12s %9s\n", "case", "baseline", "median", "change");
+	for (auto it = results.begin(); it != results.end(); ++it) {
+		auto baseline_case = baseline.medians.find(it->name);
+		if (baseline_case == baseline.medians.end()) {
+			fprintf(stderr, "%-28s %12s %12.2f %9s\n", it->name.c_str(), "-", it->median, "new");
+			continue;
+		}
+
+		const double baseline_median = baseline_case->second;
+		const double change = baseline_median > 0 ? (it->median - baseline_median) * 100 / baseline_median : 0;
+		const bool is_regression = change > options.max_regression;
+		regressions += is_regression;
+		fprintf(stderr, "%-28s %12.2f %12.2f %+8.1f%%%s\n", it->name.c_str(), baseline_median, it->median,
+			change, is_regression ? "  REGRESSION" : "");
+	}
+	return regressions;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	bench_options_t options;
+
+	for (int i = 1; i < argc; ++i) {
+		const bool has_value = i + 1 < argc;
+		if (!strcmp(argv[i], "--warmup") && has_value) {
+			options.warmup = strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "--repetitions") && has_value) {
+			options.repetitions = strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "--iterations") && has_value) {
+			options.iterations = strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "--cpu") && has_value) {
+			options.cpu = atoi(argv[++i]);
+		} else if (!strcmp(argv[i], "--filter") && has_value) {
+			options.filter = argv[++i];
+		} else if (!strcmp(argv[i], "--output") && has_value) {
+			options.output = argv[++i];
+		} else if (!strcmp(argv[i], "--baseline") && has_value) {
+			options.baseline = argv[++i];
+		} else if (!strcmp(argv[i], "--max-regression") && has_value) {
+			options.max_regression = atof(argv[++i]);
+		} else if (!strcmp(argv[i], "--list")) {
+			for (size_t j = 0; j < sizeof(BENCH_CASES) / sizeof(BENCH_CASES[0]); ++j) {
+				std::cout << BENCH_CASES[j].name << std::endl;
+			}
+			return 0;
+		} else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+			usage(argv[0]);
+			return 0;
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (!options.repetitions || !options.iterations) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	if (!pin_to_cpu(options.cpu)) {
+		std::cerr << "react-bench: can't pin to CPU " << options.cpu << ", running unpinned" << std::endl;
+	}
+
+	std::vector<bench_result_t> results;
+	for (size_t i = 0; i < sizeof(BENCH_CASES) / sizeof(BENCH_CASES[0]); ++i) {
+		if (std::string(BENCH_CASES[i].name).find(options.filter) != std::string::npos) {
+			results.push_back(run_case(BENCH_CASES[i], options));
+		}
+	}
+
+	const std::string json = to_json(results, options);
+	if (options.output.empty()) {
+		std::cout << json << std::endl;
+	} else {
+		std::ofstream output(options.output.c_str());
+		output << json << std::endl;
+		if (!output) {
+			std::cerr << "react-bench: can't write " << options.output << std::endl;
+			return 1;
+		}
+	}
+
+	if (!options.baseline.empty()) {
+		const int regressions = compare_with_baseline(results, options);
+		if (regressions) {
+			if (regressions > 0) {
+				std::cerr << "react-bench: " << regressions << " cases regressed by more than "
+				          << options.max_regression << "%" << std::endl;
+			}
+			return 1;
+		}
+	}
+	return 0;
+}
@@ -18,6 +18,7 @@
 #include "react/aggregator.hpp"
 
 int action_code = react_define_new_action("ACTION");
+const int STAT_RECORDS = react_define_new_stat("Records"); // Registered stat is stored by code
 
 int main() {
 	react::stream_aggregator_t aggregator(std::cout);
@@ -27,6 +28,7 @@ int main() {
 	react::add_stat("Answer", 42);
 	react::add_stat("Pi", 3.1415);
 	react::add_stat("Name", "React");
+	react::add_stat(STAT_RECORDS, int64_t(1) << 40);
 
 	react_deactivate();
 	return 0;
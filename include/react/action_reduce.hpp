@@ -0,0 +1,109 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef REACT_ACTION_REDUCE_HPP
+#define REACT_ACTION_REDUCE_HPP
+
+#include <vector>
+#include <stdint.h>
+
+#include "columnar_call_tree.hpp"
+
+namespace react {
+
+/*!
+ * \brief Implementation of reduction kernels
+ */
+enum reduce_kernel_t {
+	/*!
+	 * \brief The fastest kernel supported by CPU, selected at runtime
+	 */
+	REDUCE_KERNEL_AUTO,
+
+	/*!
+	 * \brief Portable scalar kernel
+	 */
+	REDUCE_KERNEL_SCALAR,
+
+	/*!
+	 * \brief AVX2 kernel, available only on x86 CPUs that support it
+	 */
+	REDUCE_KERNEL_AVX2
+};
+
+/*!
+ * \brief Checks whether \a kernel could be used on this CPU
+ */
+bool reduce_kernel_is_supported(reduce_kernel_t kernel);
+
+/*!
+ * \brief Returns kernel that is used for REDUCE_KERNEL_AUTO
+ */
+reduce_kernel_t get_auto_reduce_kernel();
+
+/*!
+ * \brief Per-action histogram of durations
+ *
+ * Bucket i counts durations in [bounds[i - 1], bounds[i]), first bucket counts durations below bounds[0]
+ * and last one counts durations not less than last bound, so there are bounds.size() + 1 buckets per action.
+ */
+struct action_histogram_t {
+	/*!
+	 * \brief Initializes histogram with sorted bucket \a bounds in clock ticks
+	 */
+	explicit action_histogram_t(const std::vector<int64_t> &bounds = std::vector<int64_t>()): bounds(bounds) {}
+
+	/*!
+	 * \brief Returns number of buckets per action
+	 */
+	size_t buckets_count() const {
+		return bounds.size() + 1;
+	}
+
+	/*!
+	 * \brief Returns number of durations of \a action_code in \a bucket
+	 */
+	uint64_t get_count(int action_code, size_t bucket) const {
+		size_t index = action_code * buckets_count() + bucket;
+		return index < counts.size() ? counts[index] : 0;
+	}
+
+	/*!
+	 * \brief Bucket bounds in clock ticks
+	 */
+	std::vector<int64_t> bounds;
+
+	/*!
+	 * \brief Counts of buckets, action's buckets start at action_code * buckets_count()
+	 */
+	std::vector<uint64_t> counts;
+};
+
+/*!
+ * \brief Adds durations of all actions of \a call_tree to \a summaries and \a histogram
+ *
+ * Durations and bucket indices are computed by vector kernel block by block,
+ * then they are accumulated per action while the block is still in L1 cache.
+ * \param call_tree Snapshot of call tree
+ * \param summaries Summaries indexed by action code, grown if needed
+ * \param histogram Histogram that will be updated, may be NULL
+ * \param kernel Kernel implementation
+ */
+void reduce_actions(const columnar_call_tree_t &call_tree, std::vector<action_summary_t> &summaries,
+		action_histogram_t *histogram = NULL, reduce_kernel_t kernel = REDUCE_KERNEL_AUTO);
+
+} // namespace react
+
+#endif // REACT_ACTION_REDUCE_HPP
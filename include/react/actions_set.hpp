@@ -18,13 +18,40 @@
 
 #include <iostream>
 #include <vector>
+#include <string>
+#include <unordered_map>
+#include <atomic>
 #include <stdexcept>
 #include <algorithm>
+#include <stdint.h>
 
 namespace react {
 
+/*!
+ * \brief How calls of action are handled by call tree updaters
+ */
+enum action_state_t {
+	/*!
+	 * \brief Calls are recorded as call tree nodes
+	 */
+	ACTION_ENABLED,
+
+	/*!
+	 * \brief Calls are skipped, neither nodes are created nor time is measured
+	 */
+	ACTION_DISABLED,
+
+	/*!
+	 * \brief Calls are only counted in process-wide metrics, nodes are not created
+	 */
+	ACTION_AGGREGATE_ONLY
+};
+
 /*!
  * \brief Represents set of actions that allows defining new actions and resolving action's names by their codes
+ *
+ * Also keeps registry of stat keys, so that stats could be stored in call tree by their codes
+ * instead of by their names.
  */
 class actions_set_t {
 public:
@@ -33,10 +60,30 @@ public:
 	 */
 	static const int NO_ACTION = -1;
 
+	/*!
+	 * \brief Value for representing no stat
+	 */
+	static const int NO_STAT = -1;
+
+	/*!
+	 * \brief Number of actions whose state can be changed, actions with larger codes are always enabled
+	 */
+	static const size_t MAX_MASKED_ACTIONS = 4096;
+
 	/*!
 	 * \brief Initializes empty actions set
+	 * \param has_metrics Whether calls of actions of the set are counted in process-wide metrics.
+	 * Metrics are indexed by action code, so react enables them only for its global actions set.
 	 */
-	actions_set_t() {}
+	explicit actions_set_t(bool has_metrics = false): metrics_enabled(has_metrics) {
+		for (size_t i = 0; i < MASK_WORDS; ++i) {
+			skipped_mask[i].store(0, std::memory_order_relaxed);
+			aggregated_mask[i].store(0, std::memory_order_relaxed);
+		}
+	}
+
+	actions_set_t(const actions_set_t &other) = delete;
+	actions_set_t &operator =(const actions_set_t &other) = delete;
 
 	/*!
 	 * \brief Frees memory consumed by actions set
@@ -49,12 +96,13 @@ public:
 	 * \return Newly created action's code or code of already existing action with \a action_name
 	 */
 	int define_new_action(const std::string& action_name) {
-		auto it = std::find(actions_names.begin(), actions_names.end(), action_name);
-		if (it != actions_names.end()) {
-			return std::distance(actions_names.begin(), it);
+		int action_code = get_action_code(action_name);
+		if (action_code != NO_ACTION) {
+			return action_code;
 		}
 
-		int action_code = actions_names.size();
+		action_code = actions_names.size();
+		actions_codes.insert(std::make_pair(action_name, action_code));
 		actions_names.push_back(action_name);
 		return action_code;
 	}
@@ -83,11 +131,223 @@ public:
 		return static_cast<size_t>(action_code) < actions_names.size();
 	}
 
+	/*!
+	 * \brief Gets action's code by its \a action_name
+	 * \param action_name Action's name
+	 * \return Action's code or NO_ACTION if action with \a action_name is not defined
+	 */
+	int get_action_code(const std::string& action_name) const {
+		auto it = actions_codes.find(action_name);
+		if (it != actions_codes.end()) {
+			return it->second;
+		}
+		return NO_ACTION;
+	}
+
+	/*!
+	 * \brief Checks whether calls of action with \a action_code don't create call tree nodes
+	 *
+	 * This is the check done by updaters on every start, it costs single relaxed load.
+	 * \param action_code Valid action's code
+	 */
+	bool is_skipped(int action_code) const {
+		const size_t code = action_code;
+		return code < MAX_MASKED_ACTIONS &&
+			(skipped_mask[code / 64].load(std::memory_order_relaxed) & get_bit(code));
+	}
+
+	/*!
+	 * \brief Checks whether calls of skipped action with \a action_code are counted in metrics
+	 * \param action_code Valid action's code
+	 */
+	bool is_aggregated(int action_code) const {
+		const size_t code = action_code;
+		return code < MAX_MASKED_ACTIONS &&
+			(aggregated_mask[code / 64].load(std::memory_order_relaxed) & get_bit(code));
+	}
+
+	/*!
+	 * \brief Checks whether calls of action with \a action_code are neither recorded nor counted in metrics
+	 * \param action_code Valid action's code
+	 */
+	bool is_disabled(int action_code) const {
+		return is_skipped(action_code) && !is_aggregated(action_code);
+	}
+
+	/*!
+	 * \brief Gets state of action with \a action_code
+	 * \param action_code Action's code
+	 * \return Action's state
+	 */
+	action_state_t get_action_state(int action_code) const {
+		if (!code_is_valid(action_code)) {
+			throw std::invalid_argument("Can't get state: action_code is invalid");
+		}
+
+		if (!is_skipped(action_code)) {
+			return ACTION_ENABLED;
+		}
+		return is_aggregated(action_code) ? ACTION_AGGREGATE_ONLY : ACTION_DISABLED;
+	}
+
+	/*!
+	 * \brief Changes state of action with \a action_code, can be called while actions are recorded
+	 *
+	 * Calls that are already started are finished in the state they were started with.
+	 * \param action_code Action's code
+	 * \param state New state
+	 */
+	void set_action_state(int action_code, action_state_t state) {
+		if (!code_is_valid(action_code) || static_cast<size_t>(action_code) >= MAX_MASKED_ACTIONS) {
+			throw std::invalid_argument("Can't set state: action_code is invalid");
+		}
+
+		const size_t code = action_code;
+		const uint64_t bit = get_bit(code);
+		switch (state) {
+		case ACTION_ENABLED:
+			skipped_mask[code / 64].fetch_and(~bit, std::memory_order_relaxed);
+			aggregated_mask[code / 64].fetch_and(~bit, std::memory_order_relaxed);
+			break;
+		case ACTION_DISABLED:
+			aggregated_mask[code / 64].fetch_and(~bit, std::memory_order_relaxed);
+			skipped_mask[code / 64].fetch_or(bit, std::memory_order_relaxed);
+			break;
+		case ACTION_AGGREGATE_ONLY:
+			aggregated_mask[code / 64].fetch_or(bit, std::memory_order_relaxed);
+			skipped_mask[code / 64].fetch_or(bit, std::memory_order_relaxed);
+			break;
+		default:
+			throw std::invalid_argument("Can't set state: state is invalid");
+		}
+	}
+
+	/*!
+	 * \brief Parses action state "enabled", "disabled" or "aggregate"
+	 * \param str String with state
+	 * \param state Where parsed state is written
+	 * \return True if \a str is valid state, false otherwise
+	 */
+	static bool parse_action_state(const std::string &str, action_state_t &state) {
+		if (str == "enabled") {
+			state = ACTION_ENABLED;
+		} else if (str == "disabled") {
+			state = ACTION_DISABLED;
+		} else if (str == "aggregate") {
+			state = ACTION_AGGREGATE_ONLY;
+		} else {
+			return false;
+		}
+		return true;
+	}
+
+	/*!
+	 * \brief Defines new stat key if stat with the same name doesn't exist
+	 * \param stat_name New stat's name
+	 * \return Newly created stat's code or code of already existing stat with \a stat_name
+	 */
+	int define_new_stat(const std::string& stat_name) {
+		int stat_code = get_stat_code(stat_name);
+		if (stat_code != NO_STAT) {
+			return stat_code;
+		}
+
+		stat_code = stats_names.size();
+		stats_codes.insert(std::make_pair(stat_name, stat_code));
+		stats_names.push_back(stat_name);
+		return stat_code;
+	}
+
+	/*!
+	 * \brief Gets stat's code by its \a stat_name
+	 *
+	 * Called by every add_stat with stat name, so lookup is done in hash index.
+	 * \param stat_name Stat's name
+	 * \return Stat's code or NO_STAT if stat with \a stat_name is not defined
+	 */
+	int get_stat_code(const std::string& stat_name) const {
+		auto it = stats_codes.find(stat_name);
+		if (it != stats_codes.end()) {
+			return it->second;
+		}
+		return NO_STAT;
+	}
+
+	/*!
+	 * \brief Gets stat's name by its \a stat_code
+	 * \param stat_code Stat's code
+	 * \return Stat's name
+	 */
+	const std::string &get_stat_name(int stat_code) const {
+		if (!stat_code_is_valid(stat_code)) {
+			throw std::invalid_argument("Can't get name: stat_code is invalid");
+		}
+		return stats_names.at(stat_code);
+	}
+
+	/*!
+	 * \brief Checks whether \a stat_code is registred in actions_set
+	 * \param stat_code Stat's code for checking
+	 * \return True if \a stat_code is registred, false otherwise
+	 */
+	bool stat_code_is_valid(int stat_code) const {
+		if (stat_code == NO_STAT) {
+			return false;
+		}
+		return static_cast<size_t>(stat_code) < stats_names.size();
+	}
+
+	/*!
+	 * \brief Checks whether calls of actions of the set are counted in process-wide metrics
+	 */
+	bool has_metrics() const {
+		return metrics_enabled;
+	}
+
 private:
+	/*!
+	 * \brief Number of words in masks of actions states
+	 */
+	static const size_t MASK_WORDS = MAX_MASKED_ACTIONS / 64;
+
+	static uint64_t get_bit(size_t action_code) {
+		return 1ULL << (action_code % 64);
+	}
+
 	/*!
 	 * \brief Map between actions codes and actions names
 	 */
 	std::vector<std::string> actions_names;
+
+	/*!
+	 * \brief Index of actions codes by actions names
+	 */
+	std::unordered_map<std::string, int> actions_codes;
+
+	/*!
+	 * \brief Map between stats codes and stats names
+	 */
+	std::vector<std::string> stats_names;
+
+	/*!
+	 * \brief Index of stats codes by stats names
+	 */
+	std::unordered_map<std::string, int> stats_codes;
+
+	/*!
+	 * \brief Bits of actions that don't create nodes, i.e. disabled or aggregate only
+	 */
+	std::atomic<uint64_t> skipped_mask[MASK_WORDS];
+
+	/*!
+	 * \brief Bits of skipped actions whose calls are counted in metrics
+	 */
+	std::atomic<uint64_t> aggregated_mask[MASK_WORDS];
+
+	/*!
+	 * \brief Whether calls of actions of the set are counted in process-wide metrics
+	 */
+	const bool metrics_enabled;
 };
 
 } // namespace react
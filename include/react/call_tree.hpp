@@ -22,10 +22,15 @@
 #include "rapidjson/stringbuffer.h"
 
 #include "actions_set.hpp"
+#include "memory_usage.hpp"
+#include "trace_id.hpp"
 
 #include <unordered_map>
 #include <vector>
 #include <mutex>
+#include <chrono>
+#include <limits>
+#include <type_traits>
 
 #include <boost/variant.hpp>
 
@@ -37,6 +42,8 @@ namespace react {
 typedef boost::variant<
 	bool,
 	int,
+	int64_t,
+	uint64_t,
 	double,
 	std::string
 > stat_value_t;
@@ -52,30 +59,288 @@ struct JsonRenderer : boost::static_visitor<>
 
 	void operator () (bool value) const
 	{
-		stat_value.AddMember(key.c_str(), value, allocator);
+		rapidjson::Value json_value(value);
+		add_member(json_value);
 	}
 
 	void operator () (int value) const
 	{
-		stat_value.AddMember(key.c_str(), value, allocator);
+		rapidjson::Value json_value(value);
+		add_member(json_value);
+	}
+
+	void operator () (int64_t value) const
+	{
+		rapidjson::Value json_value(value);
+		add_member(json_value);
+	}
+
+	void operator () (uint64_t value) const
+	{
+		rapidjson::Value json_value(value);
+		add_member(json_value);
 	}
 
 	void operator () (double value) const
 	{
-		stat_value.AddMember(key.c_str(), value, allocator);
+		rapidjson::Value json_value(value);
+		add_member(json_value);
 	}
 
 	void operator () (const std::string& value) const
 	{
-		stat_value.AddMember(key.c_str(), value.c_str(), allocator);
+		rapidjson::Value json_value(value.c_str(), value.size(), allocator);
+		add_member(json_value);
 	}
 
 private:
-	std::string key;
+	/*!
+	 * \internal
+	 *
+	 * \brief Adds member with copied key, so json doesn't reference renderer's memory
+	 */
+	void add_member(rapidjson::Value &value) const {
+		rapidjson::Value name(key.c_str(), key.size(), allocator);
+		stat_value.AddMember(name, value, allocator);
+	}
+
+	const std::string &key;
 	rapidjson::Value &stat_value;
 	rapidjson::Document::AllocatorType &allocator;
 };
 
+/*!
+ * \brief Describes how stat value is updated and how it is merged from subthread trees
+ */
+enum stat_kind_t {
+	/*!
+	 * \brief Stat is not set
+	 */
+	STAT_NONE,
+
+	/*!
+	 * \brief Value is overwritten on update, on merge it is copied only if target doesn't have it
+	 */
+	STAT_VALUE,
+
+	/*!
+	 * \brief Value is incremented on update and summed on merge
+	 */
+	STAT_COUNTER,
+
+	/*!
+	 * \brief Maximum of all updates, merged by maximum
+	 */
+	STAT_MAX,
+
+	/*!
+	 * \brief Minimum of all updates, merged by minimum
+	 */
+	STAT_MIN
+};
+
+/*!
+ * \brief Unit of action times in serialized call tree
+ */
+enum time_unit_t {
+	/*!
+	 * \brief Nanoseconds since epoch, "ns" in json
+	 */
+	TIME_UNIT_NANOSECONDS,
+
+	/*!
+	 * \brief Microseconds since epoch, "us" in json
+	 */
+	TIME_UNIT_MICROSECONDS,
+
+	/*!
+	 * \brief Milliseconds since epoch, "ms" in json
+	 */
+	TIME_UNIT_MILLISECONDS
+};
+
+/*!
+ * \brief Returns name of \a unit used in json
+ */
+inline const char *get_time_unit_name(time_unit_t unit) {
+	switch (unit) {
+	case TIME_UNIT_NANOSECONDS:
+		return "ns";
+	case TIME_UNIT_MILLISECONDS:
+		return "ms";
+	default:
+		return "us";
+	}
+}
+
+/*!
+ * \brief Checks whether stat of type \a T could be used in counters and gauges
+ */
+template<typename T>
+struct is_numeric_stat : std::integral_constant<bool,
+		std::is_arithmetic<T>::value && !std::is_same<T, bool>::value> {};
+
+/*!
+ * \brief Helper structure for applying counter or gauge update to stat_value_t
+ */
+struct stat_updater_t : boost::static_visitor<>
+{
+	stat_updater_t(stat_kind_t kind): kind(kind) {}
+
+	template<typename V, typename T>
+	typename std::enable_if<is_numeric_stat<V>::value && is_numeric_stat<T>::value>::type
+	operator () (V &value, const T &operand) const
+	{
+		if (!converts_exactly<V>(operand)) {
+			throw std::invalid_argument("Can't update stat: value doesn't fit into type of the stat");
+		}
+
+		V converted = static_cast<V>(operand);
+		switch (kind) {
+		case STAT_COUNTER:
+			value += converted;
+			break;
+		case STAT_MAX:
+			value = std::max(value, converted);
+			break;
+		case STAT_MIN:
+			value = std::min(value, converted);
+			break;
+		default:
+			value = converted;
+			break;
+		}
+	}
+
+	template<typename V, typename T>
+	typename std::enable_if<!(is_numeric_stat<V>::value && is_numeric_stat<T>::value)>::type
+	operator () (V &, const T &) const
+	{
+		throw std::invalid_argument("Can't update stat: counters and gauges must be numeric");
+	}
+
+private:
+	/*!
+	 * \internal
+	 *
+	 * \brief Checks whether \a operand is represented by type \a V without loss, e.g. 0.5 is not an integer
+	 */
+	template<typename V, typename T>
+	static bool converts_exactly(const T &operand) {
+		if (std::is_same<V, T>::value) {
+			return true;
+		}
+
+		// Floating values out of integer range can't be even converted
+		if (!fits<V>(operand, std::integral_constant<bool,
+					std::is_floating_point<T>::value && std::is_integral<V>::value>())) {
+			return false;
+		}
+		const V converted = static_cast<V>(operand);
+		if (!fits<T>(converted, std::integral_constant<bool,
+					std::is_floating_point<V>::value && std::is_integral<T>::value>())) {
+			return false;
+		}
+		return static_cast<T>(converted) == operand && is_negative(converted) == is_negative(operand);
+	}
+
+	template<typename I, typename F>
+	static bool fits(const F &value, std::true_type) {
+		return value >= static_cast<F>(std::numeric_limits<I>::min()) &&
+			value < static_cast<F>(std::numeric_limits<I>::max());
+	}
+
+	template<typename I, typename F>
+	static bool fits(const F &, std::false_type) {
+		return true;
+	}
+
+	template<typename T>
+	static bool is_negative(const T &value) {
+		return is_negative(value, std::is_signed<T>());
+	}
+
+	template<typename T>
+	static bool is_negative(const T &value, std::true_type) {
+		return value < 0;
+	}
+
+	template<typename T>
+	static bool is_negative(const T &, std::false_type) {
+		return false;
+	}
+
+	stat_kind_t kind;
+};
+
+/*!
+ * \brief Helper structure for checking whether stat_value_t holds numeric value
+ */
+struct numeric_stat_checker_t : boost::static_visitor<bool>
+{
+	template<typename T>
+	bool operator () (const T &) const
+	{
+		return is_numeric_stat<T>::value;
+	}
+};
+
+/*!
+ * \brief Slot of stats storage, keeps value of the stat and the way it is updated
+ */
+struct stat_t {
+	/*!
+	 * \brief Initializes empty stat slot
+	 */
+	stat_t(): kind(STAT_NONE) {}
+
+	/*!
+	 * \brief Checks whether stat was set
+	 * \return True if stat was set, false otherwise
+	 */
+	bool is_set() const {
+		return kind != STAT_NONE;
+	}
+
+	/*!
+	 * \brief Updates stat with \a operand according to \a update_kind
+	 * \param update_kind Kind of update: value, counter, max or min
+	 * \param operand Value used for update
+	 */
+	void update(stat_kind_t update_kind, const stat_value_t &operand) {
+		if (update_kind == STAT_VALUE || !is_set()) {
+			if (update_kind != STAT_VALUE && !boost::apply_visitor(numeric_stat_checker_t(), operand)) {
+				throw std::invalid_argument("Can't update stat: counters and gauges must be numeric");
+			}
+			value = operand;
+		} else {
+			boost::apply_visitor(stat_updater_t(update_kind), value, operand);
+		}
+		kind = update_kind;
+	}
+
+	/*!
+	 * \brief Merges \a other stat into this one according to \a other stat's kind
+	 * \param other Stat which will be merged
+	 */
+	void merge(const stat_t &other) {
+		if (!other.is_set() || (other.kind == STAT_VALUE && is_set())) {
+			return;
+		}
+		update(other.kind, other.value);
+	}
+
+	/*!
+	 * \brief Kind of the stat
+	 */
+	stat_kind_t kind;
+
+	/*!
+	 * \brief Value of the stat
+	 */
+	stat_value_t value;
+};
+
 /*!
  * \brief Represents node of call tree
  */
@@ -85,6 +350,11 @@ struct node_t {
 	 */
 	typedef std::vector<std::pair<int, size_t>> Container;
 
+	/*!
+	 * \brief Type of container where node's stats are stored by their codes
+	 */
+	typedef std::vector<std::pair<int, stat_t>> Stats;
+
 	/*!
 	 * \brief Pointer to node type
 	 */
@@ -102,12 +372,12 @@ struct node_t {
 	int action_code;
 
 	/*!
-	 * \brief Time when node action was started
+	 * \brief Time when node action was started, in clock ticks since tree's base time
 	 */
 	int64_t start_time;
 
 	/*!
-	 * \brief Time when node action was stopped
+	 * \brief Time when node action was stopped, in clock ticks since tree's base time
 	 */
 	int64_t stop_time;
 
@@ -115,6 +385,11 @@ struct node_t {
 	 * \brief Child nodes, actions that happen inside this action
 	 */
 	Container links;
+
+	/*!
+	 * \brief Stats attached to this action
+	 */
+	Stats stats;
 };
 
 /*!
@@ -124,11 +399,24 @@ struct node_t {
  * - Action code
  * - Time when action was started
  * - Time when action was stopped
+ *
+ * Times are stored as raw clock ticks relative to tree's base time
+ * and are converted to tree's time unit since epoch only on serialization.
  */
 class call_tree_t {
 public:
 	typedef node_t::pointer p_node_t;
 
+	/*!
+	 * \brief Clock used for timing actions
+	 */
+	typedef std::chrono::system_clock time_clock_t;
+
+	/*!
+	 * \brief Time point type
+	 */
+	typedef time_clock_t::time_point time_point_t;
+
 	/*!
 	 * \brief Value for representing null node pointer
 	 */
@@ -139,18 +427,92 @@ public:
 	 */
 	p_node_t root;
 
+	/*!
+	 * \brief Default maximum number of nodes in the tree, nodes are not limited
+	 */
+	static const size_t DEFAULT_MAX_NODES = -1;
+
+	/*!
+	 * \brief Granularity in which memory used by the tree is reported to process-wide account
+	 */
+	static const size_t MEMORY_REPORT_STEP = 4096;
+
 	/*!
 	 * \brief Initializes call tree with single root node and specified actions set
 	 * \param actions_set Set of available actions for monitoring in call tree
 	 */
-	call_tree_t(const actions_set_t &actions_set): actions_set(actions_set) {
+	call_tree_t(const actions_set_t &actions_set):
+		base_time(time_clock_t::now().time_since_epoch().count()),
+		time_unit(TIME_UNIT_MICROSECONDS), max_nodes(DEFAULT_MAX_NODES),
+		dropped_nodes(0), dropped_time(0), actions_set(actions_set),
+		memory_size(0), reported_memory_size(0) {
 		root = new_node(+actions_set_t::NO_ACTION);
+		account_memory(memory_size, compute_memory_size());
+	}
+
+	/*!
+	 * \brief Copies \a other tree, copy has its own account of used memory
+	 */
+	call_tree_t(const call_tree_t &other):
+		root(other.root), nodes(other.nodes),
+		id(other.id), trace_id(other.trace_id), parent_id(other.parent_id),
+		base_time(other.base_time), time_unit(other.time_unit), max_nodes(other.max_nodes),
+		dropped_nodes(other.dropped_nodes), dropped_time(other.dropped_time), actions_set(other.actions_set),
+		registered_stats(other.registered_stats), stats(other.stats),
+		memory_size(0), reported_memory_size(0) {
+		account_memory(0, compute_memory_size());
 	}
 
 	/*!
 	 * \brief Frees memory consumed by call tree
 	 */
-	~call_tree_t() {}
+	~call_tree_t() {
+		memory_usage().sub(reported_memory_size);
+	}
+
+	/*!
+	 * \brief Removes all nodes except root, all stats and ids. Keeps allocated storage for reuse.
+	 */
+	void clear() {
+		nodes.erase(nodes.begin() + 1, nodes.end());
+		nodes[root].links.clear();
+		nodes[root].stats.clear();
+		nodes[root].start_time = 0;
+		nodes[root].stop_time = 0;
+		base_time = time_clock_t::now().time_since_epoch().count();
+		time_unit = TIME_UNIT_MICROSECONDS;
+		max_nodes = DEFAULT_MAX_NODES;
+		dropped_nodes = 0;
+		dropped_time = 0;
+
+		for (auto it = registered_stats.begin(); it != registered_stats.end(); ++it) {
+			it->kind = STAT_NONE;
+		}
+		stats.clear();
+
+		id = trace_id_t();
+		trace_id = trace_id_t();
+		parent_id = trace_id_t();
+
+		account_memory(memory_size, compute_memory_size());
+	}
+
+	/*!
+	 * \brief Checks whether tree has no actions and no stats
+	 * \return True if nothing was recorded in the tree, false otherwise
+	 */
+	bool empty() const {
+		if (nodes.size() > 1 || dropped_nodes || !stats.empty()) {
+			return false;
+		}
+
+		for (auto it = registered_stats.begin(); it != registered_stats.end(); ++it) {
+			if (it->is_set()) {
+				return false;
+			}
+		}
+		return true;
+	}
 
 	/*!
 	 * \brief Returns actions set monitored by this tree
@@ -178,97 +540,518 @@ public:
 		return nodes[node].action_code;
 	}
 
+	/*!
+	 * \brief Returns number of nodes in the tree including root
+	 */
+	size_t get_nodes_count() const {
+		return nodes.size();
+	}
+
+	/*!
+	 * \brief Returns base time of the tree, in clock ticks since epoch
+	 */
+	int64_t get_base_time() const {
+		return base_time;
+	}
+
+	/*!
+	 * \brief Sets base time of the tree, node times are not changed
+	 * \param time Clock ticks since epoch
+	 */
+	void set_base_time(int64_t time) {
+		base_time = time;
+	}
+
+	/*!
+	 * \brief Converts \a time to node time of this tree
+	 * \param time Time point of tree's clock
+	 * \return Clock ticks since tree's base time
+	 */
+	int64_t to_node_time(const time_point_t &time) const {
+		return time.time_since_epoch().count() - base_time;
+	}
+
+	/*!
+	 * \brief Returns unit of action times in serialized tree
+	 */
+	time_unit_t get_time_unit() const {
+		return time_unit;
+	}
+
+	/*!
+	 * \brief Sets unit of action times in serialized tree, stored times are not changed
+	 */
+	void set_time_unit(time_unit_t unit) {
+		time_unit = unit;
+	}
+
+	/*!
+	 * \brief Converts node time of this tree to tree's time unit since epoch
+	 * \param time Clock ticks since tree's base time
+	 * \return Time since epoch in tree's time unit
+	 */
+	int64_t node_time_to_unit(int64_t time) const {
+		return duration_to_unit(base_time + time);
+	}
+
+	/*!
+	 * \brief Converts \a duration in clock ticks to tree's time unit
+	 */
+	int64_t duration_to_unit(int64_t ticks) const {
+		time_clock_t::duration duration(ticks);
+		switch (time_unit) {
+		case TIME_UNIT_NANOSECONDS:
+			return std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count();
+		case TIME_UNIT_MILLISECONDS:
+			return std::chrono::duration_cast<std::chrono::milliseconds>(duration).count();
+		default:
+			return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+		}
+	}
+
 	/*!
 	 * \brief Sets time when action represented by \a node was started
 	 * \param node Action's node
-	 * \param time Time when action was started
+	 * \param time Time when action was started, in microseconds since epoch
 	 */
 	void set_node_start_time(p_node_t node, int64_t time) {
-		nodes[node].start_time = time;
+		nodes[node].start_time = microseconds_to_node_time(time);
 	}
 
 	/*!
 	 * \brief Sets time when action represented by \a node was stopped
 	 * \param node Action's node
-	 * \param time Time when action was stopped
+	 * \param time Time when action was stopped, in microseconds since epoch
 	 */
 	void set_node_stop_time(p_node_t node, int64_t time) {
-		nodes[node].stop_time = time;
+		nodes[node].stop_time = microseconds_to_node_time(time);
 	}
 
 	/*!
 	 * \brief Returns start time of action represented by \a node
 	 * \param node Action's node
-	 * \return Start time of action
+	 * \return Start time of action in microseconds since epoch, 0 if it isn't set
 	 */
 	int64_t get_node_start_time(p_node_t node) const {
-		return nodes[node].start_time;
+		return node_time_to_microseconds(nodes[node].start_time);
 	}
 
 	/*!
 	 * \brief Returns stop time of action represented by \a node
 	 * \param node Action's node
-	 * \return Stop time of action
+	 * \return Stop time of action in microseconds since epoch, 0 if it isn't set
 	 */
 	int64_t get_node_stop_time(p_node_t node) const {
-		return nodes[node].stop_time;
+		return node_time_to_microseconds(nodes[node].stop_time);
 	}
 
 	/*!
-	 * \brief Adds new child with \a action_code to \a node
-	 * \param node Target parent node
-	 * \param action_code Child's action code
-	 * \return Pointer to newly created child
+	 * \brief Sets time when action represented by \a node was started
+	 * \param node Action's node
+	 * \param time Time when action was started, in clock ticks since tree's base time
 	 */
-	p_node_t add_new_link(p_node_t node, int action_code) {
-		if (!actions_set.code_is_valid(action_code)) {
-			throw std::invalid_argument("Can't add new link: action code is invalid");
-		}
+	void set_node_start_ticks(p_node_t node, int64_t time) {
+		nodes[node].start_time = time;
+	}
 
-		p_node_t action_node = new_node(action_code);
-		nodes[node].links.push_back(std::make_pair(action_code, action_node));
-		return action_node;
+	/*!
+	 * \brief Sets time when action represented by \a node was stopped
+	 * \param node Action's node
+	 * \param time Time when action was stopped, in clock ticks since tree's base time
+	 */
+	void set_node_stop_ticks(p_node_t node, int64_t time) {
+		nodes[node].stop_time = time;
 	}
 
-	template<typename T>
-	void add_stat(const std::string &key, T value) {
-		stats[key] = value;
+	/*!
+	 * \brief Returns start time of action represented by \a node
+	 * \param node Action's node
+	 * \return Start time of action in clock ticks since tree's base time
+	 */
+	int64_t get_node_start_ticks(p_node_t node) const {
+		return nodes[node].start_time;
 	}
 
-	void add_stat(const std::string &key, const char *value) {
-		stats[key] = std::string(value);
+	/*!
+	 * \brief Returns stop time of action represented by \a node
+	 * \param node Action's node
+	 * \return Stop time of action in clock ticks since tree's base time
+	 */
+	int64_t get_node_stop_ticks(p_node_t node) const {
+		return nodes[node].stop_time;
 	}
 
-	bool has_stat(const std::string &key) const {
-		return stats.find(key) != stats.end();
+	/*!
+	 * \brief Returns approximate number of bytes used by the tree: nodes, links, stats and their strings
+	 *
+	 * Storage kept by clear() for reuse is counted too.
+	 */
+	size_t get_memory_size() const {
+		return memory_size;
 	}
 
-	template<typename T>
-	const T &get_stat(const std::string &key) const {
-		return boost::get<T>(stats.at(key));
+	/*!
+	 * \brief Returns maximum number of nodes in the tree including root
+	 */
+	size_t get_max_nodes() const {
+		return max_nodes;
 	}
 
 	/*!
-	 * \brief Converts call tree to json
-	 * \param stat_value Json node for writing
-	 * \param allocator Json allocator
-	 * \return Modified json node
+	 * \brief Limits number of nodes in the tree, actions started after the limit is reached are dropped
+	 *
+	 * Limit bounds memory consumed by a single tree regardless of how many actions are started,
+	 * e.g. in a loop over millions of keys. Nodes that are already in the tree are kept.
+	 * \param max_nodes Maximum number of nodes including root
 	 */
-	rapidjson::Value& to_json(rapidjson::Value &stat_value,
-							  rapidjson::Document::AllocatorType &allocator) const {
-		return to_json(root, stat_value, allocator);
+	void set_max_nodes(size_t max_nodes) {
+		this->max_nodes = max_nodes;
 	}
 
 	/*!
-	 * \brief Recursively merges this tree into \a rhs_node
-	 * \param rhs_node Node in which this tree will be merged
-	 * \param rhs_tree Tree in which this tree will be merged
+	 * \brief Checks whether node limit is reached and no new links can be added
 	 */
-	void merge_into(call_tree_t::p_node_t rhs_node, call_tree_t& rhs_tree) const {
-		merge_into(root, rhs_node, rhs_tree);
+	bool is_full() const {
+		return nodes.size() >= max_nodes;
+	}
+
+	/*!
+	 * \brief Accounts actions that were not added to the tree because of node limit
+	 * \param count Number of dropped actions
+	 * \param time Time spent in dropped actions, in clock ticks, nested actions are not counted twice
+	 */
+	void add_dropped_nodes(size_t count, int64_t time) {
+		dropped_nodes += count;
+		dropped_time += time;
+	}
+
+	/*!
+	 * \brief Returns number of actions dropped because of node limit
+	 */
+	size_t get_dropped_nodes() const {
+		return dropped_nodes;
+	}
+
+	/*!
+	 * \brief Returns time spent in dropped actions, in clock ticks
+	 */
+	int64_t get_dropped_time() const {
+		return dropped_time;
+	}
+
+	/*!
+	 * \brief Checks whether some actions were dropped because of node limit
+	 */
+	bool is_truncated() const {
+		return dropped_nodes != 0;
+	}
+
+	/*!
+	 * \brief Adds new child with \a action_code to \a node
+	 * \param node Target parent node
+	 * \param action_code Child's action code
+	 * \return Pointer to newly created child
+	 */
+	p_node_t add_new_link(p_node_t node, int action_code) {
+		if (!actions_set.code_is_valid(action_code)) {
+			throw std::invalid_argument("Can't add new link: action code is invalid");
+		}
+
+		p_node_t action_node = new_node(action_code);
+		node_t::Container &links = nodes[node].links;
+		const size_t capacity = links.capacity();
+		links.push_back(std::make_pair(action_code, action_node));
+		if (links.capacity() != capacity) {
+			account_memory(capacity * sizeof(links[0]), links.capacity() * sizeof(links[0]));
+		}
+		return action_node;
+	}
+
+	/*!
+	 * \brief Sets stat with registered \a stat_code to \a value
+	 * \param stat_code Code of stat defined in actions set
+	 * \param value Value of stat
+	 */
+	template<typename T>
+	void add_stat(int stat_code, T value) {
+		stat_t &stat = get_stat_slot(stat_code);
+		const size_t heap_size = get_heap_size(stat.value);
+		stat.value = value;
+		stat.kind = STAT_VALUE;
+		account_memory(heap_size, get_heap_size(stat.value));
+	}
+
+	void add_stat(int stat_code, const char *value) {
+		add_stat(stat_code, std::string(value));
+	}
+
+	/*!
+	 * \brief Sets stat with name \a key to \a value
+	 *
+	 * Slow path: if \a key is registered in actions set, stat is stored by its code.
+	 * \param key Name of stat
+	 * \param value Value of stat
+	 */
+	template<typename T>
+	void add_stat(const std::string &key, T value) {
+		int stat_code = actions_set.get_stat_code(key);
+		if (stat_code != actions_set_t::NO_STAT) {
+			add_stat(stat_code, value);
+			return;
+		}
+
+		auto it = stats.find(key);
+		if (it == stats.end()) {
+			insert_stat(key, stat_value_t(value));
+			return;
+		}
+		const size_t heap_size = get_heap_size(it->second);
+		it->second = value;
+		account_memory(heap_size, get_heap_size(it->second));
+	}
+
+	void add_stat(const std::string &key, const char *value) {
+		add_stat(key, std::string(value));
+	}
+
+	bool has_stat(int stat_code) const {
+		return static_cast<size_t>(stat_code) < registered_stats.size() &&
+				registered_stats[stat_code].is_set();
+	}
+
+	bool has_stat(const std::string &key) const {
+		int stat_code = actions_set.get_stat_code(key);
+		if (stat_code != actions_set_t::NO_STAT) {
+			return has_stat(stat_code);
+		}
+		return stats.find(key) != stats.end();
+	}
+
+	template<typename T>
+	const T &get_stat(int stat_code) const {
+		if (!has_stat(stat_code)) {
+			throw std::out_of_range("Can't get stat: stat is not set: "
+						+ std::to_string(static_cast<long long>(stat_code)));
+		}
+		return boost::get<T>(registered_stats[stat_code].value);
+	}
+
+	template<typename T>
+	const T &get_stat(const std::string &key) const {
+		int stat_code = actions_set.get_stat_code(key);
+		if (stat_code != actions_set_t::NO_STAT) {
+			return get_stat<T>(stat_code);
+		}
+		return boost::get<T>(stats.at(key));
+	}
+
+	/*!
+	 * \brief Returns slots of tree stats registered in actions set, indexed by stat code
+	 */
+	const std::vector<stat_t> &get_registered_stats() const {
+		return registered_stats;
+	}
+
+	/*!
+	 * \brief Returns tree stats with names that are not registered in actions set
+	 */
+	const std::unordered_map<std::string, stat_value_t> &get_unregistered_stats() const {
+		return stats;
+	}
+
+	/*!
+	 * \brief Updates stat with registered \a stat_code by \a kind: overwrites, increments or keeps max/min
+	 *
+	 * Stat keeps type of its first value, later values are converted to it.
+	 * \param stat_code Code of stat defined in actions set
+	 * \param kind Kind of update
+	 * \param value Value used for update
+	 * \throw std::invalid_argument if stat is not numeric or \a value doesn't fit into its type without loss
+	 */
+	void update_stat(int stat_code, stat_kind_t kind, const stat_value_t &value) {
+		stat_t &stat = get_stat_slot(stat_code);
+		const size_t heap_size = get_heap_size(stat.value);
+		stat.update(kind, value);
+		account_memory(heap_size, get_heap_size(stat.value));
+	}
+
+	/*!
+	 * \brief Increments counter with \a stat_code by \a delta
+	 */
+	template<typename T>
+	void increment_stat(int stat_code, T delta) {
+		update_stat(stat_code, STAT_COUNTER, stat_value_t(delta));
+	}
+
+	/*!
+	 * \brief Keeps maximum of \a value and current value of stat with \a stat_code
+	 */
+	template<typename T>
+	void update_stat_max(int stat_code, T value) {
+		update_stat(stat_code, STAT_MAX, stat_value_t(value));
+	}
+
+	/*!
+	 * \brief Keeps minimum of \a value and current value of stat with \a stat_code
+	 */
+	template<typename T>
+	void update_stat_min(int stat_code, T value) {
+		update_stat(stat_code, STAT_MIN, stat_value_t(value));
+	}
+
+	/*!
+	 * \brief Updates stat of \a node, stats of root node are stats of the whole tree
+	 * \param node Target node
+	 * \param stat_code Code of stat defined in actions set
+	 * \param kind Kind of update
+	 * \param value Value used for update
+	 */
+	void update_node_stat(p_node_t node, int stat_code, stat_kind_t kind, const stat_value_t &value) {
+		stat_t &stat = get_node_stat_slot(node, stat_code);
+		const size_t heap_size = get_heap_size(stat.value);
+		stat.update(kind, value);
+		account_memory(heap_size, get_heap_size(stat.value));
+	}
+
+	/*!
+	 * \brief Increments counter with \a stat_code of \a node by \a delta
+	 */
+	template<typename T>
+	void increment_node_stat(p_node_t node, int stat_code, T delta) {
+		update_node_stat(node, stat_code, STAT_COUNTER, stat_value_t(delta));
+	}
+
+	/*!
+	 * \brief Returns stats attached to \a node
+	 * \param node Target node
+	 * \return Stats of the node
+	 */
+	const node_t::Stats &get_node_stats(p_node_t node) const {
+		return nodes[node].stats;
+	}
+
+	bool has_node_stat(p_node_t node, int stat_code) const {
+		if (node == root) {
+			return has_stat(stat_code);
+		}
+		return find_node_stat(node, stat_code) != NULL;
+	}
+
+	template<typename T>
+	const T &get_node_stat(p_node_t node, int stat_code) const {
+		if (node == root) {
+			return get_stat<T>(stat_code);
+		}
+
+		const stat_t *stat = find_node_stat(node, stat_code);
+		if (!stat) {
+			throw std::out_of_range("Can't get node stat: stat is not set: "
+						+ std::to_string(static_cast<long long>(stat_code)));
+		}
+		return boost::get<T>(stat->value);
+	}
+
+	/*!
+	 * \brief Returns identifier of this call tree
+	 */
+	const trace_id_t &get_id() const {
+		return id;
+	}
+
+	/*!
+	 * \brief Sets identifier of this call tree
+	 */
+	void set_id(const trace_id_t &id) {
+		this->id = id;
+	}
+
+	/*!
+	 * \brief Returns identifier of the trace which this call tree belongs to
+	 */
+	const trace_id_t &get_trace_id() const {
+		return trace_id;
+	}
+
+	/*!
+	 * \brief Sets identifier of the trace which this call tree belongs to
+	 */
+	void set_trace_id(const trace_id_t &trace_id) {
+		this->trace_id = trace_id;
+	}
+
+	/*!
+	 * \brief Returns identifier of the call tree which caused this one, e.g. in another service
+	 */
+	const trace_id_t &get_parent_id() const {
+		return parent_id;
+	}
+
+	/*!
+	 * \brief Sets identifier of the call tree which caused this one
+	 */
+	void set_parent_id(const trace_id_t &parent_id) {
+		this->parent_id = parent_id;
+	}
+
+	/*!
+	 * \brief Converts call tree to json
+	 * \param stat_value Json node for writing
+	 * \param allocator Json allocator
+	 * \return Modified json node
+	 */
+	rapidjson::Value& to_json(rapidjson::Value &stat_value,
+							  rapidjson::Document::AllocatorType &allocator) const {
+		return to_json(root, stat_value, allocator);
+	}
+
+	/*!
+	 * \brief Recursively merges this tree into \a rhs_node
+	 *
+	 * Tree stats are merged into \a rhs_tree stats: counters are summed, gauges keep max/min,
+	 * values are copied only if \a rhs_tree doesn't have them.
+	 * If this tree has finer time unit, \a rhs_tree switches to it, so that merged times don't lose precision.
+	 * Subtrees that don't fit into node limit of \a rhs_tree are accounted there as dropped.
+	 * \param rhs_node Node in which this tree will be merged
+	 * \param rhs_tree Tree in which this tree will be merged
+	 */
+	void merge_into(call_tree_t::p_node_t rhs_node, call_tree_t& rhs_tree) const {
+		merge_stats_into(rhs_tree);
+		if (time_unit < rhs_tree.time_unit) {
+			rhs_tree.time_unit = time_unit;
+		}
+		rhs_tree.add_dropped_nodes(dropped_nodes, dropped_time);
+		merge_into(root, rhs_node, rhs_tree, base_time - rhs_tree.base_time);
+	}
+
+private:
+	/*!
+	 * \internal
+	 *
+	 * \brief Converts node time of this tree to microseconds since epoch, unset time stays 0
+	 */
+	int64_t node_time_to_microseconds(int64_t time) const {
+		if (!time) {
+			return 0;
+		}
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+			time_clock_t::duration(base_time + time)
+		).count();
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Converts microseconds since epoch to node time of this tree, 0 stays unset time
+	 */
+	int64_t microseconds_to_node_time(int64_t time) const {
+		if (!time) {
+			return 0;
+		}
+		return std::chrono::duration_cast<time_clock_t::duration>(
+			std::chrono::microseconds(time)
+		).count() - base_time;
 	}
 
-private:
 	/*!
 	 * \internal
 	 *
@@ -281,10 +1064,44 @@ private:
 	rapidjson::Value& to_json(p_node_t current_node, rapidjson::Value &stat_value,
 							  rapidjson::Document::AllocatorType &allocator) const {
 		if (current_node != root) {
-			stat_value.AddMember("name", actions_set.get_action_name(get_node_action_code(current_node)).c_str(), allocator);
-			stat_value.AddMember("start_time", get_node_start_time(current_node), allocator);
-			stat_value.AddMember("stop_time", get_node_stop_time(current_node), allocator);
+			const std::string action_name = actions_set.get_action_name(get_node_action_code(current_node));
+			rapidjson::Value action_name_value(action_name.c_str(), action_name.size(), allocator);
+			stat_value.AddMember("name", action_name_value, allocator);
+			stat_value.AddMember("start_time", node_time_to_unit(get_node_start_ticks(current_node)), allocator);
+			stat_value.AddMember("stop_time", node_time_to_unit(get_node_stop_ticks(current_node)), allocator);
+
+			const node_t::Stats &node_stats = nodes[current_node].stats;
+			if (!node_stats.empty()) {
+				rapidjson::Value stats_value(rapidjson::kObjectType);
+				for (auto it = node_stats.begin(); it != node_stats.end(); ++it) {
+					boost::apply_visitor(
+						JsonRenderer(actions_set.get_stat_name(it->first), stats_value, allocator),
+						it->second.value
+					);
+				}
+				stat_value.AddMember("stats", stats_value, allocator);
+			}
 		} else {
+			add_id_to_json("id", id, stat_value, allocator);
+			rapidjson::Value time_unit_value(get_time_unit_name(time_unit), allocator);
+			stat_value.AddMember("time_unit", time_unit_value, allocator);
+			add_id_to_json("trace_id", trace_id, stat_value, allocator);
+			add_id_to_json("parent_id", parent_id, stat_value, allocator);
+			stat_value.AddMember("mapped_size", static_cast<uint64_t>(memory_size), allocator);
+			if (is_truncated()) {
+				stat_value.AddMember("truncated", true, allocator);
+				stat_value.AddMember("dropped_nodes", static_cast<uint64_t>(dropped_nodes), allocator);
+				stat_value.AddMember("dropped_time", duration_to_unit(dropped_time), allocator);
+			}
+
+			for (size_t stat_code = 0; stat_code < registered_stats.size(); ++stat_code) {
+				if (registered_stats[stat_code].is_set()) {
+					boost::apply_visitor(
+						JsonRenderer(actions_set.get_stat_name(stat_code), stat_value, allocator),
+						registered_stats[stat_code].value
+					);
+				}
+			}
 			for (auto it = stats.begin(); it != stats.end(); ++it) {
 				boost::apply_visitor(JsonRenderer(it->first, stat_value, allocator), it->second);
 			}
@@ -306,6 +1123,23 @@ private:
 		return stat_value;
 	}
 
+	/*!
+	 * \internal
+	 *
+	 * \brief Adds hex representation of \a value to json if it is set
+	 */
+	static void add_id_to_json(const char *name, const trace_id_t &value, rapidjson::Value &stat_value,
+							   rapidjson::Document::AllocatorType &allocator) {
+		if (value.is_null()) {
+			return;
+		}
+
+		char buffer[trace_id_t::STRING_LENGTH];
+		value.write_string(buffer);
+		rapidjson::Value id_value(buffer, trace_id_t::STRING_LENGTH, allocator);
+		stat_value.AddMember(name, id_value, allocator);
+	}
+
 	/*!
 	 * \internal
 	 *
@@ -313,21 +1147,45 @@ private:
 	 * \param lhs_node Node which will be merged
 	 * \param rhs_node Node in which this tree will be merged
 	 * \param rhs_tree Tree in which this tree will be merged
+	 * \param time_shift Difference between base times of this tree and \a rhs_tree
 	 */
-	void merge_into(p_node_t lhs_node, call_tree_t::p_node_t rhs_node, call_tree_t& rhs_tree) const {
+	void merge_into(p_node_t lhs_node, call_tree_t::p_node_t rhs_node, call_tree_t& rhs_tree,
+			int64_t time_shift) const {
 		if (lhs_node != root) {
-			rhs_tree.set_node_start_time(rhs_node, get_node_start_time(lhs_node));
-			rhs_tree.set_node_stop_time(rhs_node, get_node_stop_time(lhs_node));
+			rhs_tree.set_node_start_ticks(rhs_node, get_node_start_ticks(lhs_node) + time_shift);
+			rhs_tree.set_node_stop_ticks(rhs_node, get_node_stop_ticks(lhs_node) + time_shift);
+			node_t::Stats &rhs_stats = rhs_tree.nodes[rhs_node].stats;
+			const size_t stats_size = get_stats_size(rhs_stats);
+			rhs_stats = nodes[lhs_node].stats;
+			rhs_tree.account_memory(stats_size, get_stats_size(rhs_stats));
 		}
 
 		for (auto it = nodes[lhs_node].links.begin(); it != nodes[lhs_node].links.end(); ++it) {
 			int action_code = it->first;
 			p_node_t lhs_next_node = it->second;
+			if (rhs_tree.is_full()) {
+				rhs_tree.add_dropped_nodes(get_subtree_size(lhs_next_node),
+					get_node_stop_ticks(lhs_next_node) - get_node_start_ticks(lhs_next_node));
+				continue;
+			}
 			p_node_t rhs_next_node = rhs_tree.add_new_link(rhs_node, action_code);
-			merge_into(lhs_next_node, rhs_next_node, rhs_tree);
+			merge_into(lhs_next_node, rhs_next_node, rhs_tree, time_shift);
 		}
 	}
 
+	/*!
+	 * \internal
+	 *
+	 * \brief Returns number of nodes in subtree of \a node including itself
+	 */
+	size_t get_subtree_size(p_node_t node) const {
+		size_t size = 1;
+		for (auto it = nodes[node].links.begin(); it != nodes[node].links.end(); ++it) {
+			size += get_subtree_size(it->second);
+		}
+		return size;
+	}
+
 	/*!
 	 * \internal
 	 *
@@ -336,24 +1194,278 @@ private:
 	 * \return Pointer to newly created node
 	 */
 	p_node_t new_node(int action_code) {
+		const size_t capacity = nodes.capacity();
 		nodes.emplace_back(action_code);
+		if (nodes.capacity() != capacity) {
+			account_memory(capacity * sizeof(node_t), nodes.capacity() * sizeof(node_t));
+		}
 		return nodes.size() - 1;
 	}
 
+	/*!
+	 * \internal
+	 *
+	 * \brief Returns number of bytes allocated by \a value outside of it
+	 */
+	static size_t get_heap_size(const stat_value_t &value) {
+		const std::string *string = boost::get<std::string>(&value);
+		return string ? string->capacity() : 0;
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Returns number of bytes used by stats of a node
+	 */
+	static size_t get_stats_size(const node_t::Stats &node_stats) {
+		size_t size = node_stats.capacity() * sizeof(node_stats[0]);
+		for (auto it = node_stats.begin(); it != node_stats.end(); ++it) {
+			size += get_heap_size(it->second.value);
+		}
+		return size;
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Returns number of bytes used by entry of unregistered stats, including hash table node
+	 */
+	static size_t get_entry_size(const std::pair<const std::string, stat_value_t> &entry) {
+		return sizeof(entry) + 2 * sizeof(void *) + entry.first.capacity() + get_heap_size(entry.second);
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Counts bytes used by the tree by walking all its storage
+	 */
+	size_t compute_memory_size() const {
+		size_t size = sizeof(call_tree_t);
+		size += nodes.capacity() * sizeof(node_t);
+		for (auto it = nodes.begin(); it != nodes.end(); ++it) {
+			size += it->links.capacity() * sizeof(it->links[0]);
+			size += get_stats_size(it->stats);
+		}
+
+		size += registered_stats.capacity() * sizeof(stat_t);
+		for (auto it = registered_stats.begin(); it != registered_stats.end(); ++it) {
+			size += get_heap_size(it->value);
+		}
+
+		size += stats.bucket_count() * sizeof(void *);
+		for (auto it = stats.begin(); it != stats.end(); ++it) {
+			size += get_entry_size(*it);
+		}
+		return size;
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Replaces \a old_size bytes of the tree with \a new_size bytes
+	 */
+	void account_memory(size_t old_size, size_t new_size) {
+		memory_size = memory_size - old_size + new_size;
+		if (memory_size > reported_memory_size || memory_size + MEMORY_REPORT_STEP <= reported_memory_size) {
+			report_memory_size();
+		}
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Updates process-wide account with memory size rounded up to report step
+	 *
+	 * Account is touched only when tree crosses step boundary, so growing tree doesn't contend on it.
+	 */
+	void report_memory_size() {
+		const size_t size = (memory_size + MEMORY_REPORT_STEP - 1) / MEMORY_REPORT_STEP * MEMORY_REPORT_STEP;
+		if (size > reported_memory_size) {
+			memory_usage().add(size - reported_memory_size);
+		} else {
+			memory_usage().sub(reported_memory_size - size);
+		}
+		reported_memory_size = size;
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Adds unregistered stat if there is no stat with \a key yet
+	 */
+	void insert_stat(const std::string &key, const stat_value_t &value) {
+		const size_t buckets = stats.bucket_count();
+		auto result = stats.insert(std::make_pair(key, value));
+		if (result.second) {
+			account_memory(buckets * sizeof(void *),
+				stats.bucket_count() * sizeof(void *) + get_entry_size(*result.first));
+		}
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Returns value of stat with registered \a stat_code marking it as set
+	 * \param stat_code Code of stat defined in actions set
+	 * \return Reference to stat's value in flat storage
+	 */
+	stat_t &get_stat_slot(int stat_code) {
+		check_stat_code(stat_code);
+
+		if (static_cast<size_t>(stat_code) >= registered_stats.size()) {
+			const size_t capacity = registered_stats.capacity();
+			registered_stats.resize(stat_code + 1);
+			account_memory(capacity * sizeof(stat_t), registered_stats.capacity() * sizeof(stat_t));
+		}
+
+		return registered_stats[stat_code];
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Returns slot of stat with \a stat_code attached to \a node, creates it if it doesn't exist
+	 */
+	stat_t &get_node_stat_slot(p_node_t node, int stat_code) {
+		if (node == root) {
+			return get_stat_slot(stat_code);
+		}
+
+		check_stat_code(stat_code);
+
+		node_t::Stats &node_stats = nodes[node].stats;
+		for (auto it = node_stats.begin(); it != node_stats.end(); ++it) {
+			if (it->first == stat_code) {
+				return it->second;
+			}
+		}
+
+		const size_t capacity = node_stats.capacity();
+		node_stats.emplace_back(stat_code, stat_t());
+		if (node_stats.capacity() != capacity) {
+			account_memory(capacity * sizeof(node_stats[0]), node_stats.capacity() * sizeof(node_stats[0]));
+		}
+		return node_stats.back().second;
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Finds stat with \a stat_code attached to \a node
+	 * \return Pointer to the stat or NULL if it is not set
+	 */
+	const stat_t *find_node_stat(p_node_t node, int stat_code) const {
+		const node_t::Stats &node_stats = nodes[node].stats;
+		for (auto it = node_stats.begin(); it != node_stats.end(); ++it) {
+			if (it->first == stat_code && it->second.is_set()) {
+				return &it->second;
+			}
+		}
+		return NULL;
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Throws if \a stat_code is not registered in actions set
+	 */
+	void check_stat_code(int stat_code) const {
+		if (!actions_set.stat_code_is_valid(stat_code)) {
+			throw std::invalid_argument("Can't add stat: stat code is invalid: "
+						+ std::to_string(static_cast<long long>(stat_code)));
+		}
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Merges tree stats into \a rhs_tree stats
+	 * \param rhs_tree Tree in which stats will be merged
+	 */
+	void merge_stats_into(call_tree_t& rhs_tree) const {
+		for (size_t stat_code = 0; stat_code < registered_stats.size(); ++stat_code) {
+			if (registered_stats[stat_code].is_set()) {
+				stat_t &stat = rhs_tree.get_stat_slot(stat_code);
+				const size_t heap_size = get_heap_size(stat.value);
+				stat.merge(registered_stats[stat_code]);
+				rhs_tree.account_memory(heap_size, get_heap_size(stat.value));
+			}
+		}
+
+		for (auto it = stats.begin(); it != stats.end(); ++it) {
+			rhs_tree.insert_stat(it->first, it->second);
+		}
+	}
+
 	/*!
 	 * \brief Tree nodes
 	 */
 	std::vector<node_t> nodes;
 
+	/*!
+	 * \brief Identifier of this call tree
+	 */
+	trace_id_t id;
+
+	/*!
+	 * \brief Identifier of the trace which this call tree belongs to
+	 */
+	trace_id_t trace_id;
+
+	/*!
+	 * \brief Identifier of the call tree which caused this one
+	 */
+	trace_id_t parent_id;
+
+	/*!
+	 * \brief Time from which node times are counted, in clock ticks since epoch
+	 */
+	int64_t base_time;
+
+	/*!
+	 * \brief Unit of action times in serialized tree
+	 */
+	time_unit_t time_unit;
+
+	/*!
+	 * \brief Maximum number of nodes including root
+	 */
+	size_t max_nodes;
+
+	/*!
+	 * \brief Number of actions dropped because of node limit
+	 */
+	size_t dropped_nodes;
+
+	/*!
+	 * \brief Time spent in dropped actions, in clock ticks
+	 */
+	int64_t dropped_time;
+
 	/*!
 	 * \brief Available actions for monitoring
 	 */
 	const actions_set_t &actions_set;
 
 	/*!
-	 * \brief Key-Value map for storing arbitary user stats
+	 * \brief Flat storage for stats with codes registered in actions set, indexed by stat code
+	 */
+	std::vector<stat_t> registered_stats;
+
+	/*!
+	 * \brief Key-Value map for storing arbitary user stats which names are not registered
 	 */
 	std::unordered_map<std::string, stat_value_t> stats;
+
+	/*!
+	 * \brief Approximate number of bytes used by the tree
+	 */
+	size_t memory_size;
+
+	/*!
+	 * \brief Number of bytes added by the tree to process-wide account
+	 */
+	size_t reported_memory_size;
 };
 
 /*!
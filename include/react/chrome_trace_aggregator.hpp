@@ -0,0 +1,368 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef REACT_CHROME_TRACE_AGGREGATOR_HPP
+#define REACT_CHROME_TRACE_AGGREGATOR_HPP
+
+#include <mutex>
+#include <chrono>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <algorithm>
+
+#include "aggregator.hpp"
+
+namespace react {
+
+/*!
+ * \brief Json writer of trace events, adds exact output of times that are fractional microseconds
+ */
+class trace_event_writer_t : public rapidjson::Writer<rapidjson::StringBuffer> {
+public:
+	explicit trace_event_writer_t(rapidjson::StringBuffer &buffer):
+		rapidjson::Writer<rapidjson::StringBuffer>(buffer) {}
+
+	/*!
+	 * \brief Writes \a nanoseconds as number of microseconds with three decimal places
+	 */
+	trace_event_writer_t &Microseconds(int64_t nanoseconds) {
+		Prefix(rapidjson::kNumberType);
+
+		const char *sign = nanoseconds < 0 ? "-" : "";
+		const unsigned long long value = nanoseconds < 0 ?
+			-static_cast<unsigned long long>(nanoseconds) : nanoseconds;
+		char buffer[32];
+		int length = snprintf(buffer, sizeof(buffer), "%s%llu.%03llu", sign, value / 1000, value % 1000);
+		for (int i = 0; i < length; ++i) {
+			stream_.Put(buffer[i]);
+		}
+		return *this;
+	}
+};
+
+/*!
+ * \brief Aggregator that writes call trees as Chrome Trace Event json, viewable in chrome://tracing and Perfetto
+ *
+ * Every aggregated tree is a separate process track with a slice that spans the whole activation,
+ * its actions are nested slices and their stats are slice args, tree stats are args of the activation slice.
+ * Actions that overlap their siblings or outlive their parent, e.g. subtrees merged from subthreads
+ * or adopted tasks, are moved to additional thread tracks of the process, so parallel work is shown
+ * side by side. Events are streamed through json writer without building document,
+ * each tree is written to the stream as soon as it is aggregated.
+ */
+class chrome_trace_aggregator_t : public aggregator_t {
+public:
+	/*!
+	 * \brief Constructs aggregator and starts trace json in \a os
+	 * \param os Stream where trace is written
+	 */
+	explicit chrome_trace_aggregator_t(std::ostream &os):
+		os(os), writer(buffer), trees_count(0), tree(NULL) {
+		writer.StartObject();
+		writer.String("displayTimeUnit");
+		writer.String("ns");
+		writer.String("traceEvents");
+		writer.StartArray();
+		write_buffer();
+	}
+
+	/*!
+	 * \brief Finishes trace json
+	 */
+	~chrome_trace_aggregator_t() {
+		writer.EndArray();
+		writer.EndObject();
+		write_buffer();
+		os.flush();
+	}
+
+	/*!
+	 * \brief Writes events of \a call_tree
+	 * \param call_tree Tree that will be written
+	 */
+	void aggregate(const call_tree_t &call_tree) {
+		std::lock_guard<std::mutex> guard(writer_mutex);
+		const size_t pid = ++trees_count;
+
+		tree = &call_tree;
+		lanes_ends.clear();
+
+		int64_t start_time = 0, stop_time = 0;
+		const node_t::Container &links = call_tree.get_node_links(call_tree.root);
+		for (auto it = links.begin(); it != links.end(); ++it) {
+			if (it == links.begin() || get_start_time(it->second) < start_time) {
+				start_time = get_start_time(it->second);
+			}
+			stop_time = std::max(stop_time, get_stop_time(it->second));
+		}
+		stop_time = std::max(stop_time, start_time);
+
+		const std::string name = call_tree.get_id().is_null() ?
+			"activation " + std::to_string(static_cast<unsigned long long>(pid)) :
+			"activation " + call_tree.get_id().to_string();
+		write_metadata(pid, 0, "process_name", name);
+		write_metadata(pid, 0, "thread_name", "main");
+
+		lanes_ends.push_back(stop_time);
+		write_slice_begin(pid, 0, name, start_time, stop_time);
+		write_tree_stats(call_tree);
+		writer.EndObject();
+
+		write_children(pid, call_tree.root, 0, start_time, stop_time);
+
+		// Names of additional tracks are known only after all slices are placed
+		for (size_t lane = 1; lane < lanes_ends.size(); ++lane) {
+			write_metadata(pid, lane, "thread_name",
+				"parallel " + std::to_string(static_cast<unsigned long long>(lane)));
+		}
+
+		tree = NULL;
+		write_buffer();
+	}
+
+private:
+	/*!
+	 * \internal
+	 *
+	 * \brief Writes stat value as trace event arg
+	 */
+	class arg_writer_t : public boost::static_visitor<> {
+	public:
+		explicit arg_writer_t(trace_event_writer_t &writer): writer(writer) {}
+
+		void operator () (bool value) const {
+			writer.Bool(value);
+		}
+
+		void operator () (int value) const {
+			writer.Int(value);
+		}
+
+		void operator () (int64_t value) const {
+			writer.Int64(value);
+		}
+
+		void operator () (uint64_t value) const {
+			writer.Uint64(value);
+		}
+
+		void operator () (double value) const {
+			writer.Double(value);
+		}
+
+		void operator () (const std::string &value) const {
+			writer.String(value.c_str(), value.size());
+		}
+
+	private:
+		trace_event_writer_t &writer;
+	};
+
+	int64_t get_start_time(call_tree_t::p_node_t node) const {
+		return to_nanoseconds(tree->get_node_start_ticks(node));
+	}
+
+	int64_t get_stop_time(call_tree_t::p_node_t node) const {
+		return to_nanoseconds(std::max(tree->get_node_start_ticks(node), tree->get_node_stop_ticks(node)));
+	}
+
+	int64_t to_nanoseconds(int64_t node_time) const {
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			call_tree_t::time_clock_t::duration(tree->get_base_time() + node_time)
+		).count();
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Writes children of \a node, which is placed on \a lane, and their subtrees
+	 *
+	 * Child stays on parent's lane if it fits into parent and doesn't overlap previous child there,
+	 * otherwise it is moved to the first lane that is free since its start.
+	 */
+	void write_children(size_t pid, call_tree_t::p_node_t node, size_t lane,
+			int64_t parent_start_time, int64_t parent_stop_time) {
+		int64_t lane_time = parent_start_time;
+
+		const node_t::Container &links = tree->get_node_links(node);
+		for (auto it = links.begin(); it != links.end(); ++it) {
+			const call_tree_t::p_node_t child = it->second;
+			const int64_t start_time = get_start_time(child);
+			const int64_t stop_time = get_stop_time(child);
+
+			size_t child_lane = lane;
+			if (start_time >= lane_time && stop_time <= parent_stop_time) {
+				lane_time = stop_time;
+			} else {
+				child_lane = get_free_lane(start_time, stop_time);
+			}
+
+			write_slice_begin(pid, child_lane, tree->get_actions_set().get_action_name(it->first),
+					start_time, stop_time);
+			const node_t::Stats &stats = tree->get_node_stats(child);
+			if (!stats.empty()) {
+				writer.String("args");
+				writer.StartObject();
+				for (auto stat = stats.begin(); stat != stats.end(); ++stat) {
+					const std::string stat_name = tree->get_actions_set().get_stat_name(stat->first);
+					writer.String(stat_name.c_str(), stat_name.size());
+					boost::apply_visitor(arg_writer_t(writer), stat->second.value);
+				}
+				writer.EndObject();
+			}
+			writer.EndObject();
+
+			write_children(pid, child, child_lane, start_time, stop_time);
+		}
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Returns additional lane that is free during [\a start_time, \a stop_time) and occupies it
+	 */
+	size_t get_free_lane(int64_t start_time, int64_t stop_time) {
+		for (size_t lane = 1; lane < lanes_ends.size(); ++lane) {
+			if (lanes_ends[lane] <= start_time) {
+				lanes_ends[lane] = stop_time;
+				return lane;
+			}
+		}
+		lanes_ends.push_back(stop_time);
+		return lanes_ends.size() - 1;
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Writes complete event without closing it, so args can be added
+	 */
+	void write_slice_begin(size_t pid, size_t tid, const std::string &name, int64_t start_time, int64_t stop_time) {
+		writer.StartObject();
+		writer.String("name");
+		writer.String(name.c_str(), name.size());
+		writer.String("cat");
+		writer.String("react");
+		writer.String("ph");
+		writer.String("X");
+		writer.String("pid");
+		writer.Uint64(pid);
+		writer.String("tid");
+		writer.Uint64(tid);
+		writer.String("ts");
+		writer.Microseconds(start_time);
+		writer.String("dur");
+		writer.Microseconds(stop_time - start_time);
+	}
+
+	void write_tree_stats(const call_tree_t &call_tree) {
+		writer.String("args");
+		writer.StartObject();
+		const trace_id_t *ids[] = {&call_tree.get_id(), &call_tree.get_trace_id(), &call_tree.get_parent_id()};
+		const char *ids_names[] = {"id", "trace_id", "parent_id"};
+		for (size_t i = 0; i < sizeof(ids) / sizeof(ids[0]); ++i) {
+			if (!ids[i]->is_null()) {
+				const std::string id = ids[i]->to_string();
+				writer.String(ids_names[i]);
+				writer.String(id.c_str(), id.size());
+			}
+		}
+
+		const std::vector<stat_t> &registered_stats = call_tree.get_registered_stats();
+		for (size_t stat_code = 0; stat_code < registered_stats.size(); ++stat_code) {
+			if (registered_stats[stat_code].is_set()) {
+				const std::string stat_name = call_tree.get_actions_set().get_stat_name(stat_code);
+				writer.String(stat_name.c_str(), stat_name.size());
+				boost::apply_visitor(arg_writer_t(writer), registered_stats[stat_code].value);
+			}
+		}
+
+		const std::unordered_map<std::string, stat_value_t> &stats = call_tree.get_unregistered_stats();
+		for (auto it = stats.begin(); it != stats.end(); ++it) {
+			writer.String(it->first.c_str(), it->first.size());
+			boost::apply_visitor(arg_writer_t(writer), it->second);
+		}
+		writer.EndObject();
+	}
+
+	void write_metadata(size_t pid, size_t tid, const char *name, const std::string &value) {
+		writer.StartObject();
+		writer.String("name");
+		writer.String(name);
+		writer.String("ph");
+		writer.String("M");
+		writer.String("pid");
+		writer.Uint64(pid);
+		writer.String("tid");
+		writer.Uint64(tid);
+		writer.String("args");
+		writer.StartObject();
+		writer.String("name");
+		writer.String(value.c_str(), value.size());
+		writer.EndObject();
+		writer.EndObject();
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Moves written json from buffer to stream
+	 */
+	void write_buffer() {
+		os.write(buffer.GetString(), buffer.Size());
+		buffer.Clear();
+	}
+
+	/*!
+	 * \brief Stream where trace is written
+	 */
+	std::ostream &os;
+
+	/*!
+	 * \brief Protects writer
+	 */
+	std::mutex writer_mutex;
+
+	/*!
+	 * \brief Buffer for json of single tree
+	 */
+	rapidjson::StringBuffer buffer;
+
+	/*!
+	 * \brief Writer that keeps state of trace json between trees
+	 */
+	trace_event_writer_t writer;
+
+	/*!
+	 * \brief Number of written trees, used as process ids
+	 */
+	size_t trees_count;
+
+	/*!
+	 * \brief Tree that is being written
+	 */
+	const call_tree_t *tree;
+
+	/*!
+	 * \brief Stop times of the last slices on lanes of the tree that is being written
+	 */
+	std::vector<int64_t> lanes_ends;
+};
+
+} // namespace react
+
+#endif // REACT_CHROME_TRACE_AGGREGATOR_HPP
@@ -0,0 +1,232 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef REACT_COLLAPSED_STACK_AGGREGATOR_HPP
+#define REACT_COLLAPSED_STACK_AGGREGATOR_HPP
+
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <vector>
+#include <ostream>
+#include <unordered_map>
+
+#include "aggregator.hpp"
+#include "columnar_call_tree.hpp"
+
+namespace react {
+
+/*!
+ * \brief Weight of stacks written by collapsed_stack_aggregator_t
+ */
+enum stack_weight_t {
+	/*!
+	 * \brief Stack is weighted by time of its action without time of nested actions
+	 */
+	STACK_WEIGHT_SELF_TIME,
+
+	/*!
+	 * \brief Stack is weighted by full time of its action
+	 */
+	STACK_WEIGHT_TOTAL_TIME
+};
+
+/*!
+ * \brief Aggregator that folds call trees into collapsed stacks for flame graphs
+ *
+ * Every call path is interned once and gets an id, aggregated trees only add their times
+ * to weights of paths, so cost of aggregation doesn't depend on number of aggregated trees.
+ * On flush every path is written once as "ROOT;READ;LOAD FROM DISK <microseconds>" line.
+ */
+class collapsed_stack_aggregator_t : public aggregator_t {
+public:
+	/*!
+	 * \brief Constructs aggregator
+	 * \param actions_set Set of actions used for naming stack frames
+	 * \param os Stream where stacks are written on flush
+	 * \param weight Whether stacks are weighted by self or total time
+	 * \param root_name Name of the frame that is prepended to every stack, not prepended if empty
+	 */
+	collapsed_stack_aggregator_t(const actions_set_t &actions_set, std::ostream &os,
+			stack_weight_t weight = STACK_WEIGHT_SELF_TIME, const std::string &root_name = "ROOT"):
+		actions_set(actions_set), os(os), weight(weight), root_name(root_name) {}
+
+	/*!
+	 * \brief Writes stacks that were not flushed
+	 */
+	~collapsed_stack_aggregator_t() {
+		flush();
+	}
+
+	/*!
+	 * \brief Adds times of \a call_tree actions to weights of their call paths
+	 * \param call_tree Tree that will be aggregated
+	 */
+	void aggregate(const call_tree_t &call_tree) {
+		std::lock_guard<std::mutex> guard(paths_mutex);
+		snapshot.assign(call_tree);
+
+		const size_t size = snapshot.size();
+		const std::vector<columnar_call_tree_t::index_t> &parents = snapshot.get_parents();
+		const std::vector<int> &action_codes = snapshot.get_action_codes();
+		const std::vector<int64_t> &start_times = snapshot.get_start_times();
+		const std::vector<int64_t> &stop_times = snapshot.get_stop_times();
+
+		// Nodes are created after their parents, so parent's path is always known
+		node_paths.resize(size);
+		for (size_t i = 0; i < size; ++i) {
+			const uint32_t parent_path = parents[i] == columnar_call_tree_t::NO_PARENT ?
+				NO_PATH : node_paths[parents[i]];
+			node_paths[i] = get_path(parent_path, action_codes[i]);
+		}
+
+		node_weights.resize(size);
+		for (size_t i = 0; i < size; ++i) {
+			node_weights[i] = stop_times[i] - start_times[i];
+		}
+		if (weight == STACK_WEIGHT_SELF_TIME) {
+			for (size_t i = 0; i < size; ++i) {
+				if (parents[i] != columnar_call_tree_t::NO_PARENT) {
+					node_weights[parents[i]] -= stop_times[i] - start_times[i];
+				}
+			}
+		}
+
+		for (size_t i = 0; i < size; ++i) {
+			paths[node_paths[i]].weight += node_weights[i];
+		}
+	}
+
+	/*!
+	 * \brief Writes every call path with weight of at least one microsecond and resets weights
+	 *
+	 * Remainders shorter than a microsecond are kept, so paths of short actions are written
+	 * once their accumulated weight reaches a microsecond.
+	 */
+	void flush() {
+		std::lock_guard<std::mutex> guard(paths_mutex);
+		for (auto it = paths.begin(); it != paths.end(); ++it) {
+			const std::chrono::microseconds microseconds = std::chrono::duration_cast<std::chrono::microseconds>(
+				call_tree_t::time_clock_t::duration(it->weight)
+			);
+			if (microseconds.count() > 0) {
+				os << it->name << ' ' << microseconds.count() << '\n';
+				it->weight -= std::chrono::duration_cast<call_tree_t::time_clock_t::duration>(microseconds).count();
+			} else if (it->weight < 0) {
+				it->weight = 0;
+			}
+		}
+		os.flush();
+	}
+
+	/*!
+	 * \brief Returns number of distinct call paths seen by aggregator
+	 */
+	size_t get_paths_count() const {
+		std::lock_guard<std::mutex> guard(paths_mutex);
+		return paths.size();
+	}
+
+private:
+	static const uint32_t NO_PATH = static_cast<uint32_t>(-1);
+
+	/*!
+	 * \brief Call path with its collapsed stack name
+	 */
+	struct path_t {
+		std::string name;
+		int64_t weight;
+	};
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Returns id of the path of \a action_code called from \a parent_path, adds the path if needed
+	 */
+	uint32_t get_path(uint32_t parent_path, int action_code) {
+		const uint64_t key = (static_cast<uint64_t>(parent_path) << 32) | static_cast<uint32_t>(action_code);
+		auto it = paths_index.find(key);
+		if (it != paths_index.end()) {
+			return it->second;
+		}
+
+		path_t path;
+		path.name = parent_path == NO_PATH ? root_name : paths[parent_path].name;
+		if (!path.name.empty()) {
+			path.name += ';';
+		}
+		path.name += actions_set.get_action_name(action_code);
+		path.weight = 0;
+		paths.push_back(path);
+
+		const uint32_t id = paths.size() - 1;
+		paths_index.insert(std::make_pair(key, id));
+		return id;
+	}
+
+	/*!
+	 * \brief Set of actions used for naming stack frames
+	 */
+	const actions_set_t &actions_set;
+
+	/*!
+	 * \brief Stream where stacks are written
+	 */
+	std::ostream &os;
+
+	/*!
+	 * \brief Weight of stacks
+	 */
+	stack_weight_t weight;
+
+	/*!
+	 * \brief Name of the frame prepended to every stack
+	 */
+	std::string root_name;
+
+	/*!
+	 * \brief Protects paths and reused buffers
+	 */
+	mutable std::mutex paths_mutex;
+
+	/*!
+	 * \brief Call paths indexed by id
+	 */
+	std::vector<path_t> paths;
+
+	/*!
+	 * \brief Maps parent path id and action code to path id
+	 */
+	std::unordered_map<uint64_t, uint32_t> paths_index;
+
+	/*!
+	 * \brief Snapshot reused for every aggregated tree
+	 */
+	columnar_call_tree_t snapshot;
+
+	/*!
+	 * \brief Path ids of snapshot nodes, reused for every aggregated tree
+	 */
+	std::vector<uint32_t> node_paths;
+
+	/*!
+	 * \brief Weights of snapshot nodes, reused for every aggregated tree
+	 */
+	std::vector<int64_t> node_weights;
+};
+
+} // namespace react
+
+#endif // REACT_COLLAPSED_STACK_AGGREGATOR_HPP
@@ -0,0 +1,276 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef REACT_COLUMNAR_CALL_TREE_HPP
+#define REACT_COLUMNAR_CALL_TREE_HPP
+
+#include <vector>
+#include <limits>
+#include <stdexcept>
+#include <stdint.h>
+
+#include "call_tree.hpp"
+
+namespace react {
+
+/*!
+ * \brief Snapshot of call tree stored as parallel arrays, one element per action
+ *
+ * Analysis passes that compute per-action totals or histograms scan contiguous arrays
+ * instead of walking nodes with embedded link vectors. Root of the call tree is not stored,
+ * actions are ordered by creation, so parent always precedes its children.
+ * Times are clock ticks since base time, as in call_tree_t.
+ */
+class columnar_call_tree_t {
+public:
+	/*!
+	 * \brief Index of action in snapshot
+	 */
+	typedef uint32_t index_t;
+
+	/*!
+	 * \brief Parent index of top-level actions
+	 */
+	static const index_t NO_PARENT = static_cast<index_t>(-1);
+
+	/*!
+	 * \brief Initializes empty snapshot
+	 */
+	columnar_call_tree_t(): base_time(0), time_unit(TIME_UNIT_MICROSECONDS) {}
+
+	/*!
+	 * \brief Initializes snapshot of \a call_tree
+	 */
+	explicit columnar_call_tree_t(const call_tree_t &call_tree) {
+		assign(call_tree);
+	}
+
+	/*!
+	 * \brief Replaces snapshot with \a call_tree, allocated storage is reused
+	 * \param call_tree Source tree
+	 */
+	void assign(const call_tree_t &call_tree) {
+		if (call_tree.get_nodes_count() - 1 > static_cast<size_t>(NO_PARENT)) {
+			throw std::length_error("Can't build columnar call tree: too many nodes");
+		}
+
+		const size_t count = call_tree.get_nodes_count() - 1;
+		action_codes.resize(count);
+		parents.resize(count);
+		start_times.resize(count);
+		stop_times.resize(count);
+		base_time = call_tree.get_base_time();
+		time_unit = call_tree.get_time_unit();
+
+		for (size_t node = 0; node < call_tree.get_nodes_count(); ++node) {
+			const index_t parent = (node == call_tree.root) ? NO_PARENT : to_index(node);
+			const node_t::Container &links = call_tree.get_node_links(node);
+			for (auto it = links.begin(); it != links.end(); ++it) {
+				parents[to_index(it->second)] = parent;
+			}
+
+			if (node != call_tree.root) {
+				const index_t index = to_index(node);
+				action_codes[index] = call_tree.get_node_action_code(node);
+				start_times[index] = call_tree.get_node_start_ticks(node);
+				stop_times[index] = call_tree.get_node_stop_ticks(node);
+			}
+		}
+	}
+
+	/*!
+	 * \brief Removes all actions, allocated storage is kept
+	 */
+	void clear() {
+		action_codes.clear();
+		parents.clear();
+		start_times.clear();
+		stop_times.clear();
+	}
+
+	/*!
+	 * \brief Returns number of actions
+	 */
+	size_t size() const {
+		return action_codes.size();
+	}
+
+	/*!
+	 * \brief Returns action codes of all actions
+	 */
+	const std::vector<int> &get_action_codes() const {
+		return action_codes;
+	}
+
+	/*!
+	 * \brief Returns parent indices of all actions, NO_PARENT for top-level ones
+	 */
+	const std::vector<index_t> &get_parents() const {
+		return parents;
+	}
+
+	/*!
+	 * \brief Returns start times of all actions
+	 */
+	const std::vector<int64_t> &get_start_times() const {
+		return start_times;
+	}
+
+	/*!
+	 * \brief Returns stop times of all actions
+	 */
+	const std::vector<int64_t> &get_stop_times() const {
+		return stop_times;
+	}
+
+	/*!
+	 * \brief Returns base time of source tree, in clock ticks since epoch
+	 */
+	int64_t get_base_time() const {
+		return base_time;
+	}
+
+	/*!
+	 * \brief Returns time unit of source tree
+	 */
+	time_unit_t get_time_unit() const {
+		return time_unit;
+	}
+
+private:
+	/*!
+	 * \internal
+	 *
+	 * \brief Converts call tree node to snapshot index, root is skipped
+	 */
+	static index_t to_index(call_tree_t::p_node_t node) {
+		return static_cast<index_t>(node - 1);
+	}
+
+	/*!
+	 * \brief Action codes
+	 */
+	std::vector<int> action_codes;
+
+	/*!
+	 * \brief Parent indices
+	 */
+	std::vector<index_t> parents;
+
+	/*!
+	 * \brief Start times
+	 */
+	std::vector<int64_t> start_times;
+
+	/*!
+	 * \brief Stop times
+	 */
+	std::vector<int64_t> stop_times;
+
+	/*!
+	 * \brief Base time of source tree
+	 */
+	int64_t base_time;
+
+	/*!
+	 * \brief Time unit of source tree
+	 */
+	time_unit_t time_unit;
+};
+
+/*!
+ * \brief Calls number and durations of a single action, durations are in clock ticks
+ */
+struct action_summary_t {
+	/*!
+	 * \brief Initializes empty summary
+	 */
+	action_summary_t():
+		calls(0), total_time(0),
+		min_time(std::numeric_limits<int64_t>::max()),
+		max_time(std::numeric_limits<int64_t>::min()) {}
+
+	/*!
+	 * \brief Accounts single call with \a duration
+	 */
+	void add(int64_t duration) {
+		++calls;
+		total_time += duration;
+		if (duration < min_time) {
+			min_time = duration;
+		}
+		if (duration > max_time) {
+			max_time = duration;
+		}
+	}
+
+	/*!
+	 * \brief Accounts all calls of \a other summary
+	 */
+	void merge(const action_summary_t &other) {
+		calls += other.calls;
+		total_time += other.total_time;
+		if (other.min_time < min_time) {
+			min_time = other.min_time;
+		}
+		if (other.max_time > max_time) {
+			max_time = other.max_time;
+		}
+	}
+
+	/*!
+	 * \brief Number of calls
+	 */
+	uint64_t calls;
+
+	/*!
+	 * \brief Sum of durations of all calls
+	 */
+	int64_t total_time;
+
+	/*!
+	 * \brief Duration of the fastest call, undefined if there were no calls
+	 */
+	int64_t min_time;
+
+	/*!
+	 * \brief Duration of the slowest call, undefined if there were no calls
+	 */
+	int64_t max_time;
+};
+
+/*!
+ * \brief Adds durations of all actions of \a call_tree to \a summaries
+ * \param call_tree Snapshot of call tree
+ * \param summaries Summaries indexed by action code, grown if needed
+ */
+inline void summarize_actions(const columnar_call_tree_t &call_tree, std::vector<action_summary_t> &summaries) {
+	const size_t count = call_tree.size();
+	const int *action_codes = call_tree.get_action_codes().data();
+	const int64_t *start_times = call_tree.get_start_times().data();
+	const int64_t *stop_times = call_tree.get_stop_times().data();
+
+	for (size_t i = 0; i < count; ++i) {
+		const size_t action_code = action_codes[i];
+		if (action_code >= summaries.size()) {
+			summaries.resize(action_code + 1);
+		}
+		summaries[action_code].add(stop_times[i] - start_times[i]);
+	}
+}
+
+} // namespace react
+
+#endif // REACT_COLUMNAR_CALL_TREE_HPP
@@ -0,0 +1,185 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef REACT_CONTROL_HPP
+#define REACT_CONTROL_HPP
+
+#include <atomic>
+#include <string>
+#include <cstdlib>
+#include <stdint.h>
+
+namespace react {
+
+class aggregator_t;
+
+/*!
+ * \brief What react records when call trees are activated
+ */
+enum record_mode_t {
+	/*!
+	 * \brief Nothing is recorded, activations leave threads not active
+	 */
+	RECORD_MODE_OFF,
+
+	/*!
+	 * \brief Random part of activations is recorded
+	 */
+	RECORD_MODE_SAMPLED,
+
+	/*!
+	 * \brief Every activation is recorded
+	 */
+	RECORD_MODE_FULL
+};
+
+/*!
+ * \brief Process-wide settings of recording that can be changed at runtime
+ *
+ * Mode and sample rate are packed into single word, so activation decides whether to record
+ * with one relaxed atomic load, and the word can be stored from signal handler.
+ */
+class control_block_t {
+public:
+	/*!
+	 * \brief Sample rate is stored as threshold for 32-bit random numbers
+	 */
+	static const uint64_t RATE_SCALE = 1ULL << 32;
+
+	/*!
+	 * \brief Initializes control block in full mode without aggregator override
+	 */
+	constexpr control_block_t(): word(RECORD_MODE_FULL * RATE_SCALE * 2 + RATE_SCALE), aggregator(NULL) {}
+
+	/*!
+	 * \brief Packs \a mode and \a rate into control word
+	 * \param mode Recording mode
+	 * \param rate Recorded part of activations in sampled mode, clamped to [0, 1]
+	 */
+	static uint64_t pack(record_mode_t mode, double rate) {
+		if (mode != RECORD_MODE_SAMPLED) {
+			rate = mode == RECORD_MODE_FULL ? 1 : 0;
+		}
+		rate = rate < 0 ? 0 : (rate > 1 ? 1 : rate);
+		return static_cast<uint64_t>(mode) * RATE_SCALE * 2 + static_cast<uint64_t>(rate * RATE_SCALE);
+	}
+
+	/*!
+	 * \brief Returns mode stored in control \a word
+	 */
+	static record_mode_t get_mode(uint64_t word) {
+		return static_cast<record_mode_t>(word / (RATE_SCALE * 2));
+	}
+
+	/*!
+	 * \brief Returns sample rate stored in control \a word
+	 */
+	static double get_rate(uint64_t word) {
+		return static_cast<double>(word % (RATE_SCALE * 2)) / RATE_SCALE;
+	}
+
+	/*!
+	 * \brief Checks whether activation with 32-bit \a random number is recorded under control \a word
+	 */
+	static bool should_record(uint64_t word, uint32_t random) {
+		return random < word % (RATE_SCALE * 2);
+	}
+
+	/*!
+	 * \brief Parses mode in form "off", "full" or "sampled:RATE", surrounding whitespace is ignored
+	 * \param str String with mode
+	 * \param word Where packed mode is written
+	 * \return True if \a str is valid mode, false otherwise
+	 */
+	static bool parse(const std::string &str, uint64_t &word) {
+		const size_t begin = str.find_first_not_of(" \t\r\n");
+		const size_t end = str.find_last_not_of(" \t\r\n");
+		if (begin == std::string::npos) {
+			return false;
+		}
+		const std::string mode = str.substr(begin, end - begin + 1);
+
+		if (mode == "off") {
+			word = pack(RECORD_MODE_OFF, 0);
+			return true;
+		}
+		if (mode == "full") {
+			word = pack(RECORD_MODE_FULL, 1);
+			return true;
+		}
+
+		const std::string prefix = "sampled:";
+		if (mode.compare(0, prefix.size(), prefix) == 0) {
+			const char *rate_begin = mode.c_str() + prefix.size();
+			char *rate_end = NULL;
+			const double rate = strtod(rate_begin, &rate_end);
+			if (rate_end != rate_begin && *rate_end == '\0' && rate >= 0 && rate <= 1) {
+				word = pack(RECORD_MODE_SAMPLED, rate);
+				return true;
+			}
+		}
+		return false;
+	}
+
+	/*!
+	 * \brief Returns current control word
+	 */
+	uint64_t load() const {
+		return word.load(std::memory_order_relaxed);
+	}
+
+	/*!
+	 * \brief Replaces control word, safe to call from signal handler
+	 */
+	void store(uint64_t word) {
+		this->word.store(word, std::memory_order_relaxed);
+	}
+
+	/*!
+	 * \brief Returns aggregator that replaces aggregators passed to activation, NULL if there is none
+	 */
+	aggregator_t *get_aggregator() const {
+		return aggregator.load(std::memory_order_acquire);
+	}
+
+	/*!
+	 * \brief Makes new activations send trees to \a aggregator, NULL restores aggregators passed to activation
+	 *
+	 * Aggregator must outlive call trees activated while it is set.
+	 */
+	void set_aggregator(aggregator_t *aggregator) {
+		this->aggregator.store(aggregator, std::memory_order_release);
+	}
+
+private:
+	/*!
+	 * \brief Packed mode and sample rate
+	 */
+	std::atomic<uint64_t> word;
+
+	/*!
+	 * \brief Aggregator override
+	 */
+	std::atomic<aggregator_t *> aggregator;
+};
+
+/*!
+ * \brief Returns process-wide control block of react library
+ */
+control_block_t &control_block();
+
+} // namespace react
+
+#endif // REACT_CONTROL_HPP
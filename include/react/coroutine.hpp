@@ -0,0 +1,266 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef REACT_COROUTINE_HPP
+#define REACT_COROUTINE_HPP
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <chrono>
+#include <coroutine>
+#include <exception>
+#include <type_traits>
+#include <utility>
+
+#include "react.hpp"
+
+namespace react {
+
+/*!
+ * \brief Returns code of stat where coroutine_scope records time spent in suspension, in microseconds
+ */
+inline int suspended_time_stat() {
+	static const int stat_code = react_define_new_stat("suspended_time");
+	return stat_code;
+}
+
+/*!
+ * \brief React context of a single coroutine
+ *
+ * Coroutine initially inherits context of the thread where it was created.
+ * Every time coroutine stops running its context is taken off the thread and previous context
+ * of the thread is restored, every time it is resumed its context is installed on resuming thread.
+ * So actions started before suspension may be stopped after resumption on another thread.
+ *
+ * Coroutines that run concurrently must not share the same context: either activate react
+ * inside of coroutine or start it with adopted context_token.
+ */
+class coroutine_scope {
+public:
+	/*!
+	 * \brief Captures context of current thread
+	 * \param record_suspended_time Whether time spent in suspension is added to "suspended_time" stat
+	 *        of action that was running when coroutine was suspended
+	 */
+	explicit coroutine_scope(bool record_suspended_time = false):
+		state(get_context_state()), running(false),
+		record_suspended_time(record_suspended_time) {}
+
+	coroutine_scope(const coroutine_scope &other) = delete;
+	coroutine_scope &operator =(const coroutine_scope &other) = delete;
+
+	/*!
+	 * \brief Installs coroutine context on current thread, called when coroutine starts running
+	 */
+	void enter() noexcept {
+		if (running) {
+			return;
+		}
+		running = true;
+		previous_state = exchange_context(state);
+
+		if (record_suspended_time && !state.empty() && suspended_at != time_point()) {
+			try {
+				increment_node_stat(suspended_time_stat(), static_cast<int64_t>(
+					std::chrono::duration_cast<std::chrono::microseconds>(clock::now() - suspended_at).count()
+				));
+			} catch (...) {
+			}
+		}
+	}
+
+	/*!
+	 * \brief Takes coroutine context off current thread, called when coroutine stops running
+	 */
+	void leave() noexcept {
+		if (!running) {
+			return;
+		}
+		running = false;
+		state = exchange_context(previous_state);
+		previous_state = context_state();
+
+		if (record_suspended_time) {
+			suspended_at = clock::now();
+		}
+	}
+
+private:
+	typedef std::chrono::steady_clock clock;
+	typedef clock::time_point time_point;
+
+	/*!
+	 * \brief Context of coroutine while it is suspended
+	 */
+	context_state state;
+
+	/*!
+	 * \brief Context of the thread that runs coroutine
+	 */
+	context_state previous_state;
+
+	/*!
+	 * \brief Shows whether coroutine context is installed on the thread
+	 */
+	bool running;
+
+	/*!
+	 * \brief Whether suspended time is recorded
+	 */
+	bool record_suspended_time;
+
+	/*!
+	 * \brief Time of the last suspension
+	 */
+	time_point suspended_at;
+};
+
+namespace detail {
+
+template<typename Awaitable>
+decltype(auto) get_awaiter(Awaitable &&awaitable) {
+	if constexpr (requires { std::forward<Awaitable>(awaitable).operator co_await(); }) {
+		return std::forward<Awaitable>(awaitable).operator co_await();
+	} else if constexpr (requires { operator co_await(std::forward<Awaitable>(awaitable)); }) {
+		return operator co_await(std::forward<Awaitable>(awaitable));
+	} else {
+		return std::forward<Awaitable>(awaitable);
+	}
+}
+
+} // namespace detail
+
+/*!
+ * \brief Awaiter that switches react context of coroutine_scope around suspension of wrapped awaiter
+ *
+ * Context is taken off the thread before wrapped await_suspend is called,
+ * because coroutine may be resumed on another thread before await_suspend returns.
+ */
+template<typename Awaiter>
+class scoped_awaiter {
+public:
+	scoped_awaiter(Awaiter &&awaiter, coroutine_scope &scope):
+		awaiter(std::forward<Awaiter>(awaiter)), scope(scope) {}
+
+	bool await_ready() {
+		return awaiter.await_ready();
+	}
+
+	template<typename Promise>
+	auto await_suspend(std::coroutine_handle<Promise> handle) {
+		typedef decltype(awaiter.await_suspend(handle)) result_t;
+
+		scope.leave();
+		try {
+			if constexpr (std::is_void<result_t>::value) {
+				awaiter.await_suspend(handle);
+			} else if constexpr (std::is_same<result_t, bool>::value) {
+				bool suspended = awaiter.await_suspend(handle);
+				if (!suspended) {
+					scope.enter();
+				}
+				return suspended;
+			} else {
+				return awaiter.await_suspend(handle);
+			}
+		} catch (...) {
+			scope.enter();
+			throw;
+		}
+	}
+
+	decltype(auto) await_resume() {
+		scope.enter();
+		return awaiter.await_resume();
+	}
+
+private:
+	/*!
+	 * \brief Wrapped awaiter
+	 */
+	Awaiter awaiter;
+
+	/*!
+	 * \brief Scope of awaiting coroutine
+	 */
+	coroutine_scope &scope;
+};
+
+/*!
+ * \brief Wraps \a awaitable so that it switches react context of \a scope around suspension
+ * \param awaitable Awaitable object or awaiter
+ * \param scope Scope of awaiting coroutine
+ * \return Awaiter that can be co_awaited
+ */
+template<typename Awaitable>
+auto make_scoped_awaiter(Awaitable &&awaitable, coroutine_scope &scope) {
+	typedef decltype(detail::get_awaiter(std::forward<Awaitable>(awaitable))) awaiter_t;
+	return scoped_awaiter<awaiter_t>(detail::get_awaiter(std::forward<Awaitable>(awaitable)), scope);
+}
+
+/*!
+ * \brief Base for coroutine promise types that keeps react context with the coroutine
+ *
+ * All co_await expressions of the coroutine are wrapped, initial and final suspend awaiters
+ * should be wrapped by promise with react_initial_suspend and react_final_suspend:
+ * \code
+ * struct promise_type : react::coroutine_promise_mixin<> {
+ *     auto initial_suspend() { return react_initial_suspend(std::suspend_always()); }
+ *     auto final_suspend() noexcept { return react_final_suspend(std::suspend_always()); }
+ *     ...
+ * };
+ * \endcode
+ *
+ * \tparam RecordSuspendedTime Whether time spent in suspension is recorded into "suspended_time" stat
+ */
+template<bool RecordSuspendedTime = false>
+class coroutine_promise_mixin {
+public:
+	coroutine_promise_mixin(): react_scope(RecordSuspendedTime) {}
+
+	template<typename Awaitable>
+	auto await_transform(Awaitable &&awaitable) {
+		return make_scoped_awaiter(std::forward<Awaitable>(awaitable), react_scope);
+	}
+
+	/*!
+	 * \brief Wraps awaiter returned by initial_suspend, coroutine body starts with its react context
+	 */
+	template<typename Awaiter>
+	auto react_initial_suspend(Awaiter &&awaiter) {
+		return scoped_awaiter<Awaiter>(std::forward<Awaiter>(awaiter), react_scope);
+	}
+
+	/*!
+	 * \brief Wraps awaiter returned by final_suspend, context of the thread is restored on completion
+	 */
+	template<typename Awaiter>
+	auto react_final_suspend(Awaiter &&awaiter) noexcept {
+		react_scope.leave();
+		return std::forward<Awaiter>(awaiter);
+	}
+
+protected:
+	/*!
+	 * \brief React context of the coroutine
+	 */
+	coroutine_scope react_scope;
+};
+
+} // namespace react
+
+#endif // __cpp_impl_coroutine
+
+#endif // REACT_COROUTINE_HPP
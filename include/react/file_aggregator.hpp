@@ -0,0 +1,224 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef REACT_FILE_AGGREGATOR_HPP
+#define REACT_FILE_AGGREGATOR_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+#include "aggregator.hpp"
+
+namespace react {
+
+/*!
+ * \brief Compression of files written by file_aggregator_t
+ */
+enum file_compression_t {
+	/*!
+	 * \brief Trees are written as plain json lines
+	 */
+	FILE_COMPRESSION_NONE,
+
+	/*!
+	 * \brief Json lines are written as gzip stream, requires react built with zlib
+	 */
+	FILE_COMPRESSION_GZIP
+};
+
+/*!
+ * \brief Settings of file_aggregator_t
+ */
+struct file_aggregator_config_t {
+	/*!
+	 * \brief Initializes config with default settings and empty path
+	 */
+	file_aggregator_config_t():
+		batch_size(1 << 20), max_pending_size(64 << 20), max_file_size(0),
+		rotation_interval(0), flush_interval(1000),
+		compression(FILE_COMPRESSION_NONE) {}
+
+	/*!
+	 * \brief Path of the file where trees are written, rotated files get numeric suffix
+	 */
+	std::string path;
+
+	/*!
+	 * \brief Size of buffer that is handed over to flush thread when filled
+	 */
+	size_t batch_size;
+
+	/*!
+	 * \brief Maximum size of buffered trees, trees are dropped when flush thread can't keep up
+	 */
+	size_t max_pending_size;
+
+	/*!
+	 * \brief File is rotated when it grows larger than this size, 0 disables size based rotation
+	 */
+	size_t max_file_size;
+
+	/*!
+	 * \brief File is rotated when it is older than this interval, 0 disables time based rotation
+	 */
+	std::chrono::seconds rotation_interval;
+
+	/*!
+	 * \brief Partially filled buffer is written at least once per this interval
+	 */
+	std::chrono::milliseconds flush_interval;
+
+	/*!
+	 * \brief Compression of written files
+	 */
+	file_compression_t compression;
+};
+
+/*!
+ * \brief Aggregator that writes trees to file as json lines
+ *
+ * Trees are serialized on the calling thread and appended to in-memory buffer,
+ * all disk writes, compression and rotation are done by background flush thread with batched writes.
+ */
+class file_aggregator_t : public aggregator_t {
+public:
+	/*!
+	 * \brief Opens file and starts flush thread
+	 * \param config Aggregator settings
+	 */
+	explicit file_aggregator_t(const file_aggregator_config_t &config);
+
+	file_aggregator_t(const file_aggregator_t &other) = delete;
+
+	/*!
+	 * \brief Writes all buffered trees, stops flush thread and closes file
+	 */
+	~file_aggregator_t();
+
+	file_aggregator_t &operator =(const file_aggregator_t &other) = delete;
+
+	/*!
+	 * \brief Serializes call tree and appends it to write buffer
+	 * \param call_tree Tree that will be written
+	 */
+	void aggregate(const call_tree_t &call_tree);
+
+	/*!
+	 * \brief Waits until all trees aggregated before the call are written to file
+	 */
+	void flush();
+
+	/*!
+	 * \brief Returns number of trees dropped due to buffer overflow or write errors
+	 * \return Number of dropped trees
+	 */
+	size_t get_dropped_trees_count() const;
+
+private:
+	class writer_t;
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Main loop of flush thread
+	 */
+	void flush_thread_loop();
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Moves active buffer to pending buffers, must be called under lock
+	 */
+	void seal_active_buffer();
+
+	/*!
+	 * \brief Aggregator settings
+	 */
+	file_aggregator_config_t config;
+
+	/*!
+	 * \brief File writer used by flush thread
+	 */
+	std::unique_ptr<writer_t> writer;
+
+	/*!
+	 * \brief Protects buffers and flush thread state
+	 */
+	mutable std::mutex buffers_mutex;
+
+	/*!
+	 * \brief Wakes up flush thread
+	 */
+	std::condition_variable flush_condition;
+
+	/*!
+	 * \brief Notifies waiters of flush() that buffers were written
+	 */
+	std::condition_variable flushed_condition;
+
+	/*!
+	 * \brief Buffer where serialized trees are appended
+	 */
+	std::string active_buffer;
+
+	/*!
+	 * \brief Filled buffers waiting for flush thread
+	 */
+	std::vector<std::string> pending_buffers;
+
+	/*!
+	 * \brief Written buffers kept for reuse, so that filling new batch doesn't allocate
+	 */
+	std::vector<std::string> free_buffers;
+
+	/*!
+	 * \brief Total size of active and pending buffers
+	 */
+	size_t pending_size;
+
+	/*!
+	 * \brief Number of sealed buffers
+	 */
+	size_t sealed_count;
+
+	/*!
+	 * \brief Number of sealed buffers written by flush thread
+	 */
+	size_t written_count;
+
+	/*!
+	 * \brief Number of dropped trees
+	 */
+	size_t dropped_trees;
+
+	/*!
+	 * \brief Shows that flush thread should write everything and exit
+	 */
+	bool stopping;
+
+	/*!
+	 * \brief Background thread that writes buffers to file
+	 */
+	std::thread flush_thread;
+};
+
+} // namespace react
+
+#endif // REACT_FILE_AGGREGATOR_HPP
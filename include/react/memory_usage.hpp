@@ -0,0 +1,126 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef REACT_MEMORY_USAGE_HPP
+#define REACT_MEMORY_USAGE_HPP
+
+#include <atomic>
+#include <cstddef>
+
+namespace react {
+
+/*!
+ * \brief Process-wide account of memory used by react: call trees, contexts and buffers of aggregators
+ *
+ * Owners report their usage in large steps, so the account is approximate but cheap to keep.
+ * Exceeding soft limit doesn't free anything, it only tells react to stop starting new call trees.
+ */
+class memory_usage_t {
+public:
+	/*!
+	 * \brief Soft limit that is never exceeded
+	 */
+	static const size_t NO_LIMIT = -1;
+
+	/*!
+	 * \brief Initializes empty account without limit
+	 */
+	memory_usage_t(): usage(0), soft_limit(NO_LIMIT), skipped_activations(0) {}
+
+	/*!
+	 * \brief Adds \a size bytes to the account
+	 */
+	void add(size_t size) {
+		usage.fetch_add(size, std::memory_order_relaxed);
+	}
+
+	/*!
+	 * \brief Removes \a size bytes from the account
+	 */
+	void sub(size_t size) {
+		usage.fetch_sub(size, std::memory_order_relaxed);
+	}
+
+	/*!
+	 * \brief Returns number of bytes currently used by react
+	 */
+	size_t get() const {
+		return usage.load(std::memory_order_relaxed);
+	}
+
+	/*!
+	 * \brief Returns soft limit in bytes
+	 */
+	size_t get_soft_limit() const {
+		return soft_limit.load(std::memory_order_relaxed);
+	}
+
+	/*!
+	 * \brief Sets soft limit, new call trees are not started while usage is above it
+	 * \param limit Limit in bytes, NO_LIMIT disables it
+	 */
+	void set_soft_limit(size_t limit) {
+		soft_limit.store(limit, std::memory_order_relaxed);
+	}
+
+	/*!
+	 * \brief Checks whether usage is above soft limit
+	 */
+	bool is_limit_exceeded() const {
+		return get() > get_soft_limit();
+	}
+
+	/*!
+	 * \brief Counts call tree that wasn't started because of soft limit
+	 */
+	void add_skipped_activation() {
+		skipped_activations.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	/*!
+	 * \brief Returns number of call trees that weren't started because of soft limit
+	 */
+	size_t get_skipped_activations() const {
+		return skipped_activations.load(std::memory_order_relaxed);
+	}
+
+private:
+	/*!
+	 * \brief Bytes used by react
+	 */
+	std::atomic<size_t> usage;
+
+	/*!
+	 * \brief Soft limit in bytes
+	 */
+	std::atomic<size_t> soft_limit;
+
+	/*!
+	 * \brief Number of call trees that weren't started because of soft limit
+	 */
+	std::atomic<size_t> skipped_activations;
+};
+
+/*!
+ * \brief Returns account of memory used by react in this process
+ */
+inline memory_usage_t &memory_usage() {
+	static memory_usage_t usage;
+	return usage;
+}
+
+} // namespace react
+
+#endif // REACT_MEMORY_USAGE_HPP
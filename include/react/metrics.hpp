@@ -0,0 +1,349 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef REACT_METRICS_HPP
+#define REACT_METRICS_HPP
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <stdint.h>
+
+#include "call_tree.hpp"
+
+namespace react {
+
+/*!
+ * \brief Totals of single action over all threads
+ */
+struct action_metrics_t {
+	action_metrics_t(): calls(0), total_time(0), errors(0) {}
+
+	/*!
+	 * \brief Number of finished calls
+	 */
+	uint64_t calls;
+
+	/*!
+	 * \brief Time spent in finished calls, in clock ticks of call tree clock
+	 */
+	int64_t total_time;
+
+	/*!
+	 * \brief Number of calls that failed
+	 */
+	uint64_t errors;
+};
+
+/*!
+ * \brief Per-action counters of single thread
+ *
+ * Only the owning thread writes counters, so increments are plain relaxed load and store
+ * without read-modify-write, and readers from other threads see consistent values of each counter.
+ * Counters are stored in chunks that are never moved, so readers don't need to synchronize with growth.
+ * Shard also keeps calls started in the thread while it doesn't record call tree, to count them on stop.
+ */
+class metrics_shard_t {
+public:
+	/*!
+	 * \brief Number of actions in a chunk of counters
+	 */
+	static const size_t CHUNK_SIZE = 256;
+
+	/*!
+	 * \brief Maximum number of chunks, calls of actions with larger codes are not counted
+	 */
+	static const size_t MAX_CHUNKS = 64;
+
+	/*!
+	 * \brief Maximum number of started calls kept by the shard, nested calls are neither checked nor counted
+	 */
+	static const size_t MAX_STARTED_CALLS = 1024;
+
+	metrics_shard_t(): extra_started_calls(0) {
+		for (size_t i = 0; i < MAX_CHUNKS; ++i) {
+			chunks[i].store(NULL, std::memory_order_relaxed);
+		}
+	}
+
+	metrics_shard_t(const metrics_shard_t &other) = delete;
+	metrics_shard_t &operator =(const metrics_shard_t &other) = delete;
+
+	~metrics_shard_t() {
+		for (size_t i = 0; i < MAX_CHUNKS; ++i) {
+			delete [] chunks[i].load(std::memory_order_relaxed);
+		}
+	}
+
+	/*!
+	 * \brief Counts finished call of action with \a action_code that took \a time clock ticks
+	 */
+	void add_call(int action_code, int64_t time) {
+		counters_t *counters = get_counters(action_code);
+		if (counters) {
+			increment<uint64_t>(counters->calls, 1);
+			increment<int64_t>(counters->total_time, time);
+		}
+	}
+
+	/*!
+	 * \brief Counts failed call of action with \a action_code
+	 */
+	void add_error(int action_code) {
+		counters_t *counters = get_counters(action_code);
+		if (counters) {
+			increment<uint64_t>(counters->errors, 1);
+		}
+	}
+
+	/*!
+	 * \brief Starts call of action with \a action_code in thread which doesn't record call tree
+	 * \param action_code Code of started action
+	 * \param is_counted Whether call is counted when it is stopped, start time is not measured otherwise
+	 */
+	void start_call(int action_code, bool is_counted) {
+		if (extra_started_calls || started_calls.size() >= MAX_STARTED_CALLS) {
+			++extra_started_calls;
+			return;
+		}
+
+		started_calls.push_back(started_call_t(action_code, is_counted,
+			is_counted ? call_tree_t::time_clock_t::now() : call_tree_t::time_point_t()));
+	}
+
+	/*!
+	 * \brief Stops last call started by start_call and counts it
+	 *
+	 * Stop without started call is ignored, since the call could be started while thread recorded call tree.
+	 * \param action_code Code of stopped action
+	 * \throw std::logic_error if last started call has another action code, error is counted
+	 */
+	void stop_call(int action_code) {
+		if (extra_started_calls) {
+			--extra_started_calls;
+			return;
+		}
+		if (started_calls.empty()) {
+			return;
+		}
+
+		const started_call_t &call = started_calls.back();
+		if (call.action_code != action_code) {
+			add_error(action_code);
+			throw std::logic_error("Stopping wrong action. Expected code: "
+					+ std::to_string(static_cast<long long>(call.action_code))
+					+ ", Found code: " + std::to_string(static_cast<long long>(action_code)));
+		}
+
+		if (call.is_counted) {
+			add_call(action_code, (call_tree_t::time_clock_t::now() - call.start_time).count());
+		}
+		started_calls.pop_back();
+	}
+
+	/*!
+	 * \brief Adds counters of this shard to \a totals indexed by action code
+	 */
+	void fold_into(std::vector<action_metrics_t> &totals) const {
+		for (size_t chunk = 0; chunk < MAX_CHUNKS; ++chunk) {
+			const counters_t *counters = chunks[chunk].load(std::memory_order_acquire);
+			if (!counters) {
+				continue;
+			}
+
+			for (size_t i = 0; i < CHUNK_SIZE; ++i) {
+				const uint64_t calls = counters[i].calls.load(std::memory_order_relaxed);
+				const uint64_t errors = counters[i].errors.load(std::memory_order_relaxed);
+				if (!calls && !errors) {
+					continue;
+				}
+
+				const size_t action_code = chunk * CHUNK_SIZE + i;
+				if (action_code >= totals.size()) {
+					totals.resize(action_code + 1);
+				}
+				totals[action_code].calls += calls;
+				totals[action_code].total_time += counters[i].total_time.load(std::memory_order_relaxed);
+				totals[action_code].errors += errors;
+			}
+		}
+	}
+
+private:
+	/*!
+	 * \brief Counters of single action
+	 */
+	struct counters_t {
+		counters_t(): calls(0), total_time(0), errors(0) {}
+
+		std::atomic<uint64_t> calls;
+		std::atomic<int64_t> total_time;
+		std::atomic<uint64_t> errors;
+	};
+
+	/*!
+	 * \brief Call started in thread which doesn't record call tree
+	 */
+	struct started_call_t {
+		started_call_t(int action_code, bool is_counted, const call_tree_t::time_point_t &start_time):
+			action_code(action_code), is_counted(is_counted), start_time(start_time) {}
+
+		int action_code;
+		bool is_counted;
+		call_tree_t::time_point_t start_time;
+	};
+
+	template<typename T>
+	static void increment(std::atomic<T> &counter, T delta) {
+		counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Returns counters of \a action_code allocating their chunk on first use, NULL if code is out of range
+	 */
+	counters_t *get_counters(int action_code) {
+		const size_t chunk = static_cast<size_t>(action_code) / CHUNK_SIZE;
+		if (action_code < 0 || chunk >= MAX_CHUNKS) {
+			return NULL;
+		}
+
+		counters_t *counters = chunks[chunk].load(std::memory_order_relaxed);
+		if (!counters) {
+			counters = new counters_t[CHUNK_SIZE];
+			chunks[chunk].store(counters, std::memory_order_release);
+		}
+		return counters + action_code % CHUNK_SIZE;
+	}
+
+	/*!
+	 * \brief Chunks of counters indexed by action code / CHUNK_SIZE
+	 */
+	std::atomic<counters_t *> chunks[MAX_CHUNKS];
+
+	/*!
+	 * \brief Stack of calls started by the owning thread
+	 */
+	std::vector<started_call_t> started_calls;
+
+	/*!
+	 * \brief Number of started calls that didn't fit into the stack
+	 */
+	size_t extra_started_calls;
+};
+
+/*!
+ * \brief Process-wide per-action totals, shards of live threads are folded on read
+ */
+class metrics_registry_t {
+public:
+	/*!
+	 * \brief Adds shard of a thread that started counting
+	 */
+	void register_shard(const metrics_shard_t *shard) {
+		std::lock_guard<std::mutex> guard(mutex);
+		shards.push_back(shard);
+	}
+
+	/*!
+	 * \brief Removes shard of exiting thread, its counters are kept in totals
+	 */
+	void unregister_shard(const metrics_shard_t *shard) {
+		std::lock_guard<std::mutex> guard(mutex);
+		shard->fold_into(retired_totals);
+		shards.erase(std::remove(shards.begin(), shards.end(), shard), shards.end());
+	}
+
+	/*!
+	 * \brief Returns totals of all actions indexed by action code
+	 */
+	std::vector<action_metrics_t> get_metrics() const {
+		std::lock_guard<std::mutex> guard(mutex);
+		std::vector<action_metrics_t> totals = retired_totals;
+		for (auto it = shards.begin(); it != shards.end(); ++it) {
+			(*it)->fold_into(totals);
+		}
+		return totals;
+	}
+
+	/*!
+	 * \brief Returns totals of action with \a action_code
+	 */
+	action_metrics_t get_action_metrics(int action_code) const {
+		const std::vector<action_metrics_t> totals = get_metrics();
+		if (action_code < 0 || static_cast<size_t>(action_code) >= totals.size()) {
+			return action_metrics_t();
+		}
+		return totals[action_code];
+	}
+
+private:
+	/*!
+	 * \brief Protects shards list and totals of exited threads
+	 */
+	mutable std::mutex mutex;
+
+	/*!
+	 * \brief Shards of live threads
+	 */
+	std::vector<const metrics_shard_t *> shards;
+
+	/*!
+	 * \brief Totals of exited threads
+	 */
+	std::vector<action_metrics_t> retired_totals;
+};
+
+/*!
+ * \brief Returns process-wide registry of per-action totals
+ */
+inline metrics_registry_t &metrics_registry() {
+	static metrics_registry_t registry;
+	return registry;
+}
+
+/*!
+ * \internal
+ *
+ * \brief Registers shard of the thread on construction and folds it into totals on thread exit
+ */
+class thread_metrics_shard_holder_t {
+public:
+	thread_metrics_shard_holder_t() {
+		metrics_registry().register_shard(&shard);
+	}
+
+	~thread_metrics_shard_holder_t() {
+		metrics_registry().unregister_shard(&shard);
+	}
+
+	metrics_shard_t shard;
+};
+
+/*!
+ * \brief Returns counters of the calling thread, registers them on first use
+ */
+inline metrics_shard_t &thread_metrics_shard() {
+	static thread_local thread_metrics_shard_holder_t holder;
+	return holder.shard;
+}
+
+} // namespace react
+
+#endif // REACT_METRICS_HPP
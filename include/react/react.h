@@ -18,6 +18,7 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 #ifndef Q_EXTERN_C
 #  ifdef __cplusplus
@@ -27,6 +28,50 @@
 #  endif
 #endif
 
+/*!
+ * \brief 128-bit identifier of call tree or trace
+ */
+typedef struct react_trace_id {
+	uint64_t high;
+	uint64_t low;
+} react_trace_id_t;
+
+/*!
+ * \brief Unit of action times in call tree json
+ */
+typedef enum react_time_unit {
+	REACT_TIME_UNIT_NANOSECONDS,
+	REACT_TIME_UNIT_MICROSECONDS,
+	REACT_TIME_UNIT_MILLISECONDS
+} react_time_unit_t;
+
+/*!
+ * \brief What react records when call trees are activated
+ */
+typedef enum react_record_mode {
+	REACT_RECORD_MODE_OFF,
+	REACT_RECORD_MODE_SAMPLED,
+	REACT_RECORD_MODE_FULL
+} react_record_mode_t;
+
+/*!
+ * \brief How calls of action are handled when react is active
+ */
+typedef enum react_action_state {
+	REACT_ACTION_ENABLED,
+	REACT_ACTION_DISABLED,
+	REACT_ACTION_AGGREGATE_ONLY
+} react_action_state_t;
+
+/*!
+ * \brief Totals of action over all threads of the process
+ */
+typedef struct react_action_metrics {
+	uint64_t calls;
+	uint64_t total_time_ns;
+	uint64_t errors;
+} react_action_metrics_t;
+
 /*!
  * \brief Defines new action with name \a action_name and returns it's code
  * if action with this name already exists, returns it's code
@@ -43,13 +88,160 @@ Q_EXTERN_C int react_is_active();
 
 /*!
  * \brief Creates react thread context for monitoring and sets aggregator as sink
+ *
+ * If call tree is not selected by current record mode or memory used by react exceeds limit
+ * set by react_set_memory_limit, call tree is not started:
+ * thread stays not active until matching react_deactivate and nothing is recorded.
  * \param react_aggregator Aggregator that will be used to collect react trace
  * \return Returns error code
  */
 Q_EXTERN_C int react_activate(void *react_aggregator);
 
+/*!
+ * \brief Same as react_activate, but joins call tree to the trace started elsewhere, e.g. in another service
+ * \param react_aggregator Aggregator that will be used to collect react trace
+ * \param trace_id Identifier of the trace, new trace is started if it is zero
+ * \param parent_id Identifier of the call tree which caused this one, zero if there is none
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_activate_with_parent(void *react_aggregator, react_trace_id_t trace_id, react_trace_id_t parent_id);
+
+/*!
+ * \brief Sets unit of action times of current call tree, microseconds are used by default
+ * \param unit Time unit
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_set_time_unit(react_time_unit_t unit);
+
+/*!
+ * \brief Limits number of actions in current call tree, actions started after the limit are dropped
+ *
+ * Number and time of dropped actions are written to the tree, which is marked as truncated.
+ * \param max_nodes Maximum number of nodes in the tree including root
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_set_max_nodes(size_t max_nodes);
+
+/*!
+ * \brief Returns identifier of current call tree, it should be passed as parent id to downstream services
+ * \param id Where identifier is written
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_get_id(react_trace_id_t *id);
+
+/*!
+ * \brief Returns approximate number of bytes used by react: call trees, contexts and buffers of aggregators
+ */
+Q_EXTERN_C size_t react_get_memory_usage();
+
+/*!
+ * \brief Sets soft limit of memory used by react, new call trees are not started while it is exceeded
+ * \param limit Limit in bytes, 0 removes the limit
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_set_memory_limit(size_t limit);
+
+/*!
+ * \brief Sets soft limit of memory used by react as percentage of physical memory
+ * \param percent Percentage of physical memory, in (0, 100]
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_set_memory_limit_percent(double percent);
+
+/*!
+ * \brief Returns number of call trees that were not started because memory limit was exceeded
+ */
+Q_EXTERN_C size_t react_get_skipped_activations();
+
+/*!
+ * \brief Sets process-wide record mode, it applies to following activations
+ *
+ * Initial mode is full, it can be changed at startup with REACT_RECORD_MODE environment variable
+ * in format of react_set_record_mode_from_string.
+ * \param mode Record mode
+ * \param rate Recorded part of activations in sampled mode, in [0, 1]
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_set_record_mode(react_record_mode_t mode, double rate);
+
+/*!
+ * \brief Sets record mode from string "off", "full" or "sampled:RATE"
+ * \param mode String with record mode
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_set_record_mode_from_string(const char *mode);
+
+/*!
+ * \brief Returns process-wide record mode
+ */
+Q_EXTERN_C react_record_mode_t react_get_record_mode();
+
+/*!
+ * \brief Returns recorded part of activations
+ */
+Q_EXTERN_C double react_get_sample_rate();
+
+/*!
+ * \brief Makes following activations send call trees to \a react_aggregator instead of aggregators passed to them
+ * \param react_aggregator Aggregator that must outlive trees sent to it, NULL removes override
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_set_aggregator_override(void *react_aggregator);
+
+/*!
+ * \brief Installs handler of \a signum that switches record mode, e.g. to turn tracing up with kill -USR1
+ * \param signum Signal number
+ * \param mode Record mode set by the signal
+ * \param rate Recorded part of activations in sampled mode, in [0, 1]
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_set_signal_record_mode(int signum, react_record_mode_t mode, double rate);
+
+/*!
+ * \brief Starts background thread that applies record mode written to file at \a path whenever file changes
+ *
+ * Every line of file contains either mode in format of react_set_record_mode_from_string
+ * or "action:NAME=STATE" in format of react_set_action_state_from_string. Previously watched file is unwatched.
+ * \param path Path of control file
+ * \param interval_ms Interval of file checks in milliseconds
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_watch_control_file(const char *path, unsigned interval_ms);
+
+/*!
+ * \brief Stops watching control file
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_unwatch_control_file();
+
+/*!
+ * \brief Returns identifier of the trace which current call tree belongs to
+ * \param trace_id Where identifier is written
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_get_trace_id(react_trace_id_t *trace_id);
+
+/*!
+ * \brief Parses trace identifier from hex string
+ * \param str Hex string of up to 32 characters
+ * \param trace_id Where identifier is written
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_trace_id_from_string(const char *str, react_trace_id_t *trace_id);
+
+/*!
+ * \brief Writes hex representation of trace identifier with terminating zero
+ * \param trace_id Trace identifier
+ * \param buffer Buffer for the string
+ * \param size Size of \a buffer, must be at least 33
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_trace_id_to_string(react_trace_id_t trace_id, char *buffer, size_t size);
+
 /*!
  * \brief Sends thread context to aggregator and cleanups context
+ *
+ * Context adopted by react_adopt_context can't be deactivated, it is left with react_leave_context.
  * \return Returns error code
  */
 Q_EXTERN_C int react_deactivate();
@@ -68,14 +260,185 @@ Q_EXTERN_C int react_start_action(int action_code);
  */
 Q_EXTERN_C int react_stop_action(int action_code);
 
+/*!
+ * \brief TLS model of thread context pointer
+ *
+ * Initial-exec model lets inline functions below read the pointer with single instruction
+ * instead of __tls_get_addr call. Library built with REACT_DYNAMIC_TLS uses default model,
+ * which is needed if it is loaded with dlopen into process that has no spare static TLS.
+ */
+#if defined(__GNUC__) && !defined(REACT_DYNAMIC_TLS)
+#  define REACT_TLS_MODEL __attribute__((tls_model("initial-exec")))
+#else
+#  define REACT_TLS_MODEL
+#endif
+
+struct react_context_t;
+
+/*!
+ * \internal
+ *
+ * \brief Context of the calling thread, NULL if react is not active. Must not be changed outside of the library
+ */
+Q_EXTERN_C __thread struct react_context_t *react_thread_context REACT_TLS_MODEL;
+
+/*!
+ * \internal
+ *
+ * \brief Nonzero if calls in threads where react is not active are counted in metrics.
+ * Must not be changed outside of the library, use react_set_inactive_metrics
+ */
+Q_EXTERN_C int react_inactive_metrics;
+
+/*!
+ * \internal
+ *
+ * \brief Checks whether start or stop of action has to call into the library
+ */
+static inline int react_needs_library_call(void) {
+#ifdef __GNUC__
+	return react_thread_context != NULL || __atomic_load_n(&react_inactive_metrics, __ATOMIC_RELAXED);
+#else
+	return react_thread_context != NULL || react_inactive_metrics;
+#endif
+}
+
+/*!
+ * \brief Inline version of react_is_active, that doesn't call into the library
+ * \return Returns 1 if react monitoring is on and 0 otherwise
+ */
+static inline int react_is_active_fast(void) {
+	return react_thread_context != NULL;
+}
+
+/*!
+ * \brief Inline version of react_start_action, that calls into the library only if react is active
+ * or calls of not active threads are counted in metrics
+ * \param action_code Code of action which will be started
+ * \return Returns error code
+ */
+static inline int react_start_action_fast(int action_code) {
+	return react_needs_library_call() ? react_start_action(action_code) : 0;
+}
+
+/*!
+ * \brief Inline version of react_stop_action, that calls into the library only if react is active
+ * or calls of not active threads are counted in metrics
+ * \param action_code Code of action which will be stopped
+ * \return Returns error code
+ */
+static inline int react_stop_action_fast(int action_code) {
+	return react_needs_library_call() ? react_stop_action(action_code) : 0;
+}
+
+/*!
+ * \brief Turns on or off counting of calls in threads where react is not active, it is off by default
+ *
+ * When it is off, metrics count only calls of recorded threads and inline functions above
+ * and react::action_guard cost single TLS read in not active threads. When it is on,
+ * every start and stop in such threads calls into the library and reads the clock.
+ * \param enabled Nonzero to count calls
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_set_inactive_metrics(int enabled);
+
+/*!
+ * \brief Returns 1 if calls in threads where react is not active are counted in metrics and 0 otherwise
+ */
+Q_EXTERN_C int react_get_inactive_metrics(void);
+
+/*!
+ * \brief Counts failed call of action in process-wide metrics, works whether react is active or not
+ * \param action_code Code of failed action
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_add_action_error(int action_code);
+
+/*!
+ * \brief Returns calls, total time and errors of action counted by all threads
+ *
+ * Calls are counted when actions are stopped in threads that record call tree,
+ * including calls that have no node in the tree: aggregate only, too deep and dropped ones,
+ * and in other threads if react_set_inactive_metrics is on.
+ * Calls of disabled actions are not counted. Counters of threads are summed on read.
+ * \param action_code Code of action
+ * \param metrics Where totals are written
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_get_action_metrics(int action_code, react_action_metrics_t *metrics);
+
+/*!
+ * \brief Changes state of action in all threads, e.g. to stop recording hot actions while keeping their parents
+ *
+ * Disabled actions don't create nodes and don't measure time, aggregate only actions are counted
+ * in process-wide metrics without creating nodes, also in not recorded threads if react_set_inactive_metrics is on.
+ * Calls started before the change keep their state.
+ * \param action_code Code of action
+ * \param state New state of action
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_set_action_state(int action_code, react_action_state_t state);
+
+/*!
+ * \brief Changes state of action from string "NAME=STATE", where STATE is "enabled", "disabled" or "aggregate"
+ * \param action_state String with action name and state
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_set_action_state_from_string(const char *action_state);
+
+/*!
+ * \brief Returns state of action
+ * \param action_code Code of action
+ * \param state Where state is written
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_get_action_state(int action_code, react_action_state_t *state);
+
+/*!
+ * \brief Defines new stat key with name \a stat_name and returns it's code
+ * if stat with this name already exists, returns it's code
+ * \param stat_name Name for new stat
+ * \return Code of stat with \a stat_name
+ */
+Q_EXTERN_C int react_define_new_stat(const char *stat_name);
+
 /*!
  *  Functions that allow to put different stats into current react context
  */
 Q_EXTERN_C int react_add_stat_bool(const char *key, bool value);
 Q_EXTERN_C int react_add_stat_int(const char *key, int value);
+Q_EXTERN_C int react_add_stat_int64(const char *key, int64_t value);
+Q_EXTERN_C int react_add_stat_uint64(const char *key, uint64_t value);
 Q_EXTERN_C int react_add_stat_double(const char *key, double value);
 Q_EXTERN_C int react_add_stat_string(const char *key, const char *value);
 
+/*!
+ *  Functions that allow to put stats with codes returned by react_define_new_stat into current react context.
+ *  Unlike functions above they don't lookup stat by it's name.
+ */
+Q_EXTERN_C int react_add_stat_bool_by_code(int stat_code, bool value);
+Q_EXTERN_C int react_add_stat_int_by_code(int stat_code, int value);
+Q_EXTERN_C int react_add_stat_int64_by_code(int stat_code, int64_t value);
+Q_EXTERN_C int react_add_stat_uint64_by_code(int stat_code, uint64_t value);
+Q_EXTERN_C int react_add_stat_double_by_code(int stat_code, double value);
+Q_EXTERN_C int react_add_stat_string_by_code(int stat_code, const char *value);
+
+/*!
+ *  Functions that update numeric stats with codes returned by react_define_new_stat in current react context.
+ *  Counters are incremented, gauges keep maximum or minimum of all passed values.
+ *  Counters and gauges of subthreads are merged into parent context.
+ */
+Q_EXTERN_C int react_increment_stat(int stat_code, int64_t delta);
+Q_EXTERN_C int react_update_stat_max(int stat_code, int64_t value);
+Q_EXTERN_C int react_update_stat_min(int stat_code, int64_t value);
+
+/*!
+ *  Same as above, but stats are attached to the current action instead of the whole call tree
+ */
+Q_EXTERN_C int react_increment_node_stat(int stat_code, int64_t delta);
+Q_EXTERN_C int react_update_node_stat_max(int stat_code, int64_t value);
+Q_EXTERN_C int react_update_node_stat_min(int stat_code, int64_t value);
+
 /*!
  * \brief Submits current context to aggregator
  */
@@ -95,4 +458,130 @@ Q_EXTERN_C void *react_create_subthread_aggregator();
  */
 Q_EXTERN_C int react_destroy_subthread_aggregator(void *subthread_aggregator);
 
+/*!
+ * \brief Captures current thread context and action, so that tasks of thread pools could adopt it
+ *          Captured context must stay active until all tasks that adopt it are finished.
+ * \return Returns pointer to newly created token or NULL if react is not active
+ */
+Q_EXTERN_C void *react_capture_context();
+
+/*!
+ * \brief Destroys token created by react_capture_context
+ * \param token Token that will be destroyed
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_release_context(void *token);
+
+/*!
+ * \brief Makes captured context current for executor task, must be paired with react_leave_context
+ * \param token Token created by react_capture_context
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_adopt_context(void *token);
+
+/*!
+ * \brief Merges actions recorded since react_adopt_context into captured context and restores previous one
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_leave_context();
+
+/*!
+ * \brief Creates context that is not bound to any thread, e.g. one per request of event loop
+ *          Contexts are taken from pool, so creation doesn't allocate in steady state.
+ *
+ * Record mode, aggregator override and memory limit apply as in react_activate. If tree is not recorded,
+ * returned handle is shared by all such contexts: calls with it succeed and do nothing,
+ * react_context_get_id returns zero id and react_context_finish only releases it.
+ * \param react_aggregator Aggregator which receives tree on react_context_finish
+ * \return Returns context handle or NULL on error
+ */
+Q_EXTERN_C void *react_context_create(void *react_aggregator);
+
+/*!
+ * \brief Creates context that continues trace \a trace_id of another process, same as react_context_create
+ * \param react_aggregator Aggregator which receives tree on react_context_finish
+ * \param trace_id Trace that the tree belongs to, null id starts new trace
+ * \param parent_id Id of parent tree
+ * \return Returns context handle or NULL on error
+ */
+Q_EXTERN_C void *react_context_create_with_parent(void *react_aggregator,
+		react_trace_id_t trace_id, react_trace_id_t parent_id);
+
+/*!
+ * \brief Submits tree of context to aggregator and returns context to pool
+ * \param context Context handle, it can't be used after the call
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_context_finish(void *context);
+
+/*!
+ * \brief Sets unit of action times of context's call tree
+ * \param context Context handle
+ * \param unit Time unit
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_context_set_time_unit(void *context, react_time_unit_t unit);
+
+/*!
+ * \brief Limits number of actions in context's call tree
+ * \param context Context handle
+ * \param max_nodes Maximum number of nodes in the tree including root
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_context_set_max_nodes(void *context, size_t max_nodes);
+
+/*!
+ * \brief Gets id of context's call tree
+ * \param context Context handle
+ * \param id Where id is written
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_context_get_id(void *context, react_trace_id_t *id);
+
+/*!
+ * \brief Starts action with \a action_code in \a context
+ * \param context Context handle
+ * \param action_code Action's code
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_context_start_action(void *context, int action_code);
+
+/*!
+ * \brief Stops action with \a action_code in \a context
+ * \param context Context handle
+ * \param action_code Action's code
+ * \return Returns error code
+ */
+Q_EXTERN_C int react_context_stop_action(void *context, int action_code);
+
+/*!
+ * \brief Adds stat with \a key and \a value to call tree of \a context
+ */
+Q_EXTERN_C int react_context_add_stat_bool(void *context, const char *key, bool value);
+Q_EXTERN_C int react_context_add_stat_int(void *context, const char *key, int value);
+Q_EXTERN_C int react_context_add_stat_int64(void *context, const char *key, int64_t value);
+Q_EXTERN_C int react_context_add_stat_uint64(void *context, const char *key, uint64_t value);
+Q_EXTERN_C int react_context_add_stat_double(void *context, const char *key, double value);
+Q_EXTERN_C int react_context_add_stat_string(void *context, const char *key, const char *value);
+
+/*!
+ * \brief Sets registered stat \a stat_code of \a context's call tree to \a value
+ */
+Q_EXTERN_C int react_context_add_stat_bool_by_code(void *context, int stat_code, bool value);
+Q_EXTERN_C int react_context_add_stat_int_by_code(void *context, int stat_code, int value);
+Q_EXTERN_C int react_context_add_stat_int64_by_code(void *context, int stat_code, int64_t value);
+Q_EXTERN_C int react_context_add_stat_uint64_by_code(void *context, int stat_code, uint64_t value);
+Q_EXTERN_C int react_context_add_stat_double_by_code(void *context, int stat_code, double value);
+Q_EXTERN_C int react_context_add_stat_string_by_code(void *context, int stat_code, const char *value);
+
+/*!
+ * \brief Updates registered stat \a stat_code of \a context's call tree or its current action
+ */
+Q_EXTERN_C int react_context_increment_stat(void *context, int stat_code, int64_t delta);
+Q_EXTERN_C int react_context_update_stat_max(void *context, int stat_code, int64_t value);
+Q_EXTERN_C int react_context_update_stat_min(void *context, int stat_code, int64_t value);
+Q_EXTERN_C int react_context_increment_node_stat(void *context, int stat_code, int64_t delta);
+Q_EXTERN_C int react_context_update_node_stat_max(void *context, int stat_code, int64_t value);
+Q_EXTERN_C int react_context_update_node_stat_min(void *context, int stat_code, int64_t value);
+
 #endif // REACT_H
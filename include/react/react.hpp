@@ -24,25 +24,52 @@
 
 #include "react.h"
 
+struct react_context_t;
+
 namespace react {
 
 /*!
- * \brief Wrapper for action_guard_t with binded updater from local context
+ * \brief Guard of action in thread local context
+ *
+ * Guard keeps updater of the context and action's code inline, so guarding an action doesn't allocate.
+ * Guard is movable, so it can be captured by lambdas and stored in containers,
+ * moved-from guard doesn't stop anything.
  */
 class action_guard {
 public:
 	/*!
 	 * \brief Creates action_guard and starts action with \a action_code
+	 *
+	 * Activity is checked inline, so guard costs single TLS read when react is not active
+	 * and calls of not active threads are not counted in metrics.
 	 * \param Code of started action
 	 */
-	explicit action_guard(int action_code);
+	explicit action_guard(int action_code): updater(NULL), action_code(action_code), is_inactive_call(false) {
+		if (react_needs_library_call()) {
+			start();
+		}
+	}
+
+	/*!
+	 * \brief Takes action guarded by \a other
+	 */
+	action_guard(action_guard &&other) noexcept;
 
 	action_guard(const action_guard &other) = delete;
 
 	/*!
 	 * \brief Stops guarded action.
 	 */
-	~action_guard();
+	~action_guard() {
+		if (updater || is_inactive_call) {
+			release();
+		}
+	}
+
+	/*!
+	 * \brief Stops guarded action and takes action guarded by \a other
+	 */
+	action_guard &operator =(action_guard &&other);
 
 	action_guard &operator =(const action_guard &other) = delete;
 
@@ -53,9 +80,33 @@ public:
 
 private:
 	/*!
-	 * \brief Wrapped action_guard_t
+	 * \internal
+	 *
+	 * \brief Starts guarded action in thread context or in metrics if react is not active
+	 */
+	void start();
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Stops guarded action if there is one, errors are logged
+	 */
+	void release();
+
+	/*!
+	 * \brief Updater of the context where action was started, NULL if action is not recorded
 	 */
-	std::unique_ptr<react::action_guard_t> m_action_guard;
+	call_tree_updater_t *updater;
+
+	/*!
+	 * \brief Code of guarded action, NO_ACTION after action is stopped
+	 */
+	int action_code;
+
+	/*!
+	 * \brief Shows if action was started in metrics of the thread because react is not active
+	 */
+	bool is_inactive_call;
 };
 
 /*!
@@ -86,6 +137,96 @@ void add_stat(const std::string &key, const T &value) {
  */
 void add_stat(const std::string &key, const char *value);
 
+/*!
+ * \internal
+ *
+ * \brief Adds new stat with registered code to current call tree
+ * \param stat_code Code of stat returned by react_define_new_stat
+ * \param value Value of stat
+ */
+void add_stat_impl(int stat_code, const react::stat_value_t &value);
+
+/*!
+ * \brief Template wrapper for add_stat_impl. Avoids stat lookup by name.
+ */
+template<typename T>
+void add_stat(int stat_code, const T &value) {
+	add_stat_impl(stat_code, react::stat_value_t(value));
+}
+
+/*!
+ * \brief Template specification for add_stat by code that handles char* correctly.
+ */
+void add_stat(int stat_code, const char *value);
+
+/*!
+ * \internal
+ *
+ * \brief Updates stat with registered code in current call tree
+ * \param stat_code Code of stat returned by react_define_new_stat
+ * \param kind Kind of update: value, counter, max or min
+ * \param value Value used for update
+ */
+void update_stat_impl(int stat_code, stat_kind_t kind, const react::stat_value_t &value);
+
+/*!
+ * \internal
+ *
+ * \brief Updates stat with registered code attached to current action
+ * \param stat_code Code of stat returned by react_define_new_stat
+ * \param kind Kind of update: value, counter, max or min
+ * \param value Value used for update
+ */
+void update_node_stat_impl(int stat_code, stat_kind_t kind, const react::stat_value_t &value);
+
+/*!
+ * \brief Increments counter of current call tree
+ */
+template<typename T>
+void increment_stat(int stat_code, const T &delta) {
+	update_stat_impl(stat_code, STAT_COUNTER, react::stat_value_t(delta));
+}
+
+/*!
+ * \brief Keeps maximum of passed values in current call tree
+ */
+template<typename T>
+void update_stat_max(int stat_code, const T &value) {
+	update_stat_impl(stat_code, STAT_MAX, react::stat_value_t(value));
+}
+
+/*!
+ * \brief Keeps minimum of passed values in current call tree
+ */
+template<typename T>
+void update_stat_min(int stat_code, const T &value) {
+	update_stat_impl(stat_code, STAT_MIN, react::stat_value_t(value));
+}
+
+/*!
+ * \brief Increments counter of current action
+ */
+template<typename T>
+void increment_node_stat(int stat_code, const T &delta) {
+	update_node_stat_impl(stat_code, STAT_COUNTER, react::stat_value_t(delta));
+}
+
+/*!
+ * \brief Keeps maximum of passed values in current action
+ */
+template<typename T>
+void update_node_stat_max(int stat_code, const T &value) {
+	update_node_stat_impl(stat_code, STAT_MAX, react::stat_value_t(value));
+}
+
+/*!
+ * \brief Keeps minimum of passed values in current action
+ */
+template<typename T>
+void update_node_stat_min(int stat_code, const T &value) {
+	update_node_stat_impl(stat_code, STAT_MIN, react::stat_value_t(value));
+}
+
 /*!
  * \brief Creates aggregator that can be passed to subthread in order to monitor it
  *          and merge result of monitoring with current thread context
@@ -93,6 +234,135 @@ void add_stat(const std::string &key, const char *value);
  */
 std::shared_ptr<aggregator_t> create_subthread_aggregator();
 
+/*!
+ * \brief Captured react context and action, allows to continue monitoring in tasks executed by thread pools
+ *
+ * Token is plain pair of pointers, so it is cheap to copy into every task.
+ * Captured context must stay active until all tasks that adopt it are finished.
+ */
+class context_token {
+public:
+	/*!
+	 * \brief Creates empty token, adopting it does nothing
+	 */
+	context_token(): context(NULL), node(+call_tree_t::NO_NODE) {}
+
+	/*!
+	 * \brief Checks whether token holds captured context
+	 * \return True if no context was captured, false otherwise
+	 */
+	bool empty() const {
+		return context == NULL;
+	}
+
+private:
+	friend context_token capture_context();
+	friend class adopt_guard;
+	friend int ::react_adopt_context(void *token);
+
+	context_token(react_context_t *context, call_tree_t::p_node_t node):
+		context(context), node(node) {}
+
+	/*!
+	 * \brief Captured context
+	 */
+	react_context_t *context;
+
+	/*!
+	 * \brief Action of captured context under which tasks will be merged
+	 */
+	call_tree_t::p_node_t node;
+};
+
+/*!
+ * \brief Captures current thread context and current action
+ * \return Token which can be adopted by another thread or empty token if react is not active
+ */
+context_token capture_context();
+
+/*!
+ * \brief Makes captured context current for the scope of executor task
+ *
+ * Actions and stats of the task are recorded into per-thread buffer, which is reused between tasks.
+ * On guard destruction recorded actions are merged under captured action, tasks that recorded nothing
+ * don't touch captured context at all. Previous context of the thread is restored.
+ */
+class adopt_guard {
+public:
+	/*!
+	 * \brief Adopts context captured in \a token
+	 * \param token Captured context, guard does nothing if it is empty
+	 */
+	explicit adopt_guard(const context_token &token);
+
+	adopt_guard(const adopt_guard &other) = delete;
+
+	/*!
+	 * \brief Merges recorded actions into captured context and restores previous context
+	 */
+	~adopt_guard();
+
+	adopt_guard &operator =(const adopt_guard &other) = delete;
+
+private:
+	/*!
+	 * \brief Shows whether context was adopted
+	 */
+	bool adopted;
+};
+
+/*!
+ * \brief React context of the thread together with its activation count
+ *
+ * Used to move context between threads when execution of request is suspended and resumed,
+ * e.g. by coroutines. Unlike context_token it transfers ownership of the whole context.
+ */
+class context_state {
+public:
+	/*!
+	 * \brief Creates state of thread without react context
+	 */
+	context_state(): context(NULL), refcount(0) {}
+
+	/*!
+	 * \brief Checks whether state holds react context
+	 * \return True if there is no react context, false otherwise
+	 */
+	bool empty() const {
+		return context == NULL;
+	}
+
+private:
+	friend context_state get_context_state();
+	friend context_state exchange_context(const context_state &state);
+
+	context_state(react_context_t *context, int refcount):
+		context(context), refcount(refcount) {}
+
+	/*!
+	 * \brief Thread context
+	 */
+	react_context_t *context;
+
+	/*!
+	 * \brief Number of activations of thread context
+	 */
+	int refcount;
+};
+
+/*!
+ * \brief Returns state of calling thread
+ * \return Current react context of the thread
+ */
+context_state get_context_state();
+
+/*!
+ * \brief Makes \a state current for calling thread
+ * \param state State that will be installed, empty state detaches react context from the thread
+ * \return Previous state of the thread
+ */
+context_state exchange_context(const context_state &state);
+
 } // namespace react
 
 #endif // REACT_HPP
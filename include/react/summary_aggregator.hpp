@@ -0,0 +1,181 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef REACT_SUMMARY_AGGREGATOR_HPP
+#define REACT_SUMMARY_AGGREGATOR_HPP
+
+#include <mutex>
+#include <chrono>
+
+#include "aggregator.hpp"
+#include "columnar_call_tree.hpp"
+#include "action_reduce.hpp"
+
+namespace react {
+
+/*!
+ * \brief Aggregator that keeps per-action calls number and durations of all aggregated trees
+ *
+ * Each tree is converted to reused columnar snapshot, which is reduced by vector kernels.
+ * Optionally keeps per-action histogram of durations.
+ */
+class summary_aggregator_t : public aggregator_t {
+public:
+	/*!
+	 * \brief Constructs aggregator
+	 * \param actions_set Set of actions used for naming actions in json
+	 * \param histogram_bounds Sorted bounds of histogram buckets in microseconds, histogram is not kept if empty
+	 */
+	summary_aggregator_t(const actions_set_t &actions_set,
+			const std::vector<int64_t> &histogram_bounds = std::vector<int64_t>()):
+		actions_set(actions_set), trees_count(0) {
+		for (auto it = histogram_bounds.begin(); it != histogram_bounds.end(); ++it) {
+			histogram.bounds.push_back(
+				call_tree_t::time_clock_t::duration(std::chrono::microseconds(*it)).count()
+			);
+		}
+	}
+
+	/*!
+	 * \brief Frees memory consumed by summary aggregator
+	 */
+	~summary_aggregator_t() {}
+
+	/*!
+	 * \brief Adds actions of \a call_tree to summaries
+	 * \param call_tree Tree that will be aggregated
+	 */
+	void aggregate(const call_tree_t &call_tree) {
+		std::lock_guard<std::mutex> guard(summaries_mutex);
+		snapshot.assign(call_tree);
+		reduce_actions(snapshot, summaries, histogram.bounds.empty() ? NULL : &histogram);
+		++trees_count;
+	}
+
+	/*!
+	 * \brief Returns summaries indexed by action code, durations are in clock ticks
+	 */
+	std::vector<action_summary_t> get_summaries() const {
+		std::lock_guard<std::mutex> guard(summaries_mutex);
+		return summaries;
+	}
+
+	/*!
+	 * \brief Returns histogram of durations, bounds are in clock ticks
+	 */
+	action_histogram_t get_histogram() const {
+		std::lock_guard<std::mutex> guard(summaries_mutex);
+		return histogram;
+	}
+
+	/*!
+	 * \brief Returns number of aggregated trees
+	 */
+	size_t get_trees_count() const {
+		std::lock_guard<std::mutex> guard(summaries_mutex);
+		return trees_count;
+	}
+
+	/*!
+	 * \brief Converts summaries to json, durations are in microseconds
+	 * \param stat_value Json node for writing
+	 * \param allocator Json allocator
+	 * \return Modified json node
+	 */
+	rapidjson::Value& to_json(rapidjson::Value &stat_value,
+							  rapidjson::Document::AllocatorType &allocator) const {
+		std::lock_guard<std::mutex> guard(summaries_mutex);
+
+		stat_value.AddMember("trees", static_cast<uint64_t>(trees_count), allocator);
+
+		if (!histogram.bounds.empty()) {
+			rapidjson::Value bounds_value(rapidjson::kArrayType);
+			for (auto it = histogram.bounds.begin(); it != histogram.bounds.end(); ++it) {
+				bounds_value.PushBack(to_microseconds(*it), allocator);
+			}
+			stat_value.AddMember("histogram_bounds", bounds_value, allocator);
+		}
+
+		rapidjson::Value actions_value(rapidjson::kArrayType);
+		for (size_t action_code = 0; action_code < summaries.size(); ++action_code) {
+			const action_summary_t &summary = summaries[action_code];
+			if (!summary.calls) {
+				continue;
+			}
+
+			rapidjson::Value action_value(rapidjson::kObjectType);
+			const std::string action_name = actions_set.get_action_name(action_code);
+			rapidjson::Value action_name_value(action_name.c_str(), action_name.size(), allocator);
+			action_value.AddMember("name", action_name_value, allocator);
+			action_value.AddMember("calls", summary.calls, allocator);
+			action_value.AddMember("total_time", to_microseconds(summary.total_time), allocator);
+			action_value.AddMember("min_time", to_microseconds(summary.min_time), allocator);
+			action_value.AddMember("max_time", to_microseconds(summary.max_time), allocator);
+
+			if (!histogram.bounds.empty()) {
+				rapidjson::Value histogram_value(rapidjson::kArrayType);
+				for (size_t bucket = 0; bucket < histogram.buckets_count(); ++bucket) {
+					histogram_value.PushBack(histogram.get_count(action_code, bucket), allocator);
+				}
+				action_value.AddMember("histogram", histogram_value, allocator);
+			}
+			actions_value.PushBack(action_value, allocator);
+		}
+		stat_value.AddMember("actions", actions_value, allocator);
+
+		return stat_value;
+	}
+
+private:
+	static int64_t to_microseconds(int64_t ticks) {
+		return std::chrono::duration_cast<std::chrono::microseconds>(
+			call_tree_t::time_clock_t::duration(ticks)
+		).count();
+	}
+
+	/*!
+	 * \brief Set of actions used for naming actions in json
+	 */
+	const actions_set_t &actions_set;
+
+	/*!
+	 * \brief Protects summaries
+	 */
+	mutable std::mutex summaries_mutex;
+
+	/*!
+	 * \brief Snapshot reused for every aggregated tree
+	 */
+	columnar_call_tree_t snapshot;
+
+	/*!
+	 * \brief Summaries indexed by action code
+	 */
+	std::vector<action_summary_t> summaries;
+
+	/*!
+	 * \brief Histogram of durations, empty if it is not kept
+	 */
+	action_histogram_t histogram;
+
+	/*!
+	 * \brief Number of aggregated trees
+	 */
+	size_t trees_count;
+};
+
+} // namespace react
+
+#endif // REACT_SUMMARY_AGGREGATOR_HPP
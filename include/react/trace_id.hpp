@@ -0,0 +1,124 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef REACT_TRACE_ID_HPP
+#define REACT_TRACE_ID_HPP
+
+#include <string>
+#include <stdexcept>
+#include <stdint.h>
+
+namespace react {
+
+/*!
+ * \brief 128-bit identifier of call tree or trace, hex encoded only for output
+ */
+struct trace_id_t {
+	/*!
+	 * \brief Length of hex representation of trace id
+	 */
+	static const size_t STRING_LENGTH = 32;
+
+	/*!
+	 * \brief Initializes null trace id
+	 */
+	trace_id_t(): high(0), low(0) {}
+
+	/*!
+	 * \brief Initializes trace id with \a high and \a low halves
+	 */
+	trace_id_t(uint64_t high, uint64_t low): high(high), low(low) {}
+
+	/*!
+	 * \brief Checks whether trace id is null, i.e. not set
+	 * \return True if trace id is null, false otherwise
+	 */
+	bool is_null() const {
+		return high == 0 && low == 0;
+	}
+
+	/*!
+	 * \brief Writes hex representation of trace id into \a buffer without terminating zero
+	 * \param buffer Buffer of at least STRING_LENGTH bytes
+	 */
+	void write_string(char *buffer) const {
+		static const char digits[] = "0123456789abcdef";
+		for (size_t i = 0; i < 16; ++i) {
+			buffer[i] = digits[(high >> (60 - 4 * i)) & 0xf];
+			buffer[i + 16] = digits[(low >> (60 - 4 * i)) & 0xf];
+		}
+	}
+
+	/*!
+	 * \brief Returns hex representation of trace id
+	 * \return Hex string of STRING_LENGTH characters
+	 */
+	std::string to_string() const {
+		char buffer[STRING_LENGTH];
+		write_string(buffer);
+		return std::string(buffer, STRING_LENGTH);
+	}
+
+	/*!
+	 * \brief Parses trace id from hex string of up to STRING_LENGTH characters
+	 * \param str Hex string
+	 * \return Parsed trace id
+	 */
+	static trace_id_t from_string(const std::string &str) {
+		if (str.empty() || str.size() > STRING_LENGTH) {
+			throw std::invalid_argument("Can't parse trace id: invalid length: " + str);
+		}
+
+		trace_id_t id;
+		for (size_t i = 0; i < str.size(); ++i) {
+			char c = str[i];
+			uint64_t digit;
+			if (c >= '0' && c <= '9') {
+				digit = c - '0';
+			} else if (c >= 'a' && c <= 'f') {
+				digit = c - 'a' + 10;
+			} else if (c >= 'A' && c <= 'F') {
+				digit = c - 'A' + 10;
+			} else {
+				throw std::invalid_argument("Can't parse trace id: invalid character: " + str);
+			}
+			id.high = (id.high << 4) | (id.low >> 60);
+			id.low = (id.low << 4) | digit;
+		}
+		return id;
+	}
+
+	bool operator ==(const trace_id_t &other) const {
+		return high == other.high && low == other.low;
+	}
+
+	bool operator !=(const trace_id_t &other) const {
+		return !(*this == other);
+	}
+
+	/*!
+	 * \brief Higher 64 bits of trace id
+	 */
+	uint64_t high;
+
+	/*!
+	 * \brief Lower 64 bits of trace id
+	 */
+	uint64_t low;
+};
+
+} // namespace react
+
+#endif // REACT_TRACE_ID_HPP
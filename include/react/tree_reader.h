@@ -0,0 +1,113 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef REACT_TREE_READER_H
+#define REACT_TREE_READER_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef Q_EXTERN_C
+#  ifdef __cplusplus
+#    define Q_EXTERN_C extern "C"
+#  else
+#    define Q_EXTERN_C extern
+#  endif
+#endif
+
+/*!
+ * \brief Type of stat value passed to react_tree_reader_callbacks_t::stat
+ */
+typedef enum react_json_type {
+	REACT_JSON_NULL,
+	REACT_JSON_BOOL,
+	REACT_JSON_INT64,
+	REACT_JSON_UINT64,
+	REACT_JSON_DOUBLE,
+	REACT_JSON_STRING
+} react_json_type_t;
+
+/*!
+ * \brief Scalar stat value, string points into parser buffer and is valid only during the callback
+ */
+typedef struct react_json_value {
+	react_json_type_t type;
+	union {
+		bool bool_value;
+		int64_t int64_value;
+		uint64_t uint64_value;
+		double double_value;
+	} value;
+	const char *string_value;
+	size_t string_length;
+} react_json_value_t;
+
+/*!
+ * \brief Callbacks of react_tree_reader_t, any of them may be NULL
+ *
+ * Times are in nanoseconds since epoch, names and keys are valid only during the callback.
+ */
+typedef struct react_tree_reader_callbacks {
+	void (*tree_begin)(void *user_data);
+	void (*node_enter)(void *user_data, int action_id, const char *name, size_t name_length,
+			int64_t start_time, int64_t stop_time);
+	void (*node_exit)(void *user_data);
+	void (*stat)(void *user_data, const char *key, size_t key_length, const react_json_value_t *value);
+	void (*tree_end)(void *user_data, const char *id, size_t id_length);
+} react_tree_reader_callbacks_t;
+
+/*!
+ * \brief Streaming reader of call trees in react json
+ */
+typedef struct react_tree_reader react_tree_reader_t;
+
+/*!
+ * \brief Creates reader that passes events of parsed trees to \a callbacks
+ * \param callbacks Callbacks, copied into reader
+ * \param user_data Argument passed to every callback
+ * \return New reader or NULL on error
+ */
+Q_EXTERN_C react_tree_reader_t *react_tree_reader_create(const react_tree_reader_callbacks_t *callbacks,
+		void *user_data);
+
+/*!
+ * \brief Destroys reader created by react_tree_reader_create
+ */
+Q_EXTERN_C void react_tree_reader_destroy(react_tree_reader_t *reader);
+
+/*!
+ * \brief Parses all trees in buffer: single json document or json lines
+ * \return Number of documents that failed to parse or negative error code
+ */
+Q_EXTERN_C int react_tree_reader_parse(react_tree_reader_t *reader, const char *data, size_t size);
+
+/*!
+ * \brief Parses all trees in file at \a path
+ * \return Number of documents that failed to parse or negative error code
+ */
+Q_EXTERN_C int react_tree_reader_parse_file(react_tree_reader_t *reader, const char *path);
+
+/*!
+ * \brief Returns name of action with \a action_id reported by node_enter, NULL if id is invalid
+ */
+Q_EXTERN_C const char *react_tree_reader_get_action_name(react_tree_reader_t *reader, int action_id);
+
+/*!
+ * \brief Returns number of distinct action names seen by reader
+ */
+Q_EXTERN_C size_t react_tree_reader_get_actions_count(react_tree_reader_t *reader);
+
+#endif // REACT_TREE_READER_H
@@ -0,0 +1,656 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef REACT_TREE_READER_HPP
+#define REACT_TREE_READER_HPP
+
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "rapidjson/reader.h"
+
+namespace react {
+
+/*!
+ * \brief Read-only memory mapping of the whole file
+ */
+class mapped_file_t {
+public:
+	explicit mapped_file_t(const std::string &path): data(NULL), size(0) {
+		int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0) {
+			throw std::runtime_error("Can't open file " + path + ": " + strerror(errno));
+		}
+
+		struct stat st;
+		if (fstat(fd, &st)) {
+			close(fd);
+			throw std::runtime_error("Can't stat file " + path + ": " + strerror(errno));
+		}
+
+		size = st.st_size;
+		if (size) {
+			void *mapping = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (mapping == MAP_FAILED) {
+				close(fd);
+				throw std::runtime_error("Can't map file " + path + ": " + strerror(errno));
+			}
+			data = static_cast<const char *>(mapping);
+			madvise(mapping, size, MADV_SEQUENTIAL);
+		}
+		close(fd);
+	}
+
+	mapped_file_t(const mapped_file_t &other) = delete;
+	mapped_file_t &operator =(const mapped_file_t &other) = delete;
+
+	~mapped_file_t() {
+		if (data) {
+			munmap(const_cast<char *>(data), size);
+		}
+	}
+
+	const char *begin() const {
+		return data;
+	}
+
+	const char *end() const {
+		return data + size;
+	}
+
+private:
+	const char *data;
+	size_t size;
+};
+
+/*!
+ * \brief Finds the first document that starts at the beginning of a line in [\a begin, \a end)
+ *
+ * Both compact json lines and pretty printed trees start their documents at the beginning of a line,
+ * nested objects are either on the same line or indented, so input can be split at arbitrary offsets.
+ */
+inline const char *find_document_start(const char *begin, const char *data_begin, const char *end) {
+	for (const char *it = begin; it < end; ++it) {
+		if (*it == '{' && (it == data_begin || it[-1] == '\n')) {
+			return it;
+		}
+	}
+	return end;
+}
+
+/*!
+ * \brief Returns end of json object or array that starts at \a begin, or NULL if it is not terminated
+ */
+inline const char *find_document_end(const char *begin, const char *end) {
+	size_t depth = 0;
+	bool in_string = false;
+	for (const char *it = begin; it < end; ++it) {
+		const char c = *it;
+		if (in_string) {
+			if (c == '\\') {
+				++it;
+			} else if (c == '"') {
+				in_string = false;
+			}
+		} else if (c == '"') {
+			in_string = true;
+		} else if (c == '{' || c == '[') {
+			++depth;
+		} else if (c == '}' || c == ']') {
+			if (--depth == 0) {
+				return it + 1;
+			}
+		}
+	}
+	return NULL;
+}
+
+/*!
+ * \brief Read-only rapidjson stream over memory range, ends with '\0' at the end of range
+ */
+class range_stream_t {
+public:
+	typedef char Ch;
+
+	range_stream_t(const char *begin, const char *end): begin(begin), current(begin), end(end) {}
+
+	Ch Peek() const {
+		return current < end ? *current : '\0';
+	}
+
+	Ch Take() {
+		return current < end ? *current++ : '\0';
+	}
+
+	size_t Tell() const {
+		return current - begin;
+	}
+
+	// Write operations are used only by in-situ parsing, which is not supported by this stream
+	Ch *PutBegin() {
+		return NULL;
+	}
+
+	void Put(Ch) {}
+
+	size_t PutEnd(Ch *) {
+		return 0;
+	}
+
+private:
+	const char *begin;
+	const char *current;
+	const char *end;
+};
+
+/*!
+ * \brief Table of action names, each name is assigned dense integer id
+ *
+ * Lookup doesn't allocate: names are compared in place and copied only when new name is added.
+ */
+class names_table_t {
+public:
+	names_table_t(): slots(1024, -1) {}
+
+	/*!
+	 * \brief Returns id of \a name adding it if needed
+	 */
+	int intern(const char *name, size_t length) {
+		if (names.size() * 2 >= slots.size()) {
+			grow();
+		}
+
+		const size_t mask = slots.size() - 1;
+		for (size_t slot = hash(name, length) & mask;; slot = (slot + 1) & mask) {
+			int id = slots[slot];
+			if (id < 0) {
+				id = names.size();
+				names.push_back(std::string(name, length));
+				slots[slot] = id;
+				return id;
+			}
+			if (names[id].size() == length && !memcmp(names[id].data(), name, length)) {
+				return id;
+			}
+		}
+	}
+
+	/*!
+	 * \brief Returns name with \a id
+	 */
+	const std::string &get_name(int id) const {
+		return names[id];
+	}
+
+	/*!
+	 * \brief Returns number of interned names
+	 */
+	size_t size() const {
+		return names.size();
+	}
+
+private:
+	static size_t hash(const char *name, size_t length) {
+		// FNV-1a
+		uint64_t value = 14695981039346656037ULL;
+		for (size_t i = 0; i < length; ++i) {
+			value = (value ^ static_cast<unsigned char>(name[i])) * 1099511628211ULL;
+		}
+		return value;
+	}
+
+	void grow() {
+		std::vector<int> new_slots(slots.size() * 2, -1);
+		const size_t mask = new_slots.size() - 1;
+		for (size_t id = 0; id < names.size(); ++id) {
+			size_t slot = hash(names[id].data(), names[id].size()) & mask;
+			while (new_slots[slot] >= 0) {
+				slot = (slot + 1) & mask;
+			}
+			new_slots[slot] = id;
+		}
+		slots.swap(new_slots);
+	}
+
+	std::vector<std::string> names;
+	std::vector<int> slots;
+};
+
+/*!
+ * \brief Scalar json value passed to stat callbacks, strings point into parser buffer
+ */
+struct json_value_t {
+	enum type_t {
+		TYPE_NULL,
+		TYPE_BOOL,
+		TYPE_INT64,
+		TYPE_UINT64,
+		TYPE_DOUBLE,
+		TYPE_STRING
+	};
+
+	json_value_t(): type(TYPE_NULL), int64_value(0), string_value(NULL), string_length(0) {}
+
+	type_t type;
+	union {
+		bool bool_value;
+		int64_t int64_value;
+		uint64_t uint64_value;
+		double double_value;
+	};
+	const char *string_value;
+	size_t string_length;
+};
+
+/*!
+ * \brief Attributes of the tree that is being read
+ */
+struct tree_info_t {
+	tree_info_t() {
+		clear();
+	}
+
+	void clear() {
+		id.clear();
+		time_unit_ns = 1000;
+	}
+
+	/*!
+	 * \brief Id of the tree as written in json, empty if tree has no id
+	 *
+	 * Ids of old dumps are longer than hex of trace_id_t, so length isn't limited.
+	 * Storage is reused between trees.
+	 */
+	std::string id;
+
+	/*!
+	 * \brief Nanoseconds in tree's time unit
+	 */
+	int64_t time_unit_ns;
+};
+
+/*!
+ * \brief Streaming reader of react json, calls \a Handler without building DOM
+ *
+ * Handler receives:
+ * - tree_begin()
+ * - node_enter(action_id, start_time, stop_time) with times in nanoseconds since epoch
+ * - stat(key, key_length, value) of current node or of the tree if no node is entered
+ * - node_exit()
+ * - tree_end(tree_info)
+ *
+ * Action names are interned into names_table_t and nodes are reported with integer action ids,
+ * parser state is reused between documents, so reading doesn't allocate per node.
+ * Trees are expected in the order react writes them: "id" and "time_unit" precede "actions".
+ */
+template<typename Handler>
+class tree_reader_t {
+public:
+	/*!
+	 * \brief Constructs reader that passes events to \a handler and interns action names into \a names
+	 */
+	tree_reader_t(Handler &handler, names_table_t &names): sax(handler, names), error(NULL), error_offset(0) {}
+
+	/*!
+	 * \brief Parses single document in [\a begin, \a end)
+	 * \return True on success, false on parse error
+	 */
+	bool parse(const char *begin, const char *end) {
+		range_stream_t stream(begin, end);
+		sax.reset();
+		if (!reader.template Parse<0>(stream, sax)) {
+			error = reader.GetParseError();
+			error_offset = reader.GetErrorOffset();
+			return false;
+		}
+		return true;
+	}
+
+	/*!
+	 * \brief Parses all documents in [\a begin, \a end) that start at the beginning of a line
+	 * \return Number of documents that failed to parse
+	 */
+	size_t parse_all(const char *begin, const char *end) {
+		return parse_range(begin, end, begin, end);
+	}
+
+	/*!
+	 * \brief Parses documents that start at the beginning of a line in [\a range_begin, \a range_end)
+	 *
+	 * Documents may continue past \a range_end up to \a data_end, so input of [\a data_begin, \a data_end)
+	 * can be split into adjacent ranges that are parsed independently, each document is parsed exactly once.
+	 * \return Number of documents that failed to parse
+	 */
+	size_t parse_range(const char *data_begin, const char *data_end,
+			const char *range_begin, const char *range_end) {
+		size_t errors = 0;
+		const char *it = find_document_start(range_begin, data_begin, range_end);
+		while (it < range_end) {
+			const char *document_end = find_document_end(it, data_end);
+			if (!document_end || !parse(it, document_end)) {
+				// Resynchronize on the next line that starts a document
+				++errors;
+				it = find_document_start(it + 1, data_begin, range_end);
+				continue;
+			}
+			it = find_document_start(document_end, data_begin, range_end);
+		}
+		return errors;
+	}
+
+	/*!
+	 * \brief Returns description of the last parse error
+	 */
+	const char *get_error() const {
+		return error;
+	}
+
+	/*!
+	 * \brief Returns offset of the last parse error in parsed document
+	 */
+	size_t get_error_offset() const {
+		return error_offset;
+	}
+
+private:
+	class sax_handler_t {
+	public:
+		typedef char Ch;
+
+		sax_handler_t(Handler &handler, names_table_t &names): handler(handler), names(names) {}
+
+		void reset() {
+			frames.clear();
+			key = KEY_NONE;
+			info.clear();
+		}
+
+		void Null() {
+			value.type = json_value_t::TYPE_NULL;
+			scalar();
+		}
+
+		void Bool(bool b) {
+			value.type = json_value_t::TYPE_BOOL;
+			value.bool_value = b;
+			scalar();
+		}
+
+		void Int(int i) {
+			Int64(i);
+		}
+
+		void Uint(unsigned i) {
+			Int64(i);
+		}
+
+		void Int64(int64_t i) {
+			value.type = json_value_t::TYPE_INT64;
+			value.int64_value = i;
+			scalar();
+		}
+
+		void Uint64(uint64_t i) {
+			value.type = json_value_t::TYPE_UINT64;
+			value.uint64_value = i;
+			scalar();
+		}
+
+		void Double(double d) {
+			value.type = json_value_t::TYPE_DOUBLE;
+			value.double_value = d;
+			scalar();
+		}
+
+		void String(const Ch* str, rapidjson::SizeType length, bool) {
+			if (!frames.empty() && frames.back().expect_key) {
+				set_key(str, length);
+				return;
+			}
+
+			value.type = json_value_t::TYPE_STRING;
+			value.string_value = str;
+			value.string_length = length;
+			scalar();
+		}
+
+		void StartObject() {
+			if (frames.empty()) {
+				push(FRAME_ROOT);
+				handler.tree_begin();
+				return;
+			}
+
+			frame_t &top = frames.back();
+			if (top.kind == FRAME_ACTIONS) {
+				push(FRAME_NODE);
+			} else if (key == KEY_STATS && top.kind == FRAME_NODE) {
+				enter(top);
+				push(FRAME_STATS);
+			} else {
+				push(FRAME_SKIP);
+			}
+		}
+
+		void EndObject(rapidjson::SizeType) {
+			frame_t frame = frames.back();
+			frames.pop_back();
+
+			if (frame.kind == FRAME_NODE) {
+				enter(frame);
+				handler.node_exit();
+			} else if (frame.kind == FRAME_ROOT) {
+				handler.tree_end(info);
+			}
+			value_done();
+		}
+
+		void StartArray() {
+			if (!frames.empty() && key == KEY_ACTIONS &&
+					(frames.back().kind == FRAME_NODE || frames.back().kind == FRAME_ROOT)) {
+				if (frames.back().kind == FRAME_NODE) {
+					enter(frames.back());
+				}
+				push(FRAME_ACTIONS);
+			} else {
+				push(FRAME_SKIP);
+			}
+		}
+
+		void EndArray(rapidjson::SizeType) {
+			frames.pop_back();
+			value_done();
+		}
+
+	private:
+		enum frame_kind_t {
+			FRAME_ROOT,
+			FRAME_NODE,
+			FRAME_ACTIONS,
+			FRAME_STATS,
+			FRAME_SKIP
+		};
+
+		enum key_t {
+			KEY_NONE,
+			KEY_NAME,
+			KEY_START_TIME,
+			KEY_STOP_TIME,
+			KEY_STATS,
+			KEY_ACTIONS,
+			KEY_ID,
+			KEY_TIME_UNIT,
+			KEY_STAT
+		};
+
+		struct frame_t {
+			frame_kind_t kind;
+			bool expect_key;
+			bool entered;
+			int action_id;
+			int64_t start_time;
+			int64_t stop_time;
+		};
+
+		void push(frame_kind_t kind) {
+			frame_t frame;
+			frame.kind = kind;
+			frame.expect_key = (kind != FRAME_ACTIONS && kind != FRAME_SKIP);
+			frame.entered = false;
+			frame.action_id = -1;
+			frame.start_time = 0;
+			frame.stop_time = 0;
+			frames.push_back(frame);
+			key = KEY_NONE;
+		}
+
+		void enter(frame_t &frame) {
+			if (!frame.entered) {
+				frame.entered = true;
+				if (frame.action_id < 0) {
+					frame.action_id = names.intern("", 0);
+				}
+				handler.node_enter(frame.action_id,
+						frame.start_time * info.time_unit_ns, frame.stop_time * info.time_unit_ns);
+			}
+		}
+
+		static bool equals(const char *str, size_t length, const char *literal) {
+			return length == strlen(literal) && !memcmp(str, literal, length);
+		}
+
+		void set_key(const char *str, size_t length) {
+			frame_t &top = frames.back();
+			top.expect_key = false;
+
+			if (top.kind == FRAME_STATS) {
+				key = KEY_STAT;
+			} else if (equals(str, length, "actions")) {
+				key = KEY_ACTIONS;
+			} else if (top.kind == FRAME_NODE && equals(str, length, "name")) {
+				key = KEY_NAME;
+			} else if (top.kind == FRAME_NODE && equals(str, length, "start_time")) {
+				key = KEY_START_TIME;
+			} else if (top.kind == FRAME_NODE && equals(str, length, "stop_time")) {
+				key = KEY_STOP_TIME;
+			} else if (top.kind == FRAME_NODE && equals(str, length, "stats")) {
+				key = KEY_STATS;
+			} else if (top.kind == FRAME_ROOT && equals(str, length, "id")) {
+				key = KEY_ID;
+			} else if (top.kind == FRAME_ROOT && equals(str, length, "time_unit")) {
+				key = KEY_TIME_UNIT;
+			} else {
+				key = KEY_STAT;
+			}
+
+			if (key == KEY_STAT) {
+				// Reader's buffer is reused for value, so key is copied into reused storage
+				stat_key.assign(str, length);
+			}
+		}
+
+		int64_t integer_value() const {
+			switch (value.type) {
+			case json_value_t::TYPE_INT64:
+				return value.int64_value;
+			case json_value_t::TYPE_UINT64:
+				return value.uint64_value;
+			case json_value_t::TYPE_DOUBLE:
+				return value.double_value;
+			default:
+				return 0;
+			}
+		}
+
+		void scalar() {
+			if (frames.empty() || frames.back().kind == FRAME_SKIP || frames.back().kind == FRAME_ACTIONS) {
+				return;
+			}
+
+			frame_t &top = frames.back();
+			switch (key) {
+			case KEY_NAME:
+				if (value.type == json_value_t::TYPE_STRING) {
+					top.action_id = names.intern(value.string_value, value.string_length);
+				}
+				break;
+			case KEY_START_TIME:
+				top.start_time = integer_value();
+				break;
+			case KEY_STOP_TIME:
+				top.stop_time = integer_value();
+				break;
+			case KEY_ID:
+				if (value.type == json_value_t::TYPE_STRING) {
+					info.id.assign(value.string_value, value.string_length);
+				}
+				break;
+			case KEY_TIME_UNIT:
+				if (value.type == json_value_t::TYPE_STRING) {
+					if (equals(value.string_value, value.string_length, "ns")) {
+						info.time_unit_ns = 1;
+					} else if (equals(value.string_value, value.string_length, "ms")) {
+						info.time_unit_ns = 1000000;
+					} else {
+						info.time_unit_ns = 1000;
+					}
+				}
+				break;
+			case KEY_STAT:
+				if (top.kind == FRAME_NODE) {
+					enter(top);
+				}
+				handler.stat(stat_key.data(), stat_key.size(), value);
+				break;
+			default:
+				break;
+			}
+			value_done();
+		}
+
+		void value_done() {
+			if (!frames.empty() && frames.back().kind != FRAME_ACTIONS && frames.back().kind != FRAME_SKIP) {
+				frames.back().expect_key = true;
+			}
+			key = KEY_NONE;
+		}
+
+		Handler &handler;
+		names_table_t &names;
+		std::vector<frame_t> frames;
+		key_t key;
+		std::string stat_key;
+		json_value_t value;
+		tree_info_t info;
+	};
+
+	sax_handler_t sax;
+	rapidjson::Reader reader;
+	const char *error;
+	size_t error_offset;
+};
+
+} // namespace react
+
+#endif // REACT_TREE_READER_HPP
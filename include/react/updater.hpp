@@ -17,9 +17,11 @@
 #define REACT_UPDATER_HPP
 
 #include <stack>
+#include <vector>
 #include <stdexcept>
 
 #include "call_tree.hpp"
+#include "metrics.hpp"
 
 namespace react {
 
@@ -38,7 +40,7 @@ public:
 	/*!
 	 * \brief Time point type
 	 */
-	typedef std::chrono::time_point<std::chrono::system_clock> time_point_t;
+	typedef call_tree_t::time_point_t time_point_t;
 
 	/*!
 	 * \brief Default monitored call stack depth
@@ -51,8 +53,8 @@ public:
 	 */
 	call_tree_updater_t(const size_t max_depth = DEFAULT_MAX_TRACE_DEPTH):
 		current_node(+call_tree_t::NO_NODE), call_tree(NULL),
-		trace_depth(0), max_trace_depth(max_depth) {
-		measurements.emplace(std::chrono::system_clock::now(), +call_tree_t::NO_NODE);
+		trace_depth(0), max_trace_depth(max_depth), drop_depth(0), dropped_nodes(0) {
+		measurements.emplace(call_tree_t::time_clock_t::now(), +call_tree_t::NO_NODE);
 	}
 
 	/*!
@@ -63,9 +65,9 @@ public:
 	call_tree_updater_t(concurrent_call_tree_t &call_tree,
 			const size_t max_depth = DEFAULT_MAX_TRACE_DEPTH):
 		current_node(+call_tree_t::NO_NODE), call_tree(NULL),
-		trace_depth(0), max_trace_depth(max_depth) {
+		trace_depth(0), max_trace_depth(max_depth), drop_depth(0), dropped_nodes(0) {
 		set_call_tree(call_tree);
-		measurements.emplace(std::chrono::system_clock::now(), +call_tree_t::NO_NODE);
+		measurements.emplace(call_tree_t::time_clock_t::now(), +call_tree_t::NO_NODE);
 	}
 
 	/*!
@@ -88,6 +90,8 @@ public:
 		current_node = call_tree.get_call_tree().root;
 		this->call_tree = &call_tree;
 		trace_depth = 0;
+		drop_depth = 0;
+		skipped_calls.clear();
 	}
 
 	/*!
@@ -98,6 +102,8 @@ public:
 		current_node = call_tree_t::NO_NODE;
 		this->call_tree = NULL;
 		trace_depth = 0;
+		drop_depth = 0;
+		skipped_calls.clear();
 	}
 
 	/*!
@@ -113,11 +119,21 @@ public:
 	 * \param action_code Code of new action
 	 */
 	void start(const int action_code) {
-		start(action_code, std::chrono::system_clock::now());
+		if (has_call_tree() && call_tree->get_call_tree().get_actions_set().is_disabled(action_code)) {
+			start(action_code, time_point_t());
+		} else {
+			start(action_code, call_tree_t::time_clock_t::now());
+		}
 	}
 
 	/*!
 	 * \brief Starts new branch in tree with action \a action_code and with specified start time
+	 *
+	 * If node limit of the tree is reached, action and all actions nested into it are dropped,
+	 * their number and time are accounted in the tree when action is stopped.
+	 * Actions that are deeper than max trace depth, disabled or aggregate only in actions set don't create nodes
+	 * and don't lock the tree. They are kept on the stack of skipped calls together with dropped actions,
+	 * so that their stops are still checked and all of them except disabled ones are counted in metrics.
 	 * \param action_code Code of new action
 	 * \param start_time Action start time
 	 */
@@ -130,14 +146,30 @@ public:
 		}
 
 		++trace_depth;
-		if (get_trace_depth() > max_trace_depth) {
+		const actions_set_t &actions_set = call_tree->get_call_tree().get_actions_set();
+		if (get_trace_depth() > max_trace_depth || actions_set.is_skipped(action_code)) {
+			skipped_calls.push_back(skipped_call(trace_depth, action_code,
+				!actions_set.is_disabled(action_code), start_time));
+			return;
+		}
+
+		if (drop_depth) {
+			++dropped_nodes;
+			skipped_calls.push_back(skipped_call(trace_depth, action_code, true, start_time));
 			return;
 		}
 
 		p_node_t next_node = call_tree_t::NO_NODE;
 		{
 			std::lock_guard<concurrent_call_tree_t> guard(*call_tree);
-			next_node = call_tree->get_call_tree().add_new_link(current_node, action_code);
+			call_tree_t &tree = call_tree->get_call_tree();
+			if (tree.is_full()) {
+				drop_depth = trace_depth;
+				dropped_nodes = 1;
+				skipped_calls.push_back(skipped_call(trace_depth, action_code, true, start_time));
+				return;
+			}
+			next_node = tree.add_new_link(current_node, action_code);
 		}
 
 		measurements.emplace(start_time, current_node);
@@ -156,8 +188,8 @@ public:
 			);
 		}
 
-		if (get_trace_depth() > max_trace_depth) {
-			--trace_depth;
+		if (!skipped_calls.empty() && skipped_calls.back().depth == trace_depth) {
+			stop_skipped_call(action_code);
 			return;
 		}
 
@@ -165,6 +197,7 @@ public:
 
 		int expected_code = call_tree->get_call_tree().get_node_action_code(current_node);
 		if (expected_code != action_code) {
+			count_error(action_code);
 			std::string expected_action_name = get_action_name(expected_code);
 			std::string found_action_name = get_action_name(action_code);
 			throw std::logic_error("Stopping wrong action. Expected: " + expected_action_name + ", Found: " + found_action_name);
@@ -256,11 +289,51 @@ private:
 	/*!
 	 * \internal
 	 *
-	 * \brief Returns delta between two time_points
+	 * \brief Stops call from top of skipped calls stack and counts it in metrics unless action is disabled
+	 *
+	 * Number and time of dropped actions are added to the tree when the first dropped action is stopped.
+	 */
+	void stop_skipped_call(int action_code) {
+		const skipped_call &call = skipped_calls.back();
+		if (call.action_code != action_code) {
+			count_error(action_code);
+			throw std::logic_error("Stopping wrong action. Expected: " + get_action_name(call.action_code)
+					+ ", Found: " + get_action_name(action_code));
+		}
+
+		const time_point_t stop_time = call.is_counted ? call_tree_t::time_clock_t::now() : time_point_t();
+		if (call.is_counted) {
+			count_call(action_code, (stop_time - call.start_time).count());
+		}
+		if (trace_depth == drop_depth) {
+			std::lock_guard<concurrent_call_tree_t> guard(*call_tree);
+			call_tree->get_call_tree().add_dropped_nodes(dropped_nodes, (stop_time - call.start_time).count());
+			drop_depth = 0;
+		}
+		skipped_calls.pop_back();
+		--trace_depth;
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Counts call in process-wide metrics if actions set of the tree has them
 	 */
-	template<class Period = std::chrono::microseconds>
-	int64_t delta(const time_point_t& start, const time_point_t& end) const {
-		return (std::chrono::duration_cast<Period> (end - start)).count();
+	void count_call(int action_code, int64_t time) {
+		if (call_tree->get_call_tree().get_actions_set().has_metrics()) {
+			thread_metrics_shard().add_call(action_code, time);
+		}
+	}
+
+	/*!
+	 * \internal
+	 *
+	 * \brief Counts failed call in process-wide metrics if actions set of the tree has them
+	 */
+	void count_error(int action_code) {
+		if (call_tree->get_call_tree().get_actions_set().has_metrics()) {
+			thread_metrics_shard().add_error(action_code);
+		}
 	}
 
 	/*!
@@ -278,10 +351,12 @@ private:
 				if (get_actual_trace_depth() != get_trace_depth()) {
 					error_message +=
 							std::to_string(static_cast<long long>(get_trace_depth() - get_actual_trace_depth()))
-							+ " untracked actions due to max depth\n";
+							+ " untracked actions due to max depth, nodes limit or disabled actions\n";
 				}
+				skipped_calls.clear();
 				while (get_actual_trace_depth() > 0) {
 					error_message += get_current_node_action_name() + '\n';
+					count_error(call_tree->get_call_tree().get_node_action_code(current_node));
 					pop_measurement();
 				}
 			}
@@ -312,15 +387,48 @@ private:
 		p_node_t previous_node;
 	};
 
+	/*!
+	 * \brief Call which has no node in call-tree: too deep, dropped, disabled or aggregate only
+	 */
+	struct skipped_call {
+		skipped_call(size_t depth, int action_code, bool is_counted, const time_point_t& start_time):
+			depth(depth), action_code(action_code), is_counted(is_counted), start_time(start_time) {}
+
+		/*!
+		 * \brief Call stack depth of the call
+		 */
+		size_t depth;
+
+		/*!
+		 * \brief Code of skipped action
+		 */
+		int action_code;
+
+		/*!
+		 * \brief Shows if call is counted in metrics when it is stopped
+		 */
+		bool is_counted;
+
+		/*!
+		 * \brief Start time of the call, not measured for disabled actions
+		 */
+		time_point_t start_time;
+	};
+
 	/*!
 	 * \brief Removes measurement from top of call stack and updates corresponding node in call-tree
+	 *
+	 * Call is also counted in process-wide per-action metrics if actions set of the tree has them.
 	 * \param stop_time End time of the measurement
 	 */
-	void pop_measurement(const time_point_t& stop_time = std::chrono::system_clock::now()) {
+	void pop_measurement(const time_point_t& stop_time = call_tree_t::time_clock_t::now()) {
 		measurement previous_measurement = measurements.top();
 		measurements.pop();
-		call_tree->get_call_tree().set_node_start_time(current_node, delta(time_point_t(), previous_measurement.start_time));
-		call_tree->get_call_tree().set_node_stop_time(current_node, delta(time_point_t(), stop_time));
+		call_tree_t &tree = call_tree->get_call_tree();
+		count_call(tree.get_node_action_code(current_node),
+			(stop_time - previous_measurement.start_time).count());
+		tree.set_node_start_ticks(current_node, tree.to_node_time(previous_measurement.start_time));
+		tree.set_node_stop_ticks(current_node, tree.to_node_time(stop_time));
 		current_node = previous_measurement.previous_node;
 		--trace_depth;
 	}
@@ -349,6 +457,21 @@ private:
 	 * \brief Maximum monitored call stack depth
 	 */
 	size_t max_trace_depth;
+
+	/*!
+	 * \brief Call stack depth of the first dropped action, zero if actions are not dropped
+	 */
+	size_t drop_depth;
+
+	/*!
+	 * \brief Number of actions dropped since the first dropped action
+	 */
+	size_t dropped_nodes;
+
+	/*!
+	 * \brief Started calls that have no node in the tree, kept to check their stops and count them
+	 */
+	std::vector<skipped_call> skipped_calls;
 };
 
 /*!
@@ -6,7 +6,7 @@
 
 Summary:	Distributed hash table storage
 Name:		react
-Version:	2.3.1
+Version:	2.4.0
 Release:	1%{?dist}
 
 License:	GPLv2+
@@ -24,6 +24,7 @@ BuildRequires:	cmake
 %define boost_ver %{nil}
 
 BuildRequires:	boost%{boost_ver}-devel
+BuildRequires:	zlib-devel
 
 %description
 React is library for embedding realtime monitoring into C++ applications
@@ -60,7 +61,6 @@ make check
 %install
 rm -rf %{buildroot}
 make install DESTDIR=%{buildroot}
-rm -f %{buildroot}%{_libdir}/*.a
 rm -f %{buildroot}%{_libdir}/*.la
 
 %post -p /sbin/ldconfig
@@ -72,13 +72,28 @@ rm -rf %{buildroot}
 %files
 %defattr(-,root,root,-)
 %{_libdir}/libreact.so.*
+%{_bindir}/react-*
 
 %files devel
 %defattr(-,root,root,-)
 %{_includedir}/*
 %{_libdir}/libreact.so
+%{_libdir}/libreact.a
+%{_libdir}/cmake/React/
 
 %changelog
+* Mon Oct 19 2026 Andrey Kashin <kashin.andrej@gmail.com> - 2.4.0
+- api: react::action_guard keeps its state inline, ABI changed
+- api: inline fast path for active check and action start/stop
+- api: handle-based context API, context capture tokens and coroutine scopes
+- core: 128-bit tree ids, stat keys, counters and gauges
+- core: per-tree node budget, time unit and memory soft limit
+- core: per-action metrics registry and enable mask
+- core: runtime record mode control block
+- aggregators: rotating file, collapsed stack and Chrome Trace Event aggregators
+- tools: react-diff, react-analyze and react-bench added
+- build: static library, LTO option and CMake package config
+
 * Tue Apr 29 2014 Andrey Kashin <kashin.andrej@gmail.com> - 2.3.1
 - core: redundant typename removed
 
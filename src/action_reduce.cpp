@@ -0,0 +1,169 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#include "react/action_reduce.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define REACT_HAVE_AVX2_KERNEL
+#include <immintrin.h>
+#endif
+
+namespace react {
+
+/*!
+ * \brief Number of actions processed by vector kernel at once
+ */
+static const size_t BLOCK_SIZE = 256;
+
+/*!
+ * \brief Computes durations of \a count actions and their bucket indices if \a bounds_count is not zero
+ */
+typedef void (*block_kernel_t)(const int64_t *start_times, const int64_t *stop_times, size_t count,
+		const int64_t *bounds, size_t bounds_count, int64_t *durations, int64_t *buckets);
+
+static void scalar_block_kernel(const int64_t *start_times, const int64_t *stop_times, size_t count,
+		const int64_t *bounds, size_t bounds_count, int64_t *durations, int64_t *buckets) {
+	for (size_t i = 0; i < count; ++i) {
+		durations[i] = stop_times[i] - start_times[i];
+	}
+
+	if (!bounds_count) {
+		return;
+	}
+
+	for (size_t i = 0; i < count; ++i) {
+		int64_t bucket = 0;
+		for (size_t j = 0; j < bounds_count; ++j) {
+			bucket += (durations[i] >= bounds[j]);
+		}
+		buckets[i] = bucket;
+	}
+}
+
+#ifdef REACT_HAVE_AVX2_KERNEL
+__attribute__((target("avx2")))
+static void avx2_block_kernel(const int64_t *start_times, const int64_t *stop_times, size_t count,
+		const int64_t *bounds, size_t bounds_count, int64_t *durations, int64_t *buckets) {
+	const size_t vector_count = count & ~size_t(3);
+
+	for (size_t i = 0; i < vector_count; i += 4) {
+		__m256i start = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(start_times + i));
+		__m256i stop = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(stop_times + i));
+		__m256i duration = _mm256_sub_epi64(stop, start);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(durations + i), duration);
+
+		if (bounds_count) {
+			// Bucket is the number of bounds not greater than duration
+			__m256i bucket = _mm256_set1_epi64x(bounds_count);
+			for (size_t j = 0; j < bounds_count; ++j) {
+				__m256i bound = _mm256_set1_epi64x(bounds[j]);
+				bucket = _mm256_add_epi64(bucket, _mm256_cmpgt_epi64(bound, duration));
+			}
+			_mm256_storeu_si256(reinterpret_cast<__m256i *>(buckets + i), bucket);
+		}
+	}
+
+	scalar_block_kernel(start_times + vector_count, stop_times + vector_count, count - vector_count,
+			bounds, bounds_count, durations + vector_count, buckets + vector_count);
+}
+#endif
+
+bool reduce_kernel_is_supported(reduce_kernel_t kernel) {
+	switch (kernel) {
+	case REDUCE_KERNEL_AUTO:
+	case REDUCE_KERNEL_SCALAR:
+		return true;
+	case REDUCE_KERNEL_AVX2:
+#ifdef REACT_HAVE_AVX2_KERNEL
+		return __builtin_cpu_supports("avx2");
+#else
+		return false;
+#endif
+	}
+	return false;
+}
+
+reduce_kernel_t get_auto_reduce_kernel() {
+	static const reduce_kernel_t kernel =
+			reduce_kernel_is_supported(REDUCE_KERNEL_AVX2) ? REDUCE_KERNEL_AVX2 : REDUCE_KERNEL_SCALAR;
+	return kernel;
+}
+
+static block_kernel_t get_block_kernel(reduce_kernel_t kernel) {
+	if (kernel == REDUCE_KERNEL_AUTO) {
+		kernel = get_auto_reduce_kernel();
+	}
+
+	if (!reduce_kernel_is_supported(kernel)) {
+		throw std::invalid_argument("Can't reduce actions: kernel is not supported by CPU");
+	}
+
+#ifdef REACT_HAVE_AVX2_KERNEL
+	if (kernel == REDUCE_KERNEL_AVX2) {
+		return avx2_block_kernel;
+	}
+#endif
+	return scalar_block_kernel;
+}
+
+void reduce_actions(const columnar_call_tree_t &call_tree, std::vector<action_summary_t> &summaries,
+		action_histogram_t *histogram, reduce_kernel_t kernel) {
+	block_kernel_t block_kernel = get_block_kernel(kernel);
+
+	const size_t count = call_tree.size();
+	const int *action_codes = call_tree.get_action_codes().data();
+	const int64_t *start_times = call_tree.get_start_times().data();
+	const int64_t *stop_times = call_tree.get_stop_times().data();
+
+	const int64_t *bounds = NULL;
+	size_t bounds_count = 0;
+	size_t buckets_count = 1;
+	if (histogram) {
+		bounds = histogram->bounds.data();
+		bounds_count = histogram->bounds.size();
+		buckets_count = histogram->buckets_count();
+	}
+
+	int64_t durations[BLOCK_SIZE];
+	int64_t buckets[BLOCK_SIZE];
+
+	for (size_t offset = 0; offset < count; offset += BLOCK_SIZE) {
+		const size_t block_count = std::min(BLOCK_SIZE, count - offset);
+		block_kernel(start_times + offset, stop_times + offset, block_count,
+				bounds, bounds_count, durations, buckets);
+
+		for (size_t i = 0; i < block_count; ++i) {
+			const size_t action_code = action_codes[offset + i];
+			if (action_code >= summaries.size()) {
+				summaries.resize(action_code + 1);
+			}
+			summaries[action_code].add(durations[i]);
+
+			if (histogram) {
+				// Kernels don't write buckets when there are no bounds, all durations are in the single bucket
+				const size_t index = action_code * buckets_count + (bounds_count ? buckets[i] : 0);
+				if (index >= histogram->counts.size()) {
+					histogram->counts.resize((action_code + 1) * buckets_count);
+				}
+				++histogram->counts[index];
+			}
+		}
+	}
+}
+
+} // namespace react
@@ -0,0 +1,235 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#include "react/control.hpp"
+#include "react/react.h"
+
+#include <iostream>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+
+#include <signal.h>
+#include <sys/stat.h>
+
+using namespace react;
+
+static_assert(static_cast<int>(REACT_RECORD_MODE_OFF) == react::RECORD_MODE_OFF &&
+		static_cast<int>(REACT_RECORD_MODE_SAMPLED) == react::RECORD_MODE_SAMPLED &&
+		static_cast<int>(REACT_RECORD_MODE_FULL) == react::RECORD_MODE_FULL,
+		"Record modes of C and C++ API don't match");
+
+/*!
+ * \brief Constant initialized, so it can be used by signal handlers and static initializers
+ */
+static control_block_t global_control_block;
+
+namespace react {
+
+control_block_t &control_block() {
+	return global_control_block;
+}
+
+} // namespace react
+
+/*!
+ * \brief Name of environment variable with record mode applied when library is loaded
+ */
+static const char *RECORD_MODE_ENV = "REACT_RECORD_MODE";
+
+static int apply_environment() {
+	const char *mode = getenv(RECORD_MODE_ENV);
+	if (mode && react_set_record_mode_from_string(mode) != 0) {
+		std::cerr << "Invalid " << RECORD_MODE_ENV << ": " << mode << std::endl;
+	}
+	return 0;
+}
+
+static const int ENVIRONMENT_APPLIED = apply_environment();
+
+/*!
+ * \brief Control words stored by signal handlers, indexed by signal number
+ */
+static std::atomic<uint64_t> signal_words[NSIG];
+
+static void on_control_signal(int signum) {
+	global_control_block.store(signal_words[signum].load(std::memory_order_relaxed));
+}
+
+/*!
+ * \brief Background thread that applies record mode written to control file whenever file changes
+ */
+class control_file_watcher_t {
+public:
+	control_file_watcher_t(): stopping(false) {}
+
+	~control_file_watcher_t() {
+		stop();
+	}
+
+	void start(const std::string &path, std::chrono::milliseconds interval) {
+		stop();
+		this->path = path;
+		this->interval = interval;
+		stopping = false;
+		thread = std::thread(&control_file_watcher_t::loop, this);
+	}
+
+	void stop() {
+		if (!thread.joinable()) {
+			return;
+		}
+
+		{
+			std::lock_guard<std::mutex> guard(mutex);
+			stopping = true;
+		}
+		condition.notify_one();
+		thread.join();
+	}
+
+private:
+	void loop() {
+		struct stat last_stat = {};
+		std::unique_lock<std::mutex> lock(mutex);
+		while (!stopping) {
+			struct stat file_stat;
+			if (stat(path.c_str(), &file_stat) == 0 &&
+					(file_stat.st_mtim.tv_sec != last_stat.st_mtim.tv_sec ||
+					 file_stat.st_mtim.tv_nsec != last_stat.st_mtim.tv_nsec ||
+					 file_stat.st_size != last_stat.st_size)) {
+				last_stat = file_stat;
+				apply();
+			}
+			condition.wait_for(lock, interval, [this] () { return stopping; });
+		}
+	}
+
+	void apply() {
+		std::ifstream file(path.c_str());
+		std::string line;
+		while (std::getline(file, line)) {
+			if (line.find_first_not_of(" \t\r") != std::string::npos && !apply_line(line)) {
+				std::cerr << "Invalid control line in " << path << ": " << line << std::endl;
+			}
+		}
+	}
+
+	/*!
+	 * \brief Applies record mode or action state from single line of control file
+	 */
+	static bool apply_line(const std::string &line) {
+		const std::string action_prefix = "action:";
+		if (line.compare(0, action_prefix.size(), action_prefix) == 0) {
+			const size_t end = line.find_last_not_of(" \t\r");
+			return react_set_action_state_from_string(
+				line.substr(action_prefix.size(), end + 1 - action_prefix.size()).c_str()) == 0;
+		}
+
+		uint64_t word;
+		if (!control_block_t::parse(line, word)) {
+			return false;
+		}
+		global_control_block.store(word);
+		return true;
+	}
+
+	std::string path;
+	std::chrono::milliseconds interval;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping;
+	std::thread thread;
+};
+
+static std::mutex control_file_mutex;
+static control_file_watcher_t control_file_watcher;
+
+static bool record_mode_is_valid(react_record_mode_t mode, double rate) {
+	return mode >= REACT_RECORD_MODE_OFF && mode <= REACT_RECORD_MODE_FULL &&
+			(mode != REACT_RECORD_MODE_SAMPLED || (rate >= 0 && rate <= 1));
+}
+
+int react_set_record_mode(react_record_mode_t mode, double rate) {
+	if (!record_mode_is_valid(mode, rate)) {
+		return -EINVAL;
+	}
+	global_control_block.store(control_block_t::pack(static_cast<record_mode_t>(mode), rate));
+	return 0;
+}
+
+int react_set_record_mode_from_string(const char *mode) {
+	uint64_t word;
+	if (!mode || !control_block_t::parse(mode, word)) {
+		return -EINVAL;
+	}
+	global_control_block.store(word);
+	return 0;
+}
+
+react_record_mode_t react_get_record_mode() {
+	return static_cast<react_record_mode_t>(control_block_t::get_mode(global_control_block.load()));
+}
+
+double react_get_sample_rate() {
+	return control_block_t::get_rate(global_control_block.load());
+}
+
+int react_set_aggregator_override(void *react_aggregator) {
+	global_control_block.set_aggregator(static_cast<react::aggregator_t*>(react_aggregator));
+	return 0;
+}
+
+int react_set_signal_record_mode(int signum, react_record_mode_t mode, double rate) {
+	(void) ENVIRONMENT_APPLIED;
+
+	if (signum <= 0 || signum >= NSIG || !record_mode_is_valid(mode, rate)) {
+		return -EINVAL;
+	}
+
+	signal_words[signum].store(control_block_t::pack(static_cast<record_mode_t>(mode), rate));
+
+	struct sigaction action = {};
+	action.sa_handler = on_control_signal;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+	if (sigaction(signum, &action, NULL) != 0) {
+		return -errno;
+	}
+	return 0;
+}
+
+int react_watch_control_file(const char *path, unsigned interval_ms) {
+	if (!path || !interval_ms) {
+		return -EINVAL;
+	}
+
+	try {
+		std::lock_guard<std::mutex> guard(control_file_mutex);
+		control_file_watcher.start(path, std::chrono::milliseconds(interval_ms));
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+int react_unwatch_control_file() {
+	std::lock_guard<std::mutex> guard(control_file_mutex);
+	control_file_watcher.stop();
+	return 0;
+}
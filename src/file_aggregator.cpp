@@ -0,0 +1,393 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#include "react/file_aggregator.hpp"
+#include "react/utils.hpp"
+
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/uio.h>
+
+#ifdef REACT_HAVE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace react {
+
+/*!
+ * \brief Maximum number of written buffers kept for reuse
+ */
+static const size_t MAX_FREE_BUFFERS = 4;
+
+/*!
+ * \internal
+ *
+ * \brief Owns output file: writes batches, compresses and rotates it. Used only by flush thread.
+ */
+class file_aggregator_t::writer_t {
+public:
+	writer_t(const file_aggregator_config_t &config):
+		config(config), fd(-1), file_size(0), rotated_files(0), open_failed(false)
+#ifdef REACT_HAVE_ZLIB
+		, stream_initialized(false)
+#endif
+	{
+		if (config.path.empty()) {
+			throw std::invalid_argument("Can't create file aggregator: path is empty");
+		}
+#ifndef REACT_HAVE_ZLIB
+		if (config.compression == FILE_COMPRESSION_GZIP) {
+			throw std::invalid_argument("Can't create file aggregator: react is built without zlib");
+		}
+#endif
+		open();
+	}
+
+	~writer_t() {
+		try {
+			close();
+		} catch (std::exception &e) {
+			std::cerr << e.what() << std::endl;
+		}
+	}
+
+	/*!
+	 * \brief Writes \a buffers to file, rotates file before write if needed
+	 *
+	 * If file can't be opened after rotation, open is retried on each next write.
+	 * \return false if file isn't opened and \a buffers are dropped
+	 */
+	bool write(const std::vector<std::string> &buffers) {
+		if (fd >= 0 && should_rotate()) {
+			rotate();
+		} else if (fd < 0) {
+			reopen();
+		}
+
+		if (fd < 0) {
+			return false;
+		}
+
+		if (config.compression == FILE_COMPRESSION_NONE) {
+			write_buffers(buffers);
+			return true;
+		}
+
+#ifdef REACT_HAVE_ZLIB
+		compressed.clear();
+		for (size_t i = 0; i < buffers.size(); ++i) {
+			compress(buffers[i], (i + 1 == buffers.size()) ? Z_SYNC_FLUSH : Z_NO_FLUSH);
+		}
+		write_buffers(std::vector<std::string>(1, compressed));
+#endif
+		return true;
+	}
+
+	/*!
+	 * \brief Finishes compressed stream and closes file
+	 */
+	void close() {
+		if (fd < 0) {
+			return;
+		}
+
+#ifdef REACT_HAVE_ZLIB
+		if (stream_initialized) {
+			compressed.clear();
+			compress(std::string(), Z_FINISH);
+			deflateEnd(&stream);
+			stream_initialized = false;
+			write_buffers(std::vector<std::string>(1, compressed));
+		}
+#endif
+
+		::close(fd);
+		fd = -1;
+	}
+
+private:
+	void open() {
+		fd = ::open(config.path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+		if (fd < 0) {
+			throw std::runtime_error("Can't open file " + config.path + ": " + strerror(errno));
+		}
+
+		off_t size = lseek(fd, 0, SEEK_END);
+		file_size = (size > 0) ? size : 0;
+		opened_at = std::chrono::steady_clock::now();
+
+#ifdef REACT_HAVE_ZLIB
+		if (config.compression == FILE_COMPRESSION_GZIP) {
+			memset(&stream, 0, sizeof(stream));
+			// 16 is added to window bits to write gzip header instead of zlib one
+			if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+				::close(fd);
+				fd = -1;
+				throw std::runtime_error("Can't initialize gzip stream for " + config.path);
+			}
+			stream_initialized = true;
+		}
+#endif
+	}
+
+	bool should_rotate() const {
+		if (config.max_file_size && file_size >= config.max_file_size) {
+			return true;
+		}
+		if (config.rotation_interval.count() &&
+				std::chrono::steady_clock::now() - opened_at >= config.rotation_interval) {
+			return file_size > 0;
+		}
+		return false;
+	}
+
+	void rotate() {
+		close();
+
+		std::string rotated_path = config.path
+				+ "." + std::to_string(static_cast<long long>(time(NULL)))
+				+ "." + std::to_string(static_cast<long long>(rotated_files++));
+		if (rename(config.path.c_str(), rotated_path.c_str())) {
+			std::cerr << "Can't rotate file " << config.path << ": " << strerror(errno) << std::endl;
+		}
+
+		reopen();
+	}
+
+	/*!
+	 * \brief Opens file without throwing, reports only first of consecutive failures
+	 */
+	void reopen() {
+		try {
+			open();
+			open_failed = false;
+		} catch (std::exception &e) {
+			if (!open_failed) {
+				std::cerr << e.what() << ", dropping trees until it is opened" << std::endl;
+				open_failed = true;
+			}
+		}
+	}
+
+	/*!
+	 * \brief Writes all \a buffers with as few writev calls as possible
+	 */
+	void write_buffers(const std::vector<std::string> &buffers) {
+		std::vector<iovec> iov;
+		iov.reserve(buffers.size());
+		for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+			if (!it->empty()) {
+				iovec vec;
+				vec.iov_base = const_cast<char *>(it->data());
+				vec.iov_len = it->size();
+				iov.push_back(vec);
+			}
+		}
+
+		size_t first = 0;
+		while (first < iov.size()) {
+			int count = std::min<size_t>(iov.size() - first, IOV_MAX);
+			ssize_t written = writev(fd, &iov[first], count);
+			if (written < 0) {
+				if (errno == EINTR) {
+					continue;
+				}
+				throw std::runtime_error("Can't write to file " + config.path + ": " + strerror(errno));
+			}
+
+			file_size += written;
+			while (first < iov.size() && static_cast<size_t>(written) >= iov[first].iov_len) {
+				written -= iov[first].iov_len;
+				++first;
+			}
+			if (first < iov.size()) {
+				iov[first].iov_base = static_cast<char *>(iov[first].iov_base) + written;
+				iov[first].iov_len -= written;
+			}
+		}
+	}
+
+#ifdef REACT_HAVE_ZLIB
+	/*!
+	 * \brief Compresses \a data and appends result to compressed buffer
+	 */
+	void compress(const std::string &data, int flush) {
+		stream.next_in = reinterpret_cast<Bytef *>(const_cast<char *>(data.data()));
+		stream.avail_in = data.size();
+
+		do {
+			size_t offset = compressed.size();
+			size_t chunk = std::max<size_t>(deflateBound(&stream, stream.avail_in), 4096);
+			compressed.resize(offset + chunk);
+			stream.next_out = reinterpret_cast<Bytef *>(&compressed[offset]);
+			stream.avail_out = chunk;
+
+			int err = deflate(&stream, flush);
+			if (err != Z_OK && err != Z_STREAM_END && err != Z_BUF_ERROR) {
+				throw std::runtime_error("Can't compress data for " + config.path);
+			}
+			compressed.resize(offset + chunk - stream.avail_out);
+		} while (stream.avail_out == 0 || stream.avail_in != 0);
+	}
+#endif
+
+	const file_aggregator_config_t &config;
+	int fd;
+	size_t file_size;
+	std::chrono::steady_clock::time_point opened_at;
+	size_t rotated_files;
+	bool open_failed;
+	std::string compressed;
+#ifdef REACT_HAVE_ZLIB
+	z_stream stream;
+	bool stream_initialized;
+#endif
+};
+
+file_aggregator_t::file_aggregator_t(const file_aggregator_config_t &config):
+	config(config), pending_size(0), sealed_count(0), written_count(0),
+	dropped_trees(0), stopping(false) {
+	writer.reset(new writer_t(this->config));
+	active_buffer.reserve(this->config.batch_size);
+	flush_thread = std::thread(&file_aggregator_t::flush_thread_loop, this);
+}
+
+file_aggregator_t::~file_aggregator_t() {
+	{
+		std::lock_guard<std::mutex> guard(buffers_mutex);
+		stopping = true;
+	}
+	flush_condition.notify_one();
+	flush_thread.join();
+}
+
+void file_aggregator_t::aggregate(const call_tree_t &call_tree) {
+	std::string line = print_json_to_compact_string(call_tree);
+	line += '\n';
+
+	std::lock_guard<std::mutex> guard(buffers_mutex);
+	if (pending_size + line.size() > config.max_pending_size) {
+		++dropped_trees;
+		return;
+	}
+
+	active_buffer.append(line);
+	pending_size += line.size();
+	memory_usage().add(line.size());
+
+	if (active_buffer.size() >= config.batch_size) {
+		seal_active_buffer();
+		flush_condition.notify_one();
+	}
+}
+
+void file_aggregator_t::flush() {
+	std::unique_lock<std::mutex> lock(buffers_mutex);
+	seal_active_buffer();
+	size_t target = sealed_count;
+	flush_condition.notify_one();
+	flushed_condition.wait(lock, [this, target] () { return written_count >= target; });
+}
+
+size_t file_aggregator_t::get_dropped_trees_count() const {
+	std::lock_guard<std::mutex> guard(buffers_mutex);
+	return dropped_trees;
+}
+
+void file_aggregator_t::seal_active_buffer() {
+	if (active_buffer.empty()) {
+		return;
+	}
+
+	pending_buffers.push_back(std::string());
+	pending_buffers.back().swap(active_buffer);
+	if (!free_buffers.empty()) {
+		active_buffer.swap(free_buffers.back());
+		free_buffers.pop_back();
+	}
+	++sealed_count;
+}
+
+void file_aggregator_t::flush_thread_loop() {
+	std::unique_lock<std::mutex> lock(buffers_mutex);
+	std::vector<std::string> buffers;
+
+	while (true) {
+		if (pending_buffers.empty() && !stopping) {
+			flush_condition.wait_for(lock, config.flush_interval);
+			if (pending_buffers.empty()) {
+				// Either flush interval passed or flush is requested
+				seal_active_buffer();
+			}
+		}
+
+		if (stopping) {
+			seal_active_buffer();
+		}
+
+		if (pending_buffers.empty()) {
+			if (stopping) {
+				break;
+			}
+			continue;
+		}
+
+		buffers.swap(pending_buffers);
+		size_t sealed = sealed_count;
+		size_t bytes = 0;
+		for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+			bytes += it->size();
+		}
+
+		lock.unlock();
+		bool written = false;
+		try {
+			written = writer->write(buffers);
+		} catch (std::exception &e) {
+			std::cerr << e.what() << std::endl;
+		}
+		size_t lost_trees = 0;
+		if (!written) {
+			for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+				lost_trees += std::count(it->begin(), it->end(), '\n');
+			}
+		}
+		lock.lock();
+
+		pending_size -= bytes;
+		memory_usage().sub(bytes);
+		dropped_trees += lost_trees;
+		written_count = sealed;
+		for (auto it = buffers.begin(); it != buffers.end(); ++it) {
+			if (free_buffers.size() < MAX_FREE_BUFFERS) {
+				it->clear();
+				free_buffers.push_back(std::string());
+				free_buffers.back().swap(*it);
+			}
+		}
+		buffers.clear();
+		flushed_condition.notify_all();
+	}
+}
+
+} // namespace react
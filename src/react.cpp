@@ -16,16 +16,25 @@
 #define REACT_CPP
 
 #include "react/react.hpp"
+#include "react/control.hpp"
 #include "react/utils.hpp"
 
 #include <stdexcept>
+#include <algorithm>
 #include <iostream>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
 
 using namespace react;
 
 actions_set_t &actions_set() {
-	static actions_set_t actions_set;
+	static actions_set_t actions_set(true);
 	return actions_set;
 }
 
@@ -38,42 +47,246 @@ int react_define_new_action(const char *action_name) {
 	}
 }
 
+int react_define_new_stat(const char *stat_name) {
+	try {
+		return actions_set().define_new_stat(stat_name);
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return -ENOMEM;
+	}
+}
+
+static const int STAT_COMPLETE = react_define_new_stat("complete");
+
+static_assert(static_cast<int>(REACT_TIME_UNIT_NANOSECONDS) == react::TIME_UNIT_NANOSECONDS &&
+		static_cast<int>(REACT_TIME_UNIT_MICROSECONDS) == react::TIME_UNIT_MICROSECONDS &&
+		static_cast<int>(REACT_TIME_UNIT_MILLISECONDS) == react::TIME_UNIT_MILLISECONDS,
+		"Time units of C and C++ API don't match");
+
 struct react_context_t {
 	react_context_t(react::aggregator_t *aggregator):
-		call_tree(actions_set()), updater(call_tree), aggregator(aggregator) {}
+		call_tree(actions_set()), updater(call_tree), aggregator(aggregator),
+		parent_context(NULL), parent_node(+call_tree_t::NO_NODE),
+		previous_context(NULL), previous_refcount(0) {
+		// Memory of call tree is accounted by the tree itself
+		react::memory_usage().add(sizeof(react_context_t) - sizeof(call_tree_t));
+	}
+
+	~react_context_t() {
+		react::memory_usage().sub(sizeof(react_context_t) - sizeof(call_tree_t));
+	}
 
 	concurrent_call_tree_t call_tree;
 	call_tree_updater_t updater;
 	react::aggregator_t *aggregator;
+
+	/*!
+	 * \brief Context adopted by worker context, NULL for regular contexts
+	 */
+	react_context_t *parent_context;
+
+	/*!
+	 * \brief Node of adopted context under which worker context is merged
+	 */
+	call_tree_t::p_node_t parent_node;
+
+	/*!
+	 * \brief Thread context that was current before adoption
+	 */
+	react_context_t *previous_context;
+
+	/*!
+	 * \brief Refcount of thread context that was current before adoption
+	 */
+	int previous_refcount;
 };
 
-static __thread react_context_t *thread_react_context = NULL;
-static __thread int thread_react_context_refcount = 0;
+__thread react_context_t *react_thread_context = NULL;
+static __thread int react_thread_context_refcount = 0;
+int react_inactive_metrics = 0;
+
+/*!
+ * \brief Checks whether calls in threads where react is not active are counted
+ */
+static bool inactive_metrics_enabled() {
+	return __atomic_load_n(&react_inactive_metrics, __ATOMIC_RELAXED);
+}
+
+/*!
+ * \brief Starts action in metrics of the thread where react is not active
+ */
+static void start_inactive_call(int action_code) {
+	if (!actions_set().code_is_valid(action_code)) {
+		throw std::invalid_argument(
+					"Can't start action: action code is invalid: "
+					+ std::to_string(static_cast<long long>(action_code))
+		);
+	}
+	react::thread_metrics_shard().start_call(action_code, !actions_set().is_disabled(action_code));
+}
+
+/*!
+ * \brief Stops action in metrics of the thread where react is not active
+ */
+static void stop_inactive_call(int action_code) {
+	if (!actions_set().code_is_valid(action_code)) {
+		throw std::invalid_argument(
+					"Can't stop action: action code is invalid: "
+					+ std::to_string(static_cast<long long>(action_code))
+		);
+	}
+	react::thread_metrics_shard().stop_call(action_code);
+}
+
+static void context_add_stat(react_context_t *context, const std::string &key, const react::stat_value_t &value) {
+	std::lock_guard<concurrent_call_tree_t> guard(context->call_tree);
+	context->call_tree.get_call_tree().add_stat(key, value);
+}
+
+static void context_add_stat(react_context_t *context, int stat_code, const react::stat_value_t &value) {
+	std::lock_guard<concurrent_call_tree_t> guard(context->call_tree);
+	context->call_tree.get_call_tree().add_stat(stat_code, value);
+}
+
+static void context_update_stat(react_context_t *context, int stat_code, react::stat_kind_t kind,
+		const react::stat_value_t &value) {
+	std::lock_guard<concurrent_call_tree_t> guard(context->call_tree);
+	context->call_tree.get_call_tree().update_stat(stat_code, kind, value);
+}
+
+static void context_update_node_stat(react_context_t *context, int stat_code, react::stat_kind_t kind,
+		const react::stat_value_t &value) {
+	std::lock_guard<concurrent_call_tree_t> guard(context->call_tree);
+	context->call_tree.get_call_tree().update_node_stat(
+		context->updater.get_current_node(), stat_code, kind, value
+	);
+}
 
 int react_is_active() {
-	return thread_react_context != NULL;
+	return react_thread_context != NULL;
+}
+
+/*!
+ * \brief Incremented in forked child, so that threads reseed their id generators
+ */
+static std::atomic<unsigned> fork_generation(0);
+
+/*!
+ * \brief Distinguishes generators seeded at the same time
+ */
+static std::atomic<uint64_t> seeds_counter(0);
+
+static void on_fork_in_child() {
+	fork_generation.fetch_add(1, std::memory_order_relaxed);
+}
+
+static const int ATFORK_REGISTERED = pthread_atfork(NULL, NULL, on_fork_in_child);
+
+/*!
+ * \brief Per-thread xorshift128+ generator of call tree ids
+ */
+struct id_generator_t {
+	uint64_t state[2];
+	unsigned fork_generation;
+	bool seeded;
+};
+
+static __thread id_generator_t thread_id_generator;
+
+static uint64_t splitmix64(uint64_t &x) {
+	uint64_t z = (x += 0x9e3779b97f4a7c15ULL);
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+static void seed_id_generator(id_generator_t &generator) {
+	uint64_t seed = std::chrono::high_resolution_clock::now().time_since_epoch().count();
+	seed ^= static_cast<uint64_t>(getpid()) << 32;
+	seed ^= reinterpret_cast<uintptr_t>(&generator);
+	seed ^= seeds_counter.fetch_add(1, std::memory_order_relaxed) * 0xd6e8feb86659fd93ULL;
+
+	generator.state[0] = splitmix64(seed);
+	generator.state[1] = splitmix64(seed);
+	generator.fork_generation = fork_generation.load(std::memory_order_relaxed);
+	generator.seeded = true;
 }
 
-const size_t ID_LENGTH = 64;
+static uint64_t next_random(id_generator_t &generator) {
+	uint64_t s1 = generator.state[0];
+	const uint64_t s0 = generator.state[1];
+	generator.state[0] = s0;
+	s1 ^= s1 << 23;
+	generator.state[1] = s1 ^ s0 ^ (s1 >> 17) ^ (s0 >> 26);
+	return generator.state[1] + s0;
+}
 
-std::string generate_random_id() {
-	char id[ID_LENGTH + 1];
-	for(size_t i = 0; i < ID_LENGTH; i++) {
-		sprintf(id + i, "%x", rand() % 16);
+static id_generator_t &get_id_generator() {
+	id_generator_t &generator = thread_id_generator;
+	if (!generator.seeded || generator.fork_generation != fork_generation.load(std::memory_order_relaxed)) {
+		seed_id_generator(generator);
 	}
-	return std::string(id);
+	return generator;
 }
 
-int react_activate(void *react_aggregator) {
+static trace_id_t generate_trace_id() {
+	id_generator_t &generator = get_id_generator();
+
+	trace_id_t id;
+	do {
+		id.high = next_random(generator);
+		id.low = next_random(generator);
+	} while (id.is_null());
+	return id;
+}
+
+static void start_context(react_context_t *context, const trace_id_t &trace_id, const trace_id_t &parent_id) {
+	call_tree_t &call_tree = context->call_tree.get_call_tree();
+	call_tree.set_id(generate_trace_id());
+	call_tree.set_trace_id(trace_id.is_null() ? call_tree.get_id() : trace_id);
+	call_tree.set_parent_id(parent_id);
+	context_add_stat(context, STAT_COMPLETE, react::stat_value_t(false));
+}
+
+/*!
+ * \brief Decides whether new call tree is recorded according to record mode
+ */
+static bool should_record() {
+	const uint64_t control_word = react::control_block().load();
+	switch (react::control_block_t::get_mode(control_word)) {
+	case react::RECORD_MODE_OFF:
+		return false;
+	case react::RECORD_MODE_FULL:
+		return true;
+	default:
+		return react::control_block_t::should_record(control_word, next_random(get_id_generator()) >> 32);
+	}
+}
+
+namespace react {
+bool is_subthread_aggregator(const aggregator_t *aggregator);
+} // namespace react
+
+static int activate(void *react_aggregator, const trace_id_t &trace_id, const trace_id_t &parent_id) {
+	(void) ATFORK_REGISTERED;
+
 	try {
-		if (!thread_react_context_refcount) {
-			thread_react_context = new react_context_t(
-						static_cast<react::aggregator_t*>(react_aggregator)
+		// Subthread tree is merged into its parent's tree, so it follows parent's sampling and aggregator
+		const bool is_subthread = react::is_subthread_aggregator(static_cast<react::aggregator_t*>(react_aggregator));
+		if (react_thread_context_refcount) {
+			// Nested activation joins current call tree or keeps thread not active
+		} else if (!is_subthread && !should_record()) {
+			// Thread stays not active, refcount keeps activations balanced
+		} else if (react::memory_usage().is_limit_exceeded()) {
+			react::memory_usage().add_skipped_activation();
+		} else {
+			react::aggregator_t *aggregator = is_subthread ? NULL : react::control_block().get_aggregator();
+			react_thread_context = new react_context_t(
+						aggregator ? aggregator : static_cast<react::aggregator_t*>(react_aggregator)
 			);
-			react::add_stat("complete", false);
-			react::add_stat("id", generate_random_id());
+			start_context(react_thread_context, trace_id, parent_id);
 		}
-		++thread_react_context_refcount;
+		++react_thread_context_refcount;
 	} catch (std::exception &e) {
 		std::cerr << e.what() << std::endl;
 		return -ENOMEM;
@@ -81,9 +294,127 @@ int react_activate(void *react_aggregator) {
 	return 0;
 }
 
+int react_activate(void *react_aggregator) {
+	return activate(react_aggregator, trace_id_t(), trace_id_t());
+}
+
+int react_activate_with_parent(void *react_aggregator, react_trace_id_t trace_id, react_trace_id_t parent_id) {
+	return activate(react_aggregator,
+		trace_id_t(trace_id.high, trace_id.low), trace_id_t(parent_id.high, parent_id.low)
+	);
+}
+
+static react_trace_id_t to_c_trace_id(const trace_id_t &id) {
+	react_trace_id_t result;
+	result.high = id.high;
+	result.low = id.low;
+	return result;
+}
+
+static int set_time_unit(react_context_t *context, react_time_unit_t unit) {
+	if (unit < REACT_TIME_UNIT_NANOSECONDS || unit > REACT_TIME_UNIT_MILLISECONDS) {
+		return -EINVAL;
+	}
+
+	std::lock_guard<concurrent_call_tree_t> guard(context->call_tree);
+	context->call_tree.get_call_tree().set_time_unit(static_cast<react::time_unit_t>(unit));
+	return 0;
+}
+
+int react_set_time_unit(react_time_unit_t unit) {
+	if (!react_is_active()) {
+		return 0;
+	}
+	return set_time_unit(react_thread_context, unit);
+}
+
+static int set_max_nodes(react_context_t *context, size_t max_nodes) {
+	if (max_nodes < 1) {
+		return -EINVAL;
+	}
+
+	std::lock_guard<concurrent_call_tree_t> guard(context->call_tree);
+	context->call_tree.get_call_tree().set_max_nodes(max_nodes);
+	return 0;
+}
+
+int react_set_max_nodes(size_t max_nodes) {
+	if (!react_is_active()) {
+		return 0;
+	}
+	return set_max_nodes(react_thread_context, max_nodes);
+}
+
+int react_get_id(react_trace_id_t *id) {
+	if (!react_is_active() || !id) {
+		return -EINVAL;
+	}
+	*id = to_c_trace_id(react_thread_context->call_tree.get_call_tree().get_id());
+	return 0;
+}
+
+int react_get_trace_id(react_trace_id_t *trace_id) {
+	if (!react_is_active() || !trace_id) {
+		return -EINVAL;
+	}
+	*trace_id = to_c_trace_id(react_thread_context->call_tree.get_call_tree().get_trace_id());
+	return 0;
+}
+
+size_t react_get_memory_usage() {
+	return react::memory_usage().get();
+}
+
+int react_set_memory_limit(size_t limit) {
+	react::memory_usage().set_soft_limit(limit ? limit : +react::memory_usage_t::NO_LIMIT);
+	return 0;
+}
+
+int react_set_memory_limit_percent(double percent) {
+	if (!(percent > 0 && percent <= 100)) {
+		return -EINVAL;
+	}
+
+	long pages = sysconf(_SC_PHYS_PAGES);
+	long page_size = sysconf(_SC_PAGESIZE);
+	if (pages <= 0 || page_size <= 0) {
+		return -EINVAL;
+	}
+
+	const double memory = static_cast<double>(pages) * page_size;
+	return react_set_memory_limit(std::max<size_t>(1, memory * percent / 100));
+}
+
+size_t react_get_skipped_activations() {
+	return react::memory_usage().get_skipped_activations();
+}
+
+int react_trace_id_from_string(const char *str, react_trace_id_t *trace_id) {
+	if (!str || !trace_id) {
+		return -EINVAL;
+	}
+
+	try {
+		*trace_id = to_c_trace_id(trace_id_t::from_string(str));
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return -EINVAL;
+	}
+	return 0;
+}
+
+int react_trace_id_to_string(react_trace_id_t trace_id, char *buffer, size_t size) {
+	if (!buffer || size < trace_id_t::STRING_LENGTH + 1) {
+		return -EINVAL;
+	}
+	trace_id_t(trace_id.high, trace_id.low).write_string(buffer);
+	buffer[trace_id_t::STRING_LENGTH] = '\0';
+	return 0;
+}
+
 int react_deactivate() {
 	try {
-		if (thread_react_context_refcount == 0) {
+		if (react_thread_context_refcount == 0) {
 			// Sanity check
 			assert(!react_is_active());
 
@@ -91,15 +422,19 @@ int react_deactivate() {
 			throw std::runtime_error(error_message);
 		}
 
-		if (thread_react_context_refcount == 1) {
-			react::add_stat("complete", true);
-			if (thread_react_context->aggregator) {
-				thread_react_context->aggregator->aggregate(thread_react_context->call_tree.get_call_tree());
+		if (react_thread_context_refcount == 1 && react_thread_context) {
+			if (react_thread_context->parent_context) {
+				throw std::logic_error("Can't deactivate react: context is adopted, it should be left");
+			}
+
+			react::add_stat(STAT_COMPLETE, true);
+			if (react_thread_context->aggregator) {
+				react_thread_context->aggregator->aggregate(react_thread_context->call_tree.get_call_tree());
 			}
-			delete thread_react_context;
-			thread_react_context = NULL;
+			delete react_thread_context;
+			react_thread_context = NULL;
 		}
-		--thread_react_context_refcount;
+		--react_thread_context_refcount;
 	} catch (std::exception &e) {
 		std::cerr << e.what() << std::endl;
 		return -EFAULT;
@@ -110,10 +445,13 @@ int react_deactivate() {
 int react_start_action(int action_code) {
 	try {
 		if (!react_is_active()) {
+			if (inactive_metrics_enabled()) {
+				start_inactive_call(action_code);
+			}
 			return 0;
 		}
 
-		thread_react_context->updater.start(action_code);
+		react_thread_context->updater.start(action_code);
 	} catch (std::exception& e) {
 		std::cerr << e.what() << std::endl;
 		return -EINVAL;
@@ -124,10 +462,70 @@ int react_start_action(int action_code) {
 int react_stop_action(int action_code) {
 	try {
 		if (!react_is_active()) {
+			if (inactive_metrics_enabled()) {
+				stop_inactive_call(action_code);
+			}
 			return 0;
 		}
 
-		thread_react_context->updater.stop(action_code);
+		react_thread_context->updater.stop(action_code);
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return -EINVAL;
+	}
+	return 0;
+}
+
+int react_add_action_error(int action_code) {
+	if (!actions_set().code_is_valid(action_code)) {
+		return -EINVAL;
+	}
+
+	try {
+		react::thread_metrics_shard().add_error(action_code);
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+int react_set_inactive_metrics(int enabled) {
+	__atomic_store_n(&react_inactive_metrics, enabled ? 1 : 0, __ATOMIC_RELAXED);
+	return 0;
+}
+
+int react_get_inactive_metrics() {
+	return inactive_metrics_enabled();
+}
+
+int react_get_action_metrics(int action_code, react_action_metrics_t *metrics) {
+	if (!metrics || !actions_set().code_is_valid(action_code)) {
+		return -EINVAL;
+	}
+
+	try {
+		const react::action_metrics_t totals = react::metrics_registry().get_action_metrics(action_code);
+		metrics->calls = totals.calls;
+		metrics->total_time_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+			call_tree_t::time_clock_t::duration(totals.total_time)
+		).count();
+		metrics->errors = totals.errors;
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+static_assert(static_cast<int>(REACT_ACTION_ENABLED) == react::ACTION_ENABLED &&
+		static_cast<int>(REACT_ACTION_DISABLED) == react::ACTION_DISABLED &&
+		static_cast<int>(REACT_ACTION_AGGREGATE_ONLY) == react::ACTION_AGGREGATE_ONLY,
+		"Action states of C and C++ API don't match");
+
+int react_set_action_state(int action_code, react_action_state_t state) {
+	try {
+		actions_set().set_action_state(action_code, static_cast<react::action_state_t>(state));
 	} catch (std::exception& e) {
 		std::cerr << e.what() << std::endl;
 		return -EINVAL;
@@ -135,6 +533,35 @@ int react_stop_action(int action_code) {
 	return 0;
 }
 
+int react_set_action_state_from_string(const char *action_state) {
+	if (!action_state) {
+		return -EINVAL;
+	}
+
+	const std::string str(action_state);
+	const size_t separator = str.rfind('=');
+	react::action_state_t state;
+	if (separator == std::string::npos ||
+			!actions_set_t::parse_action_state(str.substr(separator + 1), state)) {
+		return -EINVAL;
+	}
+
+	const int action_code = actions_set().get_action_code(str.substr(0, separator));
+	if (action_code == actions_set_t::NO_ACTION) {
+		return -EINVAL;
+	}
+	return react_set_action_state(action_code, static_cast<react_action_state_t>(state));
+}
+
+int react_get_action_state(int action_code, react_action_state_t *state) {
+	if (!state || !actions_set().code_is_valid(action_code)) {
+		return -EINVAL;
+	}
+
+	*state = static_cast<react_action_state_t>(actions_set().get_action_state(action_code));
+	return 0;
+}
+
 #define DEFINE_STAT_TYPE(name, type)                     \
 int react_add_stat_##name(const char *key, type value) { \
 	try {                                                \
@@ -151,17 +578,61 @@ int react_add_stat_##name(const char *key, type value) { \
 
 DEFINE_STAT_TYPE(bool,   bool)
 DEFINE_STAT_TYPE(int,    int)
+DEFINE_STAT_TYPE(int64,  int64_t)
+DEFINE_STAT_TYPE(uint64, uint64_t)
 DEFINE_STAT_TYPE(double, double)
 DEFINE_STAT_TYPE(string, const char *)
 
+#define DEFINE_CODE_STAT_TYPE(name, type)                             \
+int react_add_stat_##name##_by_code(int stat_code, type value) {      \
+	try {                                                             \
+		if (!react_is_active()) {                                     \
+			return 0;                                                 \
+		}                                                             \
+		react::add_stat(stat_code, value);                            \
+	} catch (std::exception& e) {                                     \
+		std::cerr << e.what() << std::endl;                           \
+		return -EINVAL;                                               \
+	}                                                                 \
+	return 0;                                                         \
+}
+
+DEFINE_CODE_STAT_TYPE(bool,   bool)
+DEFINE_CODE_STAT_TYPE(int,    int)
+DEFINE_CODE_STAT_TYPE(int64,  int64_t)
+DEFINE_CODE_STAT_TYPE(uint64, uint64_t)
+DEFINE_CODE_STAT_TYPE(double, double)
+DEFINE_CODE_STAT_TYPE(string, const char *)
+
+#define DEFINE_STAT_UPDATE(name, function)                   \
+int react_##name(int stat_code, int64_t value) {            \
+	try {                                                   \
+		if (!react_is_active()) {                           \
+			return 0;                                       \
+		}                                                   \
+		react::function(stat_code, value);                  \
+	} catch (std::exception& e) {                           \
+		std::cerr << e.what() << std::endl;                 \
+		return -EINVAL;                                     \
+	}                                                       \
+	return 0;                                               \
+}
+
+DEFINE_STAT_UPDATE(increment_stat,        increment_stat)
+DEFINE_STAT_UPDATE(update_stat_max,       update_stat_max)
+DEFINE_STAT_UPDATE(update_stat_min,       update_stat_min)
+DEFINE_STAT_UPDATE(increment_node_stat,   increment_node_stat)
+DEFINE_STAT_UPDATE(update_node_stat_max,  update_node_stat_max)
+DEFINE_STAT_UPDATE(update_node_stat_min,  update_node_stat_min)
+
 int react_submit_progress() {
 	try {
 		if (!react_is_active()) {
 			return 0;
 		}
 
-		if (thread_react_context->aggregator) {
-			thread_react_context->aggregator->aggregate(thread_react_context->call_tree.get_call_tree());
+		if (react_thread_context->aggregator) {
+			react_thread_context->aggregator->aggregate(react_thread_context->call_tree.get_call_tree());
 		}
 	} catch (std::exception& e) {
 		std::cerr << e.what() << std::endl;
@@ -172,19 +643,72 @@ int react_submit_progress() {
 
 namespace react {
 
-action_guard::action_guard(int action_code) {
-	if (react_is_active()) {
-		m_action_guard.reset(
-					new action_guard_t(&thread_react_context->updater, action_code)
-		);
+void action_guard::start() {
+	if (!react_thread_context) {
+		if (inactive_metrics_enabled()) {
+			start_inactive_call(action_code);
+			is_inactive_call = true;
+		}
+		return;
+	}
+
+	react_thread_context->updater.start(action_code);
+	updater = &react_thread_context->updater;
+}
+
+action_guard::action_guard(action_guard &&other) noexcept:
+	updater(other.updater), action_code(other.action_code), is_inactive_call(other.is_inactive_call) {
+	other.updater = NULL;
+	other.action_code = actions_set_t::NO_ACTION;
+	other.is_inactive_call = false;
+}
+
+action_guard &action_guard::operator =(action_guard &&other) {
+	if (this != &other) {
+		release();
+		updater = other.updater;
+		action_code = other.action_code;
+		is_inactive_call = other.is_inactive_call;
+		other.updater = NULL;
+		other.action_code = actions_set_t::NO_ACTION;
+		other.is_inactive_call = false;
 	}
+	return *this;
 }
 
-action_guard::~action_guard() {}
+void action_guard::stop() {
+	if (is_inactive_call) {
+		is_inactive_call = false;
+		stop_inactive_call(action_code);
+		action_code = actions_set_t::NO_ACTION;
+		return;
+	}
+
+	if (!updater) {
+		if (action_code == actions_set_t::NO_ACTION) {
+			throw std::logic_error("action is already stopped");
+		}
+		return;
+	}
+
+	updater->stop(action_code);
+	updater = NULL;
+	action_code = actions_set_t::NO_ACTION;
+}
 
-void react::action_guard::stop() {
-	if (m_action_guard) {
-		m_action_guard->stop();
+void action_guard::release() {
+	if (updater || is_inactive_call) {
+		try {
+			if (updater) {
+				updater->stop(action_code);
+			} else {
+				stop_inactive_call(action_code);
+			}
+		} catch (std::exception &e) {
+			std::cerr << e.what() << std::endl;
+		}
+		updater = NULL;
+		is_inactive_call = false;
 	}
 }
 
@@ -197,14 +721,36 @@ void add_stat(const std::string &key, const char *value) {
 }
 
 void add_stat_impl(const std::string &key, const react::stat_value_t &value) {
-	if (thread_react_context) {
-		thread_react_context->call_tree.get_call_tree().add_stat(key, value);
+	if (react_thread_context) {
+		context_add_stat(react_thread_context, key, value);
+	}
+}
+
+void add_stat(int stat_code, const char *value) {
+	add_stat_impl(stat_code, react::stat_value_t(std::string(value)));
+}
+
+void add_stat_impl(int stat_code, const react::stat_value_t &value) {
+	if (react_thread_context) {
+		context_add_stat(react_thread_context, stat_code, value);
+	}
+}
+
+void update_stat_impl(int stat_code, stat_kind_t kind, const react::stat_value_t &value) {
+	if (react_thread_context) {
+		context_update_stat(react_thread_context, stat_code, kind, value);
+	}
+}
+
+void update_node_stat_impl(int stat_code, stat_kind_t kind, const react::stat_value_t &value) {
+	if (react_thread_context) {
+		context_update_node_stat(react_thread_context, stat_code, kind, value);
 	}
 }
 
 class subthread_aggregator_t : public aggregator_t {
 public:
-	subthread_aggregator_t(): parent_context(thread_react_context) {
+	subthread_aggregator_t(): parent_context(react_thread_context) {
 		if (parent_context) {
 			parent_node = parent_context->updater.get_current_node();
 		}
@@ -215,11 +761,11 @@ public:
 		if (!parent_context)
 			return;
 
-		if (call_tree.get_stat<bool>("complete") == false) {
+		if (call_tree.get_stat<bool>(STAT_COMPLETE) == false) {
 			parent_context->aggregator->aggregate(call_tree);
 		} else {
 			std::lock_guard<concurrent_call_tree_t> guard(parent_context->call_tree);
-			thread_react_context->call_tree.get_call_tree().merge_into(
+			react_thread_context->call_tree.get_call_tree().merge_into(
 				parent_node, parent_context->call_tree.get_call_tree()
 			);
 		}
@@ -230,6 +776,10 @@ private:
 	call_tree_t::p_node_t parent_node;
 };
 
+bool is_subthread_aggregator(const aggregator_t *aggregator) {
+	return dynamic_cast<const subthread_aggregator_t*>(aggregator) != NULL;
+}
+
 std::shared_ptr<aggregator_t> create_subthread_aggregator() {
 	if (!react_is_active()) {
 		throw std::runtime_error("Can't create subthread aggregator: React is not active");
@@ -240,6 +790,147 @@ std::shared_ptr<aggregator_t> create_subthread_aggregator() {
 
 } // namespace react
 
+/*!
+ * \brief Per-thread buffers for adopted contexts, reused between tasks. Nested adoptions use next buffer.
+ */
+static thread_local std::vector<std::unique_ptr<react_context_t>> thread_worker_contexts;
+static __thread size_t thread_adoption_depth = 0;
+
+static void adopt_context(react_context_t *parent_context, call_tree_t::p_node_t parent_node) {
+	if (thread_adoption_depth == thread_worker_contexts.size()) {
+		thread_worker_contexts.emplace_back(new react_context_t(NULL));
+	}
+
+	react_context_t *worker_context = thread_worker_contexts[thread_adoption_depth].get();
+	++thread_adoption_depth;
+
+	worker_context->parent_context = parent_context;
+	worker_context->parent_node = parent_node;
+	worker_context->previous_context = react_thread_context;
+	worker_context->previous_refcount = react_thread_context_refcount;
+
+	react_thread_context = worker_context;
+	react_thread_context_refcount = 1;
+}
+
+static void leave_context() {
+	if (thread_adoption_depth == 0 ||
+			react_thread_context != thread_worker_contexts[thread_adoption_depth - 1].get()) {
+		throw std::logic_error("Can't leave context: context is not adopted");
+	}
+
+	std::unique_ptr<react_context_t> &worker_context = thread_worker_contexts[thread_adoption_depth - 1];
+	react_thread_context = worker_context->previous_context;
+	react_thread_context_refcount = worker_context->previous_refcount;
+	--thread_adoption_depth;
+
+	call_tree_t &call_tree = worker_context->call_tree.get_call_tree();
+	if (worker_context->updater.get_trace_depth() != 0) {
+		// Task didn't stop its actions, buffer can't be reused
+		react_context_t *parent_context = worker_context->parent_context;
+		call_tree_t::p_node_t parent_node = worker_context->parent_node;
+		worker_context.reset(new react_context_t(NULL));
+		worker_context->parent_context = parent_context;
+		worker_context->parent_node = parent_node;
+		throw std::logic_error("Can't leave context: task has unfinished actions");
+	}
+
+	if (!call_tree.empty()) {
+		react_context_t *parent_context = worker_context->parent_context;
+		std::lock_guard<concurrent_call_tree_t> guard(parent_context->call_tree);
+		call_tree.merge_into(worker_context->parent_node, parent_context->call_tree.get_call_tree());
+	}
+	call_tree.clear();
+}
+
+namespace react {
+
+context_token capture_context() {
+	if (!react_is_active()) {
+		return context_token();
+	}
+
+	if (react_thread_context->parent_context) {
+		// Actions of worker context are merged later, so tasks spawned by it are attached to adopted node
+		return context_token(react_thread_context->parent_context, react_thread_context->parent_node);
+	}
+
+	return context_token(react_thread_context, react_thread_context->updater.get_current_node());
+}
+
+adopt_guard::adopt_guard(const context_token &token): adopted(false) {
+	if (!token.empty()) {
+		adopt_context(token.context, token.node);
+		adopted = true;
+	}
+}
+
+adopt_guard::~adopt_guard() {
+	if (adopted) {
+		try {
+			leave_context();
+		} catch (std::exception &e) {
+			std::cerr << e.what() << std::endl;
+		}
+	}
+}
+
+context_state get_context_state() {
+	return context_state(react_thread_context, react_thread_context_refcount);
+}
+
+context_state exchange_context(const context_state &state) {
+	context_state previous(react_thread_context, react_thread_context_refcount);
+	react_thread_context = state.context;
+	react_thread_context_refcount = state.refcount;
+	return previous;
+}
+
+} // namespace react
+
+void *react_capture_context() {
+	try {
+		if (!react_is_active()) {
+			return NULL;
+		}
+
+		return new react::context_token(react::capture_context());
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return NULL;
+	}
+}
+
+int react_release_context(void *token) {
+	delete static_cast<react::context_token*>(token);
+	return 0;
+}
+
+int react_adopt_context(void *token) {
+	if (!token || static_cast<react::context_token*>(token)->empty()) {
+		return -EINVAL;
+	}
+
+	try {
+		react::context_token *context_token = static_cast<react::context_token*>(token);
+		adopt_context(context_token->context, context_token->node);
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return -ENOMEM;
+	}
+	return 0;
+}
+
+int react_leave_context() {
+	try {
+		leave_context();
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return -EINVAL;
+	}
+	return 0;
+}
+
 void *react_create_subthread_aggregator() {
 	try {
 		if (!react_is_active()) {
@@ -262,3 +953,235 @@ int react_destroy_subthread_aggregator(void *subthread_aggregator) {
 	}
 	return 0;
 }
+
+/*!
+ * \brief Maximum number of finished handle contexts kept for reuse
+ */
+static const size_t MAX_POOLED_CONTEXTS = 1024;
+
+static std::mutex context_pool_mutex;
+static std::vector<std::unique_ptr<react_context_t>> context_pool;
+
+static react_context_t *acquire_context(void *react_aggregator) {
+	std::unique_ptr<react_context_t> context;
+	{
+		std::lock_guard<std::mutex> guard(context_pool_mutex);
+		if (!context_pool.empty()) {
+			context = std::move(context_pool.back());
+			context_pool.pop_back();
+		}
+	}
+
+	if (!context) {
+		context.reset(new react_context_t(NULL));
+	}
+	context->aggregator = static_cast<react::aggregator_t*>(react_aggregator);
+	return context.release();
+}
+
+static void release_context(react_context_t *context) {
+	std::unique_ptr<react_context_t> context_holder(context);
+	if (context->updater.get_trace_depth() != 0) {
+		// Unfinished actions are left in the updater, context can't be reused
+		return;
+	}
+
+	context->call_tree.get_call_tree().clear();
+	std::lock_guard<std::mutex> guard(context_pool_mutex);
+	if (context_pool.size() < MAX_POOLED_CONTEXTS) {
+		context_pool.push_back(std::move(context_holder));
+	}
+}
+
+/*!
+ * \brief Handle of contexts whose trees are not recorded, calls with it do nothing
+ */
+static char not_recorded_context;
+
+static bool is_recorded(void *context_handle) {
+	return context_handle != &not_recorded_context;
+}
+
+static void *create_context(void *react_aggregator, const trace_id_t &trace_id, const trace_id_t &parent_id) {
+	try {
+		if (!should_record()) {
+			return &not_recorded_context;
+		}
+		if (react::memory_usage().is_limit_exceeded()) {
+			react::memory_usage().add_skipped_activation();
+			return &not_recorded_context;
+		}
+
+		react::aggregator_t *aggregator = react::control_block().get_aggregator();
+		react_context_t *context = acquire_context(aggregator ? aggregator : react_aggregator);
+		try {
+			start_context(context, trace_id, parent_id);
+		} catch (...) {
+			release_context(context);
+			throw;
+		}
+		return context;
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return NULL;
+	}
+}
+
+void *react_context_create(void *react_aggregator) {
+	return create_context(react_aggregator, trace_id_t(), trace_id_t());
+}
+
+void *react_context_create_with_parent(void *react_aggregator,
+		react_trace_id_t trace_id, react_trace_id_t parent_id) {
+	return create_context(react_aggregator,
+		trace_id_t(trace_id.high, trace_id.low), trace_id_t(parent_id.high, parent_id.low)
+	);
+}
+
+int react_context_finish(void *context_handle) {
+	if (!context_handle) {
+		return -EINVAL;
+	}
+
+	if (!is_recorded(context_handle)) {
+		return 0;
+	}
+
+	react_context_t *context = static_cast<react_context_t*>(context_handle);
+	int err = 0;
+	try {
+		context_add_stat(context, STAT_COMPLETE, react::stat_value_t(true));
+		if (context->aggregator) {
+			context->aggregator->aggregate(context->call_tree.get_call_tree());
+		}
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		err = -EINVAL;
+	}
+	release_context(context);
+	return err;
+}
+
+int react_context_set_time_unit(void *context_handle, react_time_unit_t unit) {
+	if (!context_handle) {
+		return -EINVAL;
+	}
+	if (!is_recorded(context_handle)) {
+		return 0;
+	}
+	return set_time_unit(static_cast<react_context_t*>(context_handle), unit);
+}
+
+int react_context_set_max_nodes(void *context_handle, size_t max_nodes) {
+	if (!context_handle) {
+		return -EINVAL;
+	}
+	if (!is_recorded(context_handle)) {
+		return 0;
+	}
+	return set_max_nodes(static_cast<react_context_t*>(context_handle), max_nodes);
+}
+
+int react_context_get_id(void *context_handle, react_trace_id_t *id) {
+	if (!context_handle || !id) {
+		return -EINVAL;
+	}
+	if (!is_recorded(context_handle)) {
+		*id = to_c_trace_id(trace_id_t());
+		return 0;
+	}
+	react_context_t *context = static_cast<react_context_t*>(context_handle);
+	*id = to_c_trace_id(context->call_tree.get_call_tree().get_id());
+	return 0;
+}
+
+int react_context_start_action(void *context_handle, int action_code) {
+	try {
+		if (!context_handle) {
+			return -EINVAL;
+		}
+		if (!is_recorded(context_handle)) {
+			return 0;
+		}
+
+		static_cast<react_context_t*>(context_handle)->updater.start(action_code);
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return -EINVAL;
+	}
+	return 0;
+}
+
+int react_context_stop_action(void *context_handle, int action_code) {
+	try {
+		if (!context_handle) {
+			return -EINVAL;
+		}
+		if (!is_recorded(context_handle)) {
+			return 0;
+		}
+
+		static_cast<react_context_t*>(context_handle)->updater.stop(action_code);
+	} catch (std::exception& e) {
+		std::cerr << e.what() << std::endl;
+		return -EINVAL;
+	}
+	return 0;
+}
+
+#define DEFINE_CONTEXT_STAT(function, key_type, key_value, type, value_type)         \
+int react_context_##function(void *context_handle, key_type key, type value) {     \
+	try {                                                                          \
+		if (!context_handle) {                                                     \
+			return -EINVAL;                                                        \
+		}                                                                          \
+		if (!is_recorded(context_handle)) {                                        \
+			return 0;                                                              \
+		}                                                                          \
+		context_add_stat(static_cast<react_context_t*>(context_handle),            \
+			key_value, react::stat_value_t(value_type(value)));                    \
+	} catch (std::exception& e) {                                                  \
+		std::cerr << e.what() << std::endl;                                        \
+		return -EINVAL;                                                            \
+	}                                                                              \
+	return 0;                                                                      \
+}
+
+DEFINE_CONTEXT_STAT(add_stat_bool,   const char *, std::string(key), bool,         bool)
+DEFINE_CONTEXT_STAT(add_stat_int,    const char *, std::string(key), int,          int)
+DEFINE_CONTEXT_STAT(add_stat_int64,  const char *, std::string(key), int64_t,      int64_t)
+DEFINE_CONTEXT_STAT(add_stat_uint64, const char *, std::string(key), uint64_t,     uint64_t)
+DEFINE_CONTEXT_STAT(add_stat_double, const char *, std::string(key), double,       double)
+DEFINE_CONTEXT_STAT(add_stat_string, const char *, std::string(key), const char *, std::string)
+
+DEFINE_CONTEXT_STAT(add_stat_bool_by_code,   int, key, bool,         bool)
+DEFINE_CONTEXT_STAT(add_stat_int_by_code,    int, key, int,          int)
+DEFINE_CONTEXT_STAT(add_stat_int64_by_code,  int, key, int64_t,      int64_t)
+DEFINE_CONTEXT_STAT(add_stat_uint64_by_code, int, key, uint64_t,     uint64_t)
+DEFINE_CONTEXT_STAT(add_stat_double_by_code, int, key, double,       double)
+DEFINE_CONTEXT_STAT(add_stat_string_by_code, int, key, const char *, std::string)
+
+#define DEFINE_CONTEXT_STAT_UPDATE(name, update, kind)                            \
+int react_context_##name(void *context_handle, int stat_code, int64_t value) {   \
+	try {                                                                        \
+		if (!context_handle) {                                                   \
+			return -EINVAL;                                                      \
+		}                                                                        \
+		if (!is_recorded(context_handle)) {                                      \
+			return 0;                                                            \
+		}                                                                        \
+		update(static_cast<react_context_t*>(context_handle),                    \
+			stat_code, kind, react::stat_value_t(value));                        \
+	} catch (std::exception& e) {                                                \
+		std::cerr << e.what() << std::endl;                                      \
+		return -EINVAL;                                                          \
+	}                                                                            \
+	return 0;                                                                    \
+}
+
+DEFINE_CONTEXT_STAT_UPDATE(increment_stat,       context_update_stat,      react::STAT_COUNTER)
+DEFINE_CONTEXT_STAT_UPDATE(update_stat_max,      context_update_stat,      react::STAT_MAX)
+DEFINE_CONTEXT_STAT_UPDATE(update_stat_min,      context_update_stat,      react::STAT_MIN)
+DEFINE_CONTEXT_STAT_UPDATE(increment_node_stat,  context_update_node_stat, react::STAT_COUNTER)
+DEFINE_CONTEXT_STAT_UPDATE(update_node_stat_max, context_update_node_stat, react::STAT_MAX)
+DEFINE_CONTEXT_STAT_UPDATE(update_node_stat_min, context_update_node_stat, react::STAT_MIN)
@@ -0,0 +1,164 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#include "react/tree_reader.hpp"
+#include "react/tree_reader.h"
+
+#include <iostream>
+#include <stdexcept>
+
+using namespace react;
+
+static_assert(static_cast<int>(REACT_JSON_NULL) == json_value_t::TYPE_NULL &&
+		static_cast<int>(REACT_JSON_BOOL) == json_value_t::TYPE_BOOL &&
+		static_cast<int>(REACT_JSON_INT64) == json_value_t::TYPE_INT64 &&
+		static_cast<int>(REACT_JSON_UINT64) == json_value_t::TYPE_UINT64 &&
+		static_cast<int>(REACT_JSON_DOUBLE) == json_value_t::TYPE_DOUBLE &&
+		static_cast<int>(REACT_JSON_STRING) == json_value_t::TYPE_STRING,
+		"react_json_type_t must match react::json_value_t::type_t");
+
+/*!
+ * \brief Handler of tree_reader_t that forwards events to C callbacks
+ */
+class callbacks_handler_t {
+public:
+	callbacks_handler_t(const react_tree_reader_callbacks_t &callbacks, void *user_data,
+			const names_table_t &names):
+		callbacks(callbacks), user_data(user_data), names(names) {}
+
+	void tree_begin() {
+		if (callbacks.tree_begin) {
+			callbacks.tree_begin(user_data);
+		}
+	}
+
+	void node_enter(int action_id, int64_t start_time, int64_t stop_time) {
+		if (callbacks.node_enter) {
+			const std::string &name = names.get_name(action_id);
+			callbacks.node_enter(user_data, action_id, name.data(), name.size(), start_time, stop_time);
+		}
+	}
+
+	void node_exit() {
+		if (callbacks.node_exit) {
+			callbacks.node_exit(user_data);
+		}
+	}
+
+	void stat(const char *key, size_t key_length, const json_value_t &value) {
+		if (!callbacks.stat) {
+			return;
+		}
+
+		react_json_value_t c_value;
+		c_value.type = static_cast<react_json_type_t>(value.type);
+		c_value.value.int64_value = 0;
+		switch (value.type) {
+		case json_value_t::TYPE_BOOL:
+			c_value.value.bool_value = value.bool_value;
+			break;
+		case json_value_t::TYPE_INT64:
+			c_value.value.int64_value = value.int64_value;
+			break;
+		case json_value_t::TYPE_UINT64:
+			c_value.value.uint64_value = value.uint64_value;
+			break;
+		case json_value_t::TYPE_DOUBLE:
+			c_value.value.double_value = value.double_value;
+			break;
+		default:
+			break;
+		}
+		c_value.string_value = value.type == json_value_t::TYPE_STRING ? value.string_value : NULL;
+		c_value.string_length = value.type == json_value_t::TYPE_STRING ? value.string_length : 0;
+		callbacks.stat(user_data, key, key_length, &c_value);
+	}
+
+	void tree_end(const tree_info_t &info) {
+		if (callbacks.tree_end) {
+			callbacks.tree_end(user_data, info.id.c_str(), info.id.size());
+		}
+	}
+
+private:
+	react_tree_reader_callbacks_t callbacks;
+	void *user_data;
+	const names_table_t &names;
+};
+
+struct react_tree_reader {
+	react_tree_reader(const react_tree_reader_callbacks_t &callbacks, void *user_data):
+		handler(callbacks, user_data, names), reader(handler, names) {}
+
+	names_table_t names;
+	callbacks_handler_t handler;
+	tree_reader_t<callbacks_handler_t> reader;
+};
+
+react_tree_reader_t *react_tree_reader_create(const react_tree_reader_callbacks_t *callbacks, void *user_data) {
+	if (!callbacks) {
+		std::cerr << "Can't create tree reader: callbacks are not set" << std::endl;
+		return NULL;
+	}
+
+	try {
+		return new react_tree_reader_t(*callbacks, user_data);
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return NULL;
+	}
+}
+
+void react_tree_reader_destroy(react_tree_reader_t *reader) {
+	delete reader;
+}
+
+int react_tree_reader_parse(react_tree_reader_t *reader, const char *data, size_t size) {
+	if (!reader || (!data && size)) {
+		return -EINVAL;
+	}
+
+	try {
+		return reader->reader.parse_all(data, data + size);
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return -ENOMEM;
+	}
+}
+
+int react_tree_reader_parse_file(react_tree_reader_t *reader, const char *path) {
+	if (!reader || !path) {
+		return -EINVAL;
+	}
+
+	try {
+		mapped_file_t file(path);
+		return reader->reader.parse_all(file.begin(), file.end());
+	} catch (std::exception &e) {
+		std::cerr << e.what() << std::endl;
+		return -EINVAL;
+	}
+}
+
+const char *react_tree_reader_get_action_name(react_tree_reader_t *reader, int action_id) {
+	if (!reader || action_id < 0 || static_cast<size_t>(action_id) >= reader->names.size()) {
+		return NULL;
+	}
+	return reader->names.get_name(action_id).c_str();
+}
+
+size_t react_tree_reader_get_actions_count(react_tree_reader_t *reader) {
+	return reader ? reader->names.size() : 0;
+}
@@ -0,0 +1,135 @@
+#include "tests.hpp"
+
+#include <algorithm>
+
+#include "react/action_reduce.hpp"
+#include "react/summary_aggregator.hpp"
+
+BOOST_AUTO_TEST_SUITE( action_reduce_suite )
+
+using namespace react;
+
+static void fill_call_tree(call_tree_t &call_tree, const std::vector<int> &action_codes, size_t count) {
+	for (size_t i = 0; i < count; ++i) {
+		call_tree_t::p_node_t node = call_tree.add_new_link(call_tree.root, action_codes[i % action_codes.size()]);
+		call_tree.set_node_start_ticks(node, i);
+		call_tree.set_node_stop_ticks(node, i + (i * 7919) % 1000);
+	}
+}
+
+static void check_kernel(reduce_kernel_t kernel) {
+	actions_set_t actions_set;
+	std::vector<int> action_codes;
+	for (int i = 0; i < 5; ++i) {
+		action_codes.push_back(actions_set.define_new_action("ACTION_" + std::to_string(static_cast<long long>(i))));
+	}
+
+	// Size isn't a multiple of block or vector size to test tails
+	call_tree_t call_tree(actions_set);
+	fill_call_tree(call_tree, action_codes, 1003);
+	columnar_call_tree_t columnar_tree(call_tree);
+
+	std::vector<action_summary_t> expected;
+	summarize_actions(columnar_tree, expected);
+
+	std::vector<int64_t> bounds;
+	bounds.push_back(10);
+	bounds.push_back(100);
+	bounds.push_back(500);
+	action_histogram_t histogram(bounds);
+	std::vector<action_summary_t> summaries;
+	reduce_actions(columnar_tree, summaries, &histogram, kernel);
+
+	BOOST_REQUIRE_EQUAL( summaries.size(), expected.size() );
+	for (size_t i = 0; i < summaries.size(); ++i) {
+		BOOST_CHECK_EQUAL( summaries[i].calls, expected[i].calls );
+		BOOST_CHECK_EQUAL( summaries[i].total_time, expected[i].total_time );
+		BOOST_CHECK_EQUAL( summaries[i].min_time, expected[i].min_time );
+		BOOST_CHECK_EQUAL( summaries[i].max_time, expected[i].max_time );
+	}
+
+	const std::vector<int64_t> &start_times = columnar_tree.get_start_times();
+	const std::vector<int64_t> &stop_times = columnar_tree.get_stop_times();
+	std::vector<uint64_t> expected_counts(action_codes.size() * histogram.buckets_count());
+	for (size_t i = 0; i < columnar_tree.size(); ++i) {
+		int64_t duration = stop_times[i] - start_times[i];
+		size_t bucket = std::upper_bound(bounds.begin(), bounds.end(), duration) - bounds.begin();
+		++expected_counts[columnar_tree.get_action_codes()[i] * histogram.buckets_count() + bucket];
+	}
+	BOOST_CHECK( histogram.counts == expected_counts );
+}
+
+BOOST_AUTO_TEST_CASE( reduce_actions_scalar_test )
+{
+	check_kernel(REDUCE_KERNEL_SCALAR);
+}
+
+BOOST_AUTO_TEST_CASE( reduce_actions_avx2_test )
+{
+	if (!reduce_kernel_is_supported(REDUCE_KERNEL_AVX2)) {
+		BOOST_TEST_MESSAGE( "AVX2 is not supported, test is skipped" );
+		return;
+	}
+	check_kernel(REDUCE_KERNEL_AVX2);
+}
+
+BOOST_AUTO_TEST_CASE( reduce_actions_auto_test )
+{
+	BOOST_CHECK( reduce_kernel_is_supported(get_auto_reduce_kernel()) );
+	check_kernel(REDUCE_KERNEL_AUTO);
+}
+
+BOOST_AUTO_TEST_CASE( reduce_actions_empty_bounds_test )
+{
+	actions_set_t actions_set;
+	std::vector<int> action_codes;
+	action_codes.push_back(actions_set.define_new_action("ACTION_0"));
+	action_codes.push_back(actions_set.define_new_action("ACTION_1"));
+
+	call_tree_t call_tree(actions_set);
+	fill_call_tree(call_tree, action_codes, 301);
+	columnar_call_tree_t columnar_tree(call_tree);
+
+	const reduce_kernel_t kernels[] = {REDUCE_KERNEL_SCALAR, REDUCE_KERNEL_AVX2, REDUCE_KERNEL_AUTO};
+	for (size_t i = 0; i < sizeof(kernels) / sizeof(kernels[0]); ++i) {
+		if (!reduce_kernel_is_supported(kernels[i])) {
+			continue;
+		}
+
+		action_histogram_t histogram;
+		std::vector<action_summary_t> summaries;
+		reduce_actions(columnar_tree, summaries, &histogram, kernels[i]);
+
+		BOOST_CHECK_EQUAL( histogram.buckets_count(), 1 );
+		BOOST_CHECK_EQUAL( histogram.get_count(action_codes[0], 0), 151 );
+		BOOST_CHECK_EQUAL( histogram.get_count(action_codes[1], 0), 150 );
+	}
+}
+
+BOOST_AUTO_TEST_CASE( summary_aggregator_histogram_test )
+{
+	actions_set_t actions_set;
+	int action_code = actions_set.define_new_action("ACTION");
+
+	call_tree_t call_tree(actions_set);
+	call_tree_t::p_node_t node = call_tree.add_new_link(call_tree.root, action_code);
+	call_tree.set_node_stop_ticks(node, call_tree_t::time_clock_t::duration(std::chrono::microseconds(7)).count());
+
+	std::vector<int64_t> bounds;
+	bounds.push_back(5);
+	bounds.push_back(10);
+	summary_aggregator_t aggregator(actions_set, bounds);
+	aggregator.aggregate(call_tree);
+
+	BOOST_CHECK_EQUAL( aggregator.get_histogram().get_count(action_code, 0), 0 );
+	BOOST_CHECK_EQUAL( aggregator.get_histogram().get_count(action_code, 1), 1 );
+	BOOST_CHECK_EQUAL( aggregator.get_histogram().get_count(action_code, 2), 0 );
+
+	rapidjson::Document doc;
+	doc.SetObject();
+	aggregator.to_json(doc, doc.GetAllocator());
+	BOOST_CHECK_EQUAL( doc["histogram_bounds"].Size(), 2 );
+	BOOST_CHECK_EQUAL( doc["actions"][rapidjson::SizeType(0)]["histogram"][rapidjson::SizeType(1)].GetUint64(), 1 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
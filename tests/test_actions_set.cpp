@@ -74,7 +74,85 @@ BOOST_AUTO_TEST_CASE( get_action_name_no_action_test )
 	actions_set_t actions_set;
 
 	BOOST_CHECK_THROW( actions_set.get_action_name(actions_set_t::NO_ACTION),
-					   std::invalid_argument )
+					   std::invalid_argument );
+}
+
+BOOST_AUTO_TEST_CASE( define_new_stat_test )
+{
+	actions_set_t actions_set;
+
+	for (int i = 0; i < 10; ++i)
+	{
+		int stat_code = actions_set.define_new_stat("STAT" + std::to_string(static_cast<long long>(i)));
+		BOOST_CHECK_EQUAL( stat_code, i );
+	}
+
+	for (int i = 0; i < 10; ++i)
+	{
+		int stat_code = actions_set.define_new_stat("STAT" + std::to_string(static_cast<long long>(i)));
+		BOOST_CHECK_EQUAL( stat_code, i );
+		BOOST_CHECK_EQUAL( actions_set.get_stat_code("STAT" + std::to_string(static_cast<long long>(i))), i );
+		BOOST_CHECK_EQUAL( actions_set.get_stat_name(i), "STAT" + std::to_string(static_cast<long long>(i)) );
+	}
+
+	BOOST_CHECK_EQUAL( actions_set.get_stat_code("UNKNOWN"), +actions_set_t::NO_STAT );
+	BOOST_CHECK_THROW( actions_set.get_stat_name(10), std::invalid_argument );
+	BOOST_CHECK_THROW( actions_set.get_stat_name(actions_set_t::NO_STAT), std::invalid_argument );
+}
+
+BOOST_AUTO_TEST_CASE( names_index_test )
+{
+	actions_set_t actions_set;
+
+	const int NAMES_NUMBER = 1000;
+	for (int i = 0; i < NAMES_NUMBER; ++i)
+	{
+		const std::string name = "NAME" + std::to_string(static_cast<long long>(i));
+		BOOST_CHECK_EQUAL( actions_set.define_new_action(name), i );
+		BOOST_CHECK_EQUAL( actions_set.define_new_stat(name), i );
+	}
+
+	for (int i = NAMES_NUMBER - 1; i >= 0; --i)
+	{
+		const std::string name = "NAME" + std::to_string(static_cast<long long>(i));
+		BOOST_CHECK_EQUAL( actions_set.get_action_code(name), i );
+		BOOST_CHECK_EQUAL( actions_set.get_stat_code(name), i );
+	}
+
+	BOOST_CHECK_EQUAL( actions_set.get_action_code("UNKNOWN"), +actions_set_t::NO_ACTION );
+}
+
+BOOST_AUTO_TEST_CASE( action_state_test )
+{
+	actions_set_t actions_set;
+	int action_code = actions_set.define_new_action("ACTION");
+
+	BOOST_CHECK_EQUAL( actions_set.get_action_code("ACTION"), action_code );
+	BOOST_CHECK_EQUAL( actions_set.get_action_code("UNKNOWN"), +actions_set_t::NO_ACTION );
+	BOOST_CHECK_EQUAL( actions_set.get_action_state(action_code), ACTION_ENABLED );
+	BOOST_CHECK( !actions_set.is_skipped(action_code) );
+
+	actions_set.set_action_state(action_code, ACTION_DISABLED);
+	BOOST_CHECK_EQUAL( actions_set.get_action_state(action_code), ACTION_DISABLED );
+	BOOST_CHECK( actions_set.is_skipped(action_code) );
+	BOOST_CHECK( !actions_set.is_aggregated(action_code) );
+
+	actions_set.set_action_state(action_code, ACTION_AGGREGATE_ONLY);
+	BOOST_CHECK_EQUAL( actions_set.get_action_state(action_code), ACTION_AGGREGATE_ONLY );
+	BOOST_CHECK( actions_set.is_skipped(action_code) );
+	BOOST_CHECK( actions_set.is_aggregated(action_code) );
+
+	actions_set.set_action_state(action_code, ACTION_ENABLED);
+	BOOST_CHECK_EQUAL( actions_set.get_action_state(action_code), ACTION_ENABLED );
+
+	BOOST_CHECK_THROW( actions_set.set_action_state(action_code + 1, ACTION_DISABLED), std::invalid_argument );
+	BOOST_CHECK_THROW( actions_set.get_action_state(actions_set_t::NO_ACTION), std::invalid_argument );
+	BOOST_CHECK( !actions_set.is_skipped(actions_set_t::NO_ACTION) );
+
+	action_state_t state;
+	BOOST_CHECK( actions_set_t::parse_action_state("aggregate", state) );
+	BOOST_CHECK_EQUAL( state, ACTION_AGGREGATE_ONLY );
+	BOOST_CHECK( !actions_set_t::parse_action_state("off", state) );
 }
 
 BOOST_AUTO_TEST_SUITE_END()
@@ -61,6 +61,197 @@ BOOST_AUTO_TEST_CASE( call_tree_add_new_link_test )
 	}
 }
 
+BOOST_AUTO_TEST_CASE( call_tree_ids_to_json_test )
+{
+	actions_set_t actions_set;
+	call_tree_t call_tree(actions_set);
+
+	{
+		rapidjson::Document doc;
+		doc.SetObject();
+		call_tree.to_json(doc, doc.GetAllocator());
+		BOOST_CHECK( !doc.HasMember("id") );
+		BOOST_CHECK( !doc.HasMember("trace_id") );
+		BOOST_CHECK( !doc.HasMember("parent_id") );
+	}
+
+	call_tree.set_id(trace_id_t(1, 2));
+	call_tree.set_trace_id(trace_id_t(3, 4));
+	call_tree.set_parent_id(trace_id_t(5, 6));
+
+	rapidjson::Document doc;
+	doc.SetObject();
+	call_tree.to_json(doc, doc.GetAllocator());
+	BOOST_CHECK_EQUAL( std::string(doc["id"].GetString()), trace_id_t(1, 2).to_string() );
+	BOOST_CHECK_EQUAL( std::string(doc["trace_id"].GetString()), trace_id_t(3, 4).to_string() );
+	BOOST_CHECK_EQUAL( std::string(doc["parent_id"].GetString()), trace_id_t(5, 6).to_string() );
+}
+
+BOOST_AUTO_TEST_CASE( call_tree_node_time_to_json_test )
+{
+	typedef call_tree_t::time_clock_t::duration ticks_t;
+	actions_set_t actions_set;
+	int action_code = actions_set.define_new_action("ACTION");
+	call_tree_t call_tree(actions_set);
+	call_tree.set_base_time(ticks_t(std::chrono::seconds(100)).count());
+
+	call_tree_t::p_node_t node = call_tree.add_new_link(call_tree.root, action_code);
+	call_tree.set_node_start_ticks(node, ticks_t(std::chrono::microseconds(5)).count());
+	call_tree.set_node_stop_ticks(node, ticks_t(std::chrono::microseconds(42)).count());
+
+	rapidjson::Document doc;
+	doc.SetObject();
+	call_tree.to_json(doc, doc.GetAllocator());
+	BOOST_CHECK_EQUAL( doc["actions"][rapidjson::SizeType(0)]["start_time"].GetInt64(), 100000005 );
+	BOOST_CHECK_EQUAL( doc["actions"][rapidjson::SizeType(0)]["stop_time"].GetInt64(), 100000042 );
+
+	// Public time getters and setters keep microseconds since epoch
+	BOOST_CHECK_EQUAL( call_tree.get_node_start_time(node), 100000005 );
+	BOOST_CHECK_EQUAL( call_tree.get_node_stop_time(node), 100000042 );
+	call_tree.set_node_stop_time(node, 100000050);
+	BOOST_CHECK_EQUAL( call_tree.get_node_stop_ticks(node), ticks_t(std::chrono::microseconds(50)).count() );
+}
+
+BOOST_AUTO_TEST_CASE( call_tree_merge_into_different_base_time_test )
+{
+	typedef call_tree_t::time_clock_t::duration ticks_t;
+	actions_set_t actions_set;
+	int action_code = actions_set.define_new_action("ACTION");
+
+	call_tree_t lhs_tree(actions_set);
+	lhs_tree.set_base_time(ticks_t(std::chrono::seconds(2)).count());
+	call_tree_t::p_node_t lhs_node = lhs_tree.add_new_link(lhs_tree.root, action_code);
+	lhs_tree.set_node_start_ticks(lhs_node, 0);
+	lhs_tree.set_node_stop_ticks(lhs_node, ticks_t(std::chrono::seconds(1)).count());
+
+	call_tree_t rhs_tree(actions_set);
+	rhs_tree.set_base_time(ticks_t(std::chrono::seconds(1)).count());
+	lhs_tree.merge_into(rhs_tree.root, rhs_tree);
+
+	call_tree_t::p_node_t rhs_node = rhs_tree.get_node_links(rhs_tree.root).begin()->second;
+	BOOST_CHECK_EQUAL( rhs_tree.get_node_start_ticks(rhs_node), ticks_t(std::chrono::seconds(1)).count() );
+	BOOST_CHECK_EQUAL( rhs_tree.get_node_stop_ticks(rhs_node), ticks_t(std::chrono::seconds(2)).count() );
+}
+
+BOOST_AUTO_TEST_CASE( call_tree_time_unit_test )
+{
+	typedef call_tree_t::time_clock_t::duration ticks_t;
+	actions_set_t actions_set;
+	int action_code = actions_set.define_new_action("ACTION");
+	call_tree_t call_tree(actions_set);
+	call_tree.set_base_time(ticks_t(std::chrono::seconds(1)).count());
+	BOOST_CHECK_EQUAL( call_tree.get_time_unit(), TIME_UNIT_MICROSECONDS );
+
+	call_tree_t::p_node_t node = call_tree.add_new_link(call_tree.root, action_code);
+	call_tree.set_node_start_ticks(node, ticks_t(std::chrono::nanoseconds(200)).count());
+	call_tree.set_node_stop_ticks(node, ticks_t(std::chrono::milliseconds(3)).count());
+
+	call_tree.set_time_unit(TIME_UNIT_NANOSECONDS);
+	{
+		rapidjson::Document doc;
+		doc.SetObject();
+		call_tree.to_json(doc, doc.GetAllocator());
+		BOOST_CHECK_EQUAL( std::string(doc["time_unit"].GetString()), "ns" );
+		BOOST_CHECK_EQUAL( doc["actions"][rapidjson::SizeType(0)]["start_time"].GetInt64(), 1000000200 );
+	}
+
+	call_tree.set_time_unit(TIME_UNIT_MILLISECONDS);
+	{
+		rapidjson::Document doc;
+		doc.SetObject();
+		call_tree.to_json(doc, doc.GetAllocator());
+		BOOST_CHECK_EQUAL( std::string(doc["time_unit"].GetString()), "ms" );
+		BOOST_CHECK_EQUAL( doc["actions"][rapidjson::SizeType(0)]["stop_time"].GetInt64(), 1003 );
+	}
+
+	// Merged tree keeps the finest unit
+	call_tree_t rhs_tree(actions_set);
+	call_tree.merge_into(rhs_tree.root, rhs_tree);
+	BOOST_CHECK_EQUAL( rhs_tree.get_time_unit(), TIME_UNIT_MICROSECONDS );
+	call_tree.set_time_unit(TIME_UNIT_NANOSECONDS);
+	call_tree.merge_into(rhs_tree.root, rhs_tree);
+	BOOST_CHECK_EQUAL( rhs_tree.get_time_unit(), TIME_UNIT_NANOSECONDS );
+}
+
+BOOST_AUTO_TEST_CASE( call_tree_max_nodes_test )
+{
+	typedef call_tree_t::time_clock_t::duration ticks_t;
+	actions_set_t actions_set;
+	int action_code = actions_set.define_new_action("ACTION");
+
+	call_tree_t lhs_tree(actions_set);
+	for (int i = 0; i < 3; ++i) {
+		call_tree_t::p_node_t node = lhs_tree.add_new_link(lhs_tree.root, action_code);
+		lhs_tree.add_new_link(node, action_code);
+		lhs_tree.set_node_start_ticks(node, 0);
+		lhs_tree.set_node_stop_ticks(node, ticks_t(std::chrono::microseconds(10)).count());
+	}
+
+	// Only the first subtree fits, the other two are accounted as dropped
+	call_tree_t rhs_tree(actions_set);
+	rhs_tree.set_base_time(lhs_tree.get_base_time());
+	rhs_tree.set_max_nodes(3);
+	BOOST_CHECK( !rhs_tree.is_full() );
+	lhs_tree.merge_into(rhs_tree.root, rhs_tree);
+	BOOST_CHECK( rhs_tree.is_full() );
+	BOOST_CHECK_EQUAL( rhs_tree.get_nodes_count(), 3 );
+	BOOST_CHECK_EQUAL( rhs_tree.get_dropped_nodes(), 4 );
+	BOOST_CHECK_EQUAL( rhs_tree.get_dropped_time(), ticks_t(std::chrono::microseconds(20)).count() );
+
+	rapidjson::Document doc;
+	doc.SetObject();
+	rhs_tree.to_json(doc, doc.GetAllocator());
+	BOOST_CHECK( doc["truncated"].GetBool() );
+	BOOST_CHECK_EQUAL( doc["dropped_nodes"].GetUint64(), 4 );
+	BOOST_CHECK_EQUAL( doc["dropped_time"].GetInt64(), 20 );
+
+	rapidjson::Document lhs_doc;
+	lhs_doc.SetObject();
+	lhs_tree.to_json(lhs_doc, lhs_doc.GetAllocator());
+	BOOST_CHECK( !lhs_doc.HasMember("truncated") );
+
+	rhs_tree.clear();
+	BOOST_CHECK( !rhs_tree.is_truncated() );
+	BOOST_CHECK_EQUAL( rhs_tree.get_max_nodes(), +call_tree_t::DEFAULT_MAX_NODES );
+}
+
+BOOST_AUTO_TEST_CASE( call_tree_memory_size_test )
+{
+	actions_set_t actions_set;
+	int action_code = actions_set.define_new_action("ACTION");
+	int stat_code = actions_set.define_new_stat("STAT");
+	const size_t initial_usage = memory_usage().get();
+
+	{
+		call_tree_t call_tree(actions_set);
+		const size_t empty_size = call_tree.get_memory_size();
+		BOOST_CHECK( empty_size >= sizeof(call_tree_t) );
+
+		for (int i = 0; i < 1000; ++i) {
+			call_tree_t::p_node_t node = call_tree.add_new_link(call_tree.root, action_code);
+			call_tree.update_node_stat(node, stat_code, STAT_VALUE, stat_value_t(std::string(100, 'x')));
+		}
+		call_tree.add_stat("key", std::string(1000, 'x'));
+		const size_t size = call_tree.get_memory_size();
+		BOOST_CHECK( size >= empty_size + 1000 * (sizeof(node_t) + 100) + 1000 );
+
+		// Process-wide account is rounded up to report step
+		BOOST_CHECK( memory_usage().get() >= initial_usage + size );
+		BOOST_CHECK( memory_usage().get() < initial_usage + size + call_tree_t::MEMORY_REPORT_STEP );
+
+		rapidjson::Document doc;
+		doc.SetObject();
+		call_tree.to_json(doc, doc.GetAllocator());
+		BOOST_CHECK_EQUAL( doc["mapped_size"].GetUint64(), size );
+
+		call_tree.clear();
+		BOOST_CHECK( call_tree.get_memory_size() < size );
+		BOOST_CHECK( call_tree.get_memory_size() >= 1000 * sizeof(node_t) );
+	}
+
+	BOOST_CHECK_EQUAL( memory_usage().get(), initial_usage );
+}
+
 BOOST_AUTO_TEST_CASE( concurrent_call_tree_inner_tree_test )
 {
 	actions_set_t actions_set;
@@ -187,17 +187,21 @@ BOOST_AUTO_TEST_CASE( call_tree_updater_stop_invalid_action_test )
 
 BOOST_AUTO_TEST_CASE( call_tree_updater_start_stop_max_depth_test )
 {
-	actions_set_t actions_set;
+	actions_set_t actions_set(true);
 	int action_code = actions_set.define_new_action("ACTION");
 	concurrent_call_tree_t call_tree(actions_set);
 	call_tree_updater_t updater(call_tree);
 
+	const uint64_t calls = metrics_registry().get_action_metrics(action_code).calls;
+
 	updater.set_max_trace_depth(0);
 	updater.start(action_code);
 	BOOST_CHECK_EQUAL( updater.get_trace_depth(), 1 );
 	BOOST_CHECK_EQUAL( updater.get_actual_trace_depth(), 0 );
 
 	updater.stop(action_code);
+	// Too deep calls are not recorded, but counted in metrics
+	BOOST_CHECK_EQUAL( metrics_registry().get_action_metrics(action_code).calls, calls + 1 );
 	BOOST_CHECK_EQUAL( updater.get_trace_depth(), 0 );
 	BOOST_CHECK_EQUAL( updater.get_actual_trace_depth(), 0 );
 
@@ -211,6 +215,80 @@ BOOST_AUTO_TEST_CASE( call_tree_updater_start_stop_max_depth_test )
 	BOOST_CHECK_EQUAL( updater.get_actual_trace_depth(), 0 );
 }
 
+BOOST_AUTO_TEST_CASE( call_tree_updater_start_stop_max_nodes_test )
+{
+	actions_set_t actions_set(true);
+	int action_code = actions_set.define_new_action("ACTION");
+	int nested_action_code = actions_set.define_new_action("NESTED_ACTION");
+	concurrent_call_tree_t call_tree(actions_set);
+	call_tree.get_call_tree().set_max_nodes(2);
+	call_tree_updater_t updater(call_tree);
+
+	const action_metrics_t metrics = metrics_registry().get_action_metrics(action_code);
+	const uint64_t nested_calls = metrics_registry().get_action_metrics(nested_action_code).calls;
+
+	updater.start(action_code);
+	for (int i = 0; i < 3; ++i) {
+		updater.start(nested_action_code);
+		updater.start(action_code);
+		BOOST_CHECK_EQUAL( updater.get_trace_depth(), 3 );
+		BOOST_CHECK_EQUAL( updater.get_actual_trace_depth(), 1 );
+		updater.stop(action_code);
+		BOOST_CHECK_THROW( updater.stop(action_code), std::logic_error );
+		BOOST_CHECK_EQUAL( updater.get_trace_depth(), 2 );
+		updater.stop(nested_action_code);
+	}
+	BOOST_CHECK_EQUAL( updater.get_current_node_action_name(), "ACTION" );
+	updater.stop(action_code);
+	BOOST_CHECK_EQUAL( updater.get_trace_depth(), 0 );
+
+	const call_tree_t &tree = call_tree.get_call_tree();
+	BOOST_CHECK_EQUAL( tree.get_nodes_count(), 2 );
+	BOOST_CHECK_EQUAL( tree.get_dropped_nodes(), 6 );
+	// Dropped calls are counted in metrics
+	BOOST_CHECK_EQUAL( metrics_registry().get_action_metrics(action_code).calls, metrics.calls + 4 );
+	BOOST_CHECK_EQUAL( metrics_registry().get_action_metrics(action_code).errors, metrics.errors + 3 );
+	BOOST_CHECK_EQUAL( metrics_registry().get_action_metrics(nested_action_code).calls, nested_calls + 3 );
+	BOOST_CHECK( tree.get_dropped_time() >= 0 );
+	BOOST_CHECK( tree.is_truncated() );
+}
+
+BOOST_AUTO_TEST_CASE( call_tree_updater_start_stop_skipped_action_test )
+{
+	actions_set_t actions_set(true);
+	int action_code = actions_set.define_new_action("ACTION");
+	int disabled_action_code = actions_set.define_new_action("DISABLED_ACTION");
+	int aggregated_action_code = actions_set.define_new_action("AGGREGATED_ACTION");
+	actions_set.set_action_state(disabled_action_code, ACTION_DISABLED);
+	actions_set.set_action_state(aggregated_action_code, ACTION_AGGREGATE_ONLY);
+	concurrent_call_tree_t call_tree(actions_set);
+	call_tree_updater_t updater(call_tree);
+
+	const uint64_t aggregated_calls = metrics_registry().get_action_metrics(aggregated_action_code).calls;
+	const uint64_t disabled_calls = metrics_registry().get_action_metrics(disabled_action_code).calls;
+
+	updater.start(action_code);
+	updater.start(disabled_action_code);
+	updater.start(aggregated_action_code);
+	updater.start(action_code);
+	BOOST_CHECK_EQUAL( updater.get_trace_depth(), 4 );
+	BOOST_CHECK_EQUAL( updater.get_actual_trace_depth(), 2 );
+	updater.stop(action_code);
+	BOOST_CHECK_THROW( updater.stop(disabled_action_code), std::logic_error );
+	updater.stop(aggregated_action_code);
+	updater.stop(disabled_action_code);
+	BOOST_CHECK_EQUAL( updater.get_current_node_action_name(), "ACTION" );
+	updater.stop(action_code);
+	BOOST_CHECK_EQUAL( updater.get_trace_depth(), 0 );
+
+	const call_tree_t &tree = call_tree.get_call_tree();
+	BOOST_CHECK_EQUAL( tree.get_nodes_count(), 3 );
+	BOOST_CHECK_EQUAL( tree.get_node_action_code(tree.get_node_links(tree.get_node_links(tree.root).begin()->second).begin()->second),
+			action_code );
+	BOOST_CHECK_EQUAL( metrics_registry().get_action_metrics(aggregated_action_code).calls, aggregated_calls + 1 );
+	BOOST_CHECK_EQUAL( metrics_registry().get_action_metrics(disabled_action_code).calls, disabled_calls );
+}
+
 BOOST_AUTO_TEST_CASE( action_guard_constructors_test )
 {
 	{
@@ -240,7 +318,7 @@ BOOST_AUTO_TEST_CASE( action_guard_stop_test )
 	{
 		action_guard_t action_guard(NULL, NO_ACTION);
 		action_guard.stop();
-		BOOST_CHECK_THROW( action_guard.stop(), std::logic_error )
+		BOOST_CHECK_THROW( action_guard.stop(), std::logic_error );
 	}
 
 	{
@@ -251,7 +329,7 @@ BOOST_AUTO_TEST_CASE( action_guard_stop_test )
 
 		action_guard_t action_guard(&updater, action_code);
 		action_guard.stop();
-		BOOST_CHECK_THROW( action_guard.stop(), std::logic_error )
+		BOOST_CHECK_THROW( action_guard.stop(), std::logic_error );
 	}
 }
 
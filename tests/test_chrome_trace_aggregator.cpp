@@ -0,0 +1,99 @@
+#include "tests.hpp"
+
+#include <sstream>
+
+#include "react/chrome_trace_aggregator.hpp"
+
+BOOST_AUTO_TEST_SUITE( chrome_trace_aggregator_suite )
+
+using namespace react;
+
+namespace {
+
+/*!
+ * \brief Collects "name" and "tid" pairs of complete events
+ */
+struct events_handler_t : public rapidjson::BaseReaderHandler<> {
+	events_handler_t(): last_string(NULL) {}
+
+	void String(const char *str, rapidjson::SizeType length, bool) {
+		const std::string value(str, length);
+		if (last_string && *last_string == "name" && value != "name") {
+			name = value;
+		}
+		strings.push_back(value);
+		last_string = &strings.back();
+	}
+
+	void Uint(unsigned value) {
+		if (last_string && *last_string == "tid" && !name.empty()) {
+			tids.push_back(std::make_pair(name, value));
+		}
+		last_string = NULL;
+	}
+
+	std::list<std::string> strings;
+	const std::string *last_string;
+	std::string name;
+	std::vector<std::pair<std::string, unsigned>> tids;
+};
+
+int64_t to_ticks(int64_t nanoseconds) {
+	return std::chrono::duration_cast<call_tree_t::time_clock_t::duration>(
+		std::chrono::nanoseconds(nanoseconds)
+	).count();
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( chrome_trace_aggregator_test )
+{
+	actions_set_t actions_set;
+	int read_action_code = actions_set.define_new_action("READ");
+	int first_action_code = actions_set.define_new_action("FIRST");
+	int second_action_code = actions_set.define_new_action("SECOND");
+	int stat_code = actions_set.define_new_stat("size");
+
+	call_tree_t call_tree(actions_set);
+	call_tree.set_base_time(0);
+	call_tree.set_id(trace_id_t(0, 1));
+	call_tree_t::p_node_t read = call_tree.add_new_link(call_tree.root, read_action_code);
+	call_tree_t::p_node_t first = call_tree.add_new_link(read, first_action_code);
+	call_tree_t::p_node_t second = call_tree.add_new_link(read, second_action_code);
+	call_tree.set_node_start_ticks(read, to_ticks(1000));
+	call_tree.set_node_stop_ticks(read, to_ticks(101500));
+	call_tree.set_node_start_ticks(first, to_ticks(10000));
+	call_tree.set_node_stop_ticks(first, to_ticks(50000));
+	// Overlaps previous sibling, like subtree merged from another thread
+	call_tree.set_node_start_ticks(second, to_ticks(30000));
+	call_tree.set_node_stop_ticks(second, to_ticks(80000));
+	call_tree.increment_node_stat(first, stat_code, 42);
+
+	std::ostringstream os;
+	{
+		chrome_trace_aggregator_t aggregator(os);
+		aggregator.aggregate(call_tree);
+		aggregator.aggregate(call_tree);
+	}
+
+	const std::string trace = os.str();
+	rapidjson::StringStream stream(trace.c_str());
+	events_handler_t handler;
+	rapidjson::Reader reader;
+	BOOST_REQUIRE( reader.Parse<0>(stream, handler) );
+
+	BOOST_CHECK( trace.find("\"traceEvents\":[") != std::string::npos );
+	BOOST_CHECK( trace.find("\"ts\":1.000,\"dur\":100.500") != std::string::npos );
+	BOOST_CHECK( trace.find("\"args\":{\"size\":42}") != std::string::npos );
+	BOOST_CHECK( trace.find("\"pid\":2") != std::string::npos );
+
+	std::vector<std::pair<std::string, unsigned>> expected;
+	expected.push_back(std::make_pair("READ", 0));
+	expected.push_back(std::make_pair("FIRST", 0));
+	expected.push_back(std::make_pair("SECOND", 1));
+	for (auto it = expected.begin(); it != expected.end(); ++it) {
+		BOOST_CHECK( std::find(handler.tids.begin(), handler.tids.end(), *it) != handler.tids.end() );
+	}
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,89 @@
+#include "tests.hpp"
+
+#include <sstream>
+
+#include "react/collapsed_stack_aggregator.hpp"
+
+BOOST_AUTO_TEST_SUITE( collapsed_stack_aggregator_suite )
+
+using namespace react;
+
+namespace {
+
+struct test_tree_t {
+	test_tree_t(): call_tree(actions_set) {
+		int read_action_code = actions_set.define_new_action("READ");
+		int load_action_code = actions_set.define_new_action("LOAD FROM DISK");
+
+		call_tree_t::p_node_t read = call_tree.add_new_link(call_tree.root, read_action_code);
+		call_tree_t::p_node_t load = call_tree.add_new_link(read, load_action_code);
+		call_tree.set_node_start_ticks(read, 0);
+		call_tree.set_node_stop_ticks(read, to_ticks(100));
+		call_tree.set_node_start_ticks(load, to_ticks(10));
+		call_tree.set_node_stop_ticks(load, to_ticks(70));
+	}
+
+	static int64_t to_ticks(int64_t microseconds) {
+		return call_tree_t::time_clock_t::duration(std::chrono::microseconds(microseconds)).count();
+	}
+
+	actions_set_t actions_set;
+	call_tree_t call_tree;
+};
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( collapsed_stack_aggregator_self_time_test )
+{
+	test_tree_t tree;
+	std::ostringstream os;
+	collapsed_stack_aggregator_t aggregator(tree.actions_set, os);
+
+	for (int i = 0; i < 3; ++i) {
+		aggregator.aggregate(tree.call_tree);
+	}
+	aggregator.flush();
+	BOOST_CHECK_EQUAL( os.str(), "ROOT;READ 120\nROOT;READ;LOAD FROM DISK 180\n" );
+	BOOST_CHECK_EQUAL( aggregator.get_paths_count(), 2 );
+
+	// Weights are reset by flush
+	os.str("");
+	aggregator.flush();
+	BOOST_CHECK_EQUAL( os.str(), "" );
+}
+
+BOOST_AUTO_TEST_CASE( collapsed_stack_aggregator_total_time_test )
+{
+	test_tree_t tree;
+	std::ostringstream os;
+	{
+		collapsed_stack_aggregator_t aggregator(tree.actions_set, os, STACK_WEIGHT_TOTAL_TIME, "");
+		aggregator.aggregate(tree.call_tree);
+	}
+
+	// Destructor writes stacks that were not flushed
+	BOOST_CHECK_EQUAL( os.str(), "READ 100\nREAD;LOAD FROM DISK 60\n" );
+}
+
+BOOST_AUTO_TEST_CASE( collapsed_stack_aggregator_short_actions_test )
+{
+	actions_set_t actions_set;
+	int action_code = actions_set.define_new_action("HASH PROBE");
+	call_tree_t call_tree(actions_set);
+	call_tree_t::p_node_t probe = call_tree.add_new_link(call_tree.root, action_code);
+	call_tree.set_node_start_ticks(probe, 0);
+	call_tree.set_node_stop_ticks(probe,
+		call_tree_t::time_clock_t::duration(std::chrono::nanoseconds(400)).count());
+
+	std::ostringstream os;
+	collapsed_stack_aggregator_t aggregator(actions_set, os);
+	for (int i = 0; i < 3; ++i) {
+		aggregator.aggregate(call_tree);
+		aggregator.flush();
+	}
+
+	// 1.2us are accumulated over flushes, 0.2us remain
+	BOOST_CHECK_EQUAL( os.str(), "ROOT;HASH PROBE 1\n" );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,80 @@
+#include "tests.hpp"
+
+#include "react/columnar_call_tree.hpp"
+#include "react/summary_aggregator.hpp"
+
+BOOST_AUTO_TEST_SUITE( columnar_call_tree_suite )
+
+using namespace react;
+
+BOOST_AUTO_TEST_CASE( columnar_call_tree_assign_test )
+{
+	actions_set_t actions_set;
+	int first_action_code = actions_set.define_new_action("FIRST");
+	int second_action_code = actions_set.define_new_action("SECOND");
+
+	call_tree_t call_tree(actions_set);
+	call_tree_t::p_node_t first = call_tree.add_new_link(call_tree.root, first_action_code);
+	call_tree_t::p_node_t second = call_tree.add_new_link(first, second_action_code);
+	call_tree_t::p_node_t third = call_tree.add_new_link(call_tree.root, second_action_code);
+	call_tree.set_node_start_ticks(first, 1);
+	call_tree.set_node_stop_ticks(first, 10);
+	call_tree.set_node_start_ticks(second, 2);
+	call_tree.set_node_stop_ticks(second, 5);
+	call_tree.set_node_start_ticks(third, 11);
+	call_tree.set_node_stop_ticks(third, 20);
+
+	columnar_call_tree_t columnar_tree(call_tree);
+	BOOST_REQUIRE_EQUAL( columnar_tree.size(), 3 );
+	BOOST_CHECK_EQUAL( columnar_tree.get_base_time(), call_tree.get_base_time() );
+
+	BOOST_CHECK_EQUAL( columnar_tree.get_action_codes()[0], first_action_code );
+	BOOST_CHECK_EQUAL( columnar_tree.get_action_codes()[1], second_action_code );
+	BOOST_CHECK_EQUAL( columnar_tree.get_parents()[0], +columnar_call_tree_t::NO_PARENT );
+	BOOST_CHECK_EQUAL( columnar_tree.get_parents()[1], 0 );
+	BOOST_CHECK_EQUAL( columnar_tree.get_parents()[2], +columnar_call_tree_t::NO_PARENT );
+	BOOST_CHECK_EQUAL( columnar_tree.get_start_times()[1], 2 );
+	BOOST_CHECK_EQUAL( columnar_tree.get_stop_times()[2], 20 );
+
+	std::vector<action_summary_t> summaries;
+	summarize_actions(columnar_tree, summaries);
+	BOOST_REQUIRE_EQUAL( summaries.size(), second_action_code + 1 );
+	BOOST_CHECK_EQUAL( summaries[first_action_code].calls, 1 );
+	BOOST_CHECK_EQUAL( summaries[first_action_code].total_time, 9 );
+	BOOST_CHECK_EQUAL( summaries[second_action_code].calls, 2 );
+	BOOST_CHECK_EQUAL( summaries[second_action_code].total_time, 12 );
+	BOOST_CHECK_EQUAL( summaries[second_action_code].min_time, 3 );
+	BOOST_CHECK_EQUAL( summaries[second_action_code].max_time, 9 );
+
+	// Storage is reused for smaller tree
+	call_tree_t empty_tree(actions_set);
+	columnar_tree.assign(empty_tree);
+	BOOST_CHECK_EQUAL( columnar_tree.size(), 0 );
+}
+
+BOOST_AUTO_TEST_CASE( summary_aggregator_test )
+{
+	actions_set_t actions_set;
+	int action_code = actions_set.define_new_action("ACTION");
+
+	call_tree_t call_tree(actions_set);
+	call_tree_t::p_node_t node = call_tree.add_new_link(call_tree.root, action_code);
+	call_tree.set_node_stop_ticks(node, call_tree_t::time_clock_t::duration(std::chrono::microseconds(7)).count());
+
+	summary_aggregator_t aggregator(actions_set);
+	aggregator.aggregate(call_tree);
+	aggregator.aggregate(call_tree);
+	BOOST_CHECK_EQUAL( aggregator.get_trees_count(), 2 );
+	BOOST_CHECK_EQUAL( aggregator.get_summaries()[action_code].calls, 2 );
+
+	rapidjson::Document doc;
+	doc.SetObject();
+	aggregator.to_json(doc, doc.GetAllocator());
+	const rapidjson::Value &action = doc["actions"][rapidjson::SizeType(0)];
+	BOOST_CHECK_EQUAL( std::string(action["name"].GetString()), "ACTION" );
+	BOOST_CHECK_EQUAL( action["calls"].GetUint64(), 2 );
+	BOOST_CHECK_EQUAL( action["total_time"].GetInt64(), 14 );
+	BOOST_CHECK_EQUAL( action["max_time"].GetInt64(), 7 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
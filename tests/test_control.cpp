@@ -0,0 +1,253 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <thread>
+
+#include <signal.h>
+#include <unistd.h>
+
+#include "tests.hpp"
+
+#include "react/react.hpp"
+#include "react/control.hpp"
+
+BOOST_AUTO_TEST_SUITE( control_suite )
+
+using namespace react;
+
+BOOST_AUTO_TEST_CASE( control_block_parse_test )
+{
+	uint64_t word = 0;
+	BOOST_CHECK( control_block_t::parse("off", word) );
+	BOOST_CHECK_EQUAL( control_block_t::get_mode(word), RECORD_MODE_OFF );
+	BOOST_CHECK( !control_block_t::should_record(word, 0) );
+
+	BOOST_CHECK( control_block_t::parse(" full\n", word) );
+	BOOST_CHECK_EQUAL( control_block_t::get_mode(word), RECORD_MODE_FULL );
+	BOOST_CHECK( control_block_t::should_record(word, 0xffffffff) );
+	BOOST_CHECK_EQUAL( word, control_block_t().load() );
+
+	BOOST_CHECK( control_block_t::parse("sampled:0.25", word) );
+	BOOST_CHECK_EQUAL( control_block_t::get_mode(word), RECORD_MODE_SAMPLED );
+	BOOST_CHECK_CLOSE( control_block_t::get_rate(word), 0.25, 1e-6 );
+	BOOST_CHECK( control_block_t::should_record(word, 0x3fffffff) );
+	BOOST_CHECK( !control_block_t::should_record(word, 0x40000000) );
+
+	BOOST_CHECK( !control_block_t::parse("", word) );
+	BOOST_CHECK( !control_block_t::parse("sampled:", word) );
+	BOOST_CHECK( !control_block_t::parse("sampled:2", word) );
+	BOOST_CHECK( !control_block_t::parse("sampled:0.5x", word) );
+	BOOST_CHECK( !control_block_t::parse("on", word) );
+}
+
+BOOST_AUTO_TEST_CASE( react_record_mode_test )
+{
+	BOOST_CHECK_EQUAL( react_get_record_mode(), REACT_RECORD_MODE_FULL );
+
+	BOOST_CHECK_EQUAL( react_set_record_mode(REACT_RECORD_MODE_OFF, 0), 0 );
+	BOOST_CHECK_EQUAL( react_activate(NULL), 0 );
+	BOOST_CHECK( !react_is_active() );
+	BOOST_CHECK_EQUAL( react_deactivate(), 0 );
+
+	BOOST_CHECK_EQUAL( react_set_record_mode(REACT_RECORD_MODE_SAMPLED, 0.5), 0 );
+	BOOST_CHECK_CLOSE( react_get_sample_rate(), 0.5, 1e-6 );
+	int recorded = 0;
+	for (int i = 0; i < 1000; ++i) {
+		react_activate(NULL);
+		recorded += react_is_active();
+		react_deactivate();
+	}
+	BOOST_CHECK( recorded > 350 && recorded < 650 );
+
+	BOOST_CHECK_EQUAL( react_set_record_mode(REACT_RECORD_MODE_SAMPLED, 2), -EINVAL );
+	BOOST_CHECK_EQUAL( react_set_record_mode(static_cast<react_record_mode_t>(42), 1), -EINVAL );
+	BOOST_CHECK_EQUAL( react_set_record_mode_from_string("sampled:x"), -EINVAL );
+	BOOST_CHECK_EQUAL( react_set_record_mode_from_string(NULL), -EINVAL );
+
+	BOOST_CHECK_EQUAL( react_set_record_mode_from_string("full"), 0 );
+	react_activate(NULL);
+	BOOST_CHECK( react_is_active() );
+	react_deactivate();
+}
+
+BOOST_AUTO_TEST_CASE( react_signal_record_mode_test )
+{
+	BOOST_CHECK_EQUAL( react_set_signal_record_mode(SIGUSR1, REACT_RECORD_MODE_OFF, 0), 0 );
+	BOOST_CHECK_EQUAL( react_set_signal_record_mode(SIGUSR2, REACT_RECORD_MODE_FULL, 1), 0 );
+	BOOST_CHECK_EQUAL( react_set_signal_record_mode(0, REACT_RECORD_MODE_FULL, 1), -EINVAL );
+
+	raise(SIGUSR1);
+	BOOST_CHECK_EQUAL( react_get_record_mode(), REACT_RECORD_MODE_OFF );
+	raise(SIGUSR2);
+	BOOST_CHECK_EQUAL( react_get_record_mode(), REACT_RECORD_MODE_FULL );
+
+	signal(SIGUSR1, SIG_DFL);
+	signal(SIGUSR2, SIG_DFL);
+}
+
+static bool wait_for_record_mode(react_record_mode_t mode) {
+	for (int i = 0; i < 500 && react_get_record_mode() != mode; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return react_get_record_mode() == mode;
+}
+
+BOOST_AUTO_TEST_CASE( react_watch_control_file_test )
+{
+	std::ostringstream path;
+	path << "/tmp/react-control-test-" << getpid();
+
+	std::ofstream(path.str().c_str()) << "sampled:0.1\n";
+	BOOST_CHECK_EQUAL( react_watch_control_file(path.str().c_str(), 10), 0 );
+	BOOST_CHECK( wait_for_record_mode(REACT_RECORD_MODE_SAMPLED) );
+	BOOST_CHECK_CLOSE( react_get_sample_rate(), 0.1, 1e-6 );
+
+	std::ofstream(path.str().c_str()) << "full, but with size changed\n";
+	std::this_thread::sleep_for(std::chrono::milliseconds(50));
+	BOOST_CHECK_EQUAL( react_get_record_mode(), REACT_RECORD_MODE_SAMPLED );
+
+	const int action_code = react_define_new_action("CONTROL_FILE_ACTION");
+	std::ofstream(path.str().c_str()) << "full\naction:CONTROL_FILE_ACTION=disabled\n";
+	BOOST_CHECK( wait_for_record_mode(REACT_RECORD_MODE_FULL) );
+	react_action_state_t state = REACT_ACTION_ENABLED;
+	for (int i = 0; i < 500 && state != REACT_ACTION_DISABLED; ++i) {
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		BOOST_CHECK_EQUAL( react_get_action_state(action_code, &state), 0 );
+	}
+	BOOST_CHECK_EQUAL( state, REACT_ACTION_DISABLED );
+	BOOST_CHECK_EQUAL( react_set_action_state(action_code, REACT_ACTION_ENABLED), 0 );
+
+	BOOST_CHECK_EQUAL( react_unwatch_control_file(), 0 );
+	BOOST_CHECK_EQUAL( react_watch_control_file(NULL, 10), -EINVAL );
+	std::remove(path.str().c_str());
+}
+
+BOOST_AUTO_TEST_CASE( react_action_state_test )
+{
+	const int action_code = react_define_new_action("STATE_ACTION");
+	react_action_state_t state;
+
+	BOOST_CHECK_EQUAL( react_set_action_state_from_string("STATE_ACTION=aggregate"), 0 );
+	BOOST_CHECK_EQUAL( react_get_action_state(action_code, &state), 0 );
+	BOOST_CHECK_EQUAL( state, REACT_ACTION_AGGREGATE_ONLY );
+
+	react_action_metrics_t metrics, previous_metrics;
+	BOOST_CHECK_EQUAL( react_get_action_metrics(action_code, &previous_metrics), 0 );
+	react_activate(NULL);
+	react_start_action(action_code);
+	BOOST_CHECK_EQUAL( react_set_action_state(action_code, REACT_ACTION_ENABLED), 0 );
+	BOOST_CHECK_EQUAL( react_stop_action(action_code), 0 );
+	react_deactivate();
+
+	BOOST_CHECK_EQUAL( react_get_action_metrics(action_code, &metrics), 0 );
+	BOOST_CHECK_EQUAL( metrics.calls, previous_metrics.calls + 1 );
+
+	BOOST_CHECK_EQUAL( react_set_action_state_from_string("STATE_ACTION=off"), -EINVAL );
+	BOOST_CHECK_EQUAL( react_set_action_state_from_string("UNKNOWN_ACTION=disabled"), -EINVAL );
+	BOOST_CHECK_EQUAL( react_set_action_state_from_string(NULL), -EINVAL );
+	BOOST_CHECK_EQUAL( react_set_action_state(-1, REACT_ACTION_DISABLED), -EINVAL );
+	BOOST_CHECK_EQUAL( react_get_action_state(action_code, NULL), -EINVAL );
+}
+
+BOOST_AUTO_TEST_CASE( react_aggregator_override_test )
+{
+	std::ostringstream output, override_output;
+	stream_aggregator_t aggregator(output), override_aggregator(override_output);
+
+	BOOST_CHECK_EQUAL( react_set_aggregator_override(&override_aggregator), 0 );
+	react_activate(&aggregator);
+	react_deactivate();
+	BOOST_CHECK_EQUAL( react_set_aggregator_override(NULL), 0 );
+	react_activate(&aggregator);
+	react_deactivate();
+
+	const std::string trees = output.str(), override_trees = override_output.str();
+	BOOST_CHECK( !override_trees.empty() );
+	BOOST_CHECK( !trees.empty() );
+	BOOST_CHECK_EQUAL( std::count(override_trees.begin(), override_trees.end(), '\n'),
+			std::count(trees.begin(), trees.end(), '\n') );
+}
+
+BOOST_AUTO_TEST_CASE( react_context_handle_record_mode_test )
+{
+	int action_code = react_define_new_action("ACTION");
+	std::ostringstream output, override_output;
+	stream_aggregator_t aggregator(output), override_aggregator(override_output);
+	react_trace_id_t id;
+
+	BOOST_CHECK_EQUAL( react_set_record_mode(REACT_RECORD_MODE_OFF, 0), 0 );
+	void *context = react_context_create(&aggregator);
+	BOOST_REQUIRE( context != NULL );
+	BOOST_CHECK_EQUAL( react_context_start_action(context, action_code), 0 );
+	BOOST_CHECK_EQUAL( react_context_add_stat_int(context, "key", 1), 0 );
+	BOOST_CHECK_EQUAL( react_context_stop_action(context, action_code), 0 );
+	BOOST_CHECK_EQUAL( react_context_get_id(context, &id), 0 );
+	BOOST_CHECK( id.high == 0 && id.low == 0 );
+	BOOST_CHECK_EQUAL( react_context_finish(context), 0 );
+	BOOST_CHECK( output.str().empty() );
+
+	BOOST_CHECK_EQUAL( react_set_record_mode(REACT_RECORD_MODE_SAMPLED, 0.5), 0 );
+	int recorded = 0;
+	for (int i = 0; i < 1000; ++i) {
+		context = react_context_create(&aggregator);
+		react_context_get_id(context, &id);
+		recorded += (id.high != 0 || id.low != 0);
+		react_context_finish(context);
+	}
+	BOOST_CHECK( recorded > 350 && recorded < 650 );
+
+	BOOST_CHECK_EQUAL( react_set_record_mode(REACT_RECORD_MODE_FULL, 0), 0 );
+	output.str(std::string());
+	BOOST_CHECK_EQUAL( react_set_aggregator_override(&override_aggregator), 0 );
+	context = react_context_create(&aggregator);
+	BOOST_CHECK_EQUAL( react_context_finish(context), 0 );
+	BOOST_CHECK_EQUAL( react_set_aggregator_override(NULL), 0 );
+	BOOST_CHECK( output.str().empty() );
+	BOOST_CHECK( !override_output.str().empty() );
+}
+
+BOOST_AUTO_TEST_CASE( react_subthread_aggregator_override_test )
+{
+	const size_t WORKER_ACTIVATIONS = 20;
+	int action_code = react_define_new_action("ACTION");
+	std::ostringstream override_output;
+	stream_aggregator_t override_aggregator(override_output);
+
+	BOOST_CHECK_EQUAL( react_set_aggregator_override(&override_aggregator), 0 );
+	BOOST_CHECK_EQUAL( react_set_record_mode(REACT_RECORD_MODE_SAMPLED, 0.5), 0 );
+	react_activate(NULL);
+	while (!react_is_active()) {
+		react_deactivate();
+		react_activate(NULL);
+	}
+	react_start_action(action_code);
+
+	std::shared_ptr<aggregator_t> subthread_aggregator = create_subthread_aggregator();
+	size_t worker_recorded = 0;
+	std::thread worker([&] () {
+		for (size_t i = 0; i < WORKER_ACTIVATIONS; ++i) {
+			react_activate(subthread_aggregator.get());
+			worker_recorded += react_is_active();
+			react_start_action(action_code);
+			react_stop_action(action_code);
+			react_deactivate();
+		}
+	});
+	worker.join();
+
+	react_stop_action(action_code);
+	react_deactivate();
+	BOOST_CHECK_EQUAL( react_set_record_mode(REACT_RECORD_MODE_FULL, 0), 0 );
+	BOOST_CHECK_EQUAL( react_set_aggregator_override(NULL), 0 );
+
+	// Worker trees are merged into parent's tree instead of going to override aggregator
+	const std::string override_trees = override_output.str();
+	BOOST_CHECK_EQUAL( worker_recorded, WORKER_ACTIVATIONS );
+	const std::string tree_key = "\"mapped_size\"";
+	BOOST_CHECK( override_trees.find(tree_key) != std::string::npos );
+	BOOST_CHECK_EQUAL( override_trees.find(tree_key), override_trees.rfind(tree_key) );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,133 @@
+#include "tests.hpp"
+
+#include "react/coroutine.hpp"
+
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <sstream>
+#include <thread>
+
+BOOST_AUTO_TEST_SUITE( coroutine_suite )
+
+using namespace react;
+
+template<bool RecordSuspendedTime>
+struct task_t {
+	struct promise_type : coroutine_promise_mixin<RecordSuspendedTime> {
+		task_t get_return_object() {
+			return task_t(std::coroutine_handle<promise_type>::from_promise(*this));
+		}
+		auto initial_suspend() {
+			return this->react_initial_suspend(std::suspend_always());
+		}
+		auto final_suspend() noexcept {
+			return this->react_final_suspend(std::suspend_always());
+		}
+		void return_void() {}
+		void unhandled_exception() {
+			throw;
+		}
+	};
+
+	explicit task_t(std::coroutine_handle<promise_type> handle): handle(handle) {}
+
+	task_t(task_t &&other): handle(other.handle) {
+		other.handle = nullptr;
+	}
+
+	~task_t() {
+		if (handle) {
+			handle.destroy();
+		}
+	}
+
+	std::coroutine_handle<promise_type> handle;
+};
+
+/*!
+ * \brief Awaiter that leaves coroutine suspended until test resumes it
+ */
+struct suspend_point_t {
+	bool await_ready() {
+		return false;
+	}
+
+	void await_suspend(std::coroutine_handle<> handle) {
+		suspended = handle;
+	}
+
+	void await_resume() {}
+
+	std::coroutine_handle<> suspended;
+};
+
+template<bool RecordSuspendedTime>
+task_t<RecordSuspendedTime> request(react::aggregator_t *aggregator, suspend_point_t &suspend_point) {
+	int action_code = react_define_new_action("COROUTINE_ACTION");
+	react_activate(aggregator);
+	react_start_action(action_code);
+	co_await suspend_point;
+	react_stop_action(action_code);
+	react_deactivate();
+}
+
+BOOST_AUTO_TEST_CASE( coroutine_resume_on_another_thread_test )
+{
+	std::ostringstream output;
+	stream_aggregator_t aggregator(output);
+	suspend_point_t suspend_point;
+
+	task_t<false> task = request<false>(&aggregator, suspend_point);
+	task.handle.resume();
+
+	// Context of suspended coroutine is not left on the thread
+	BOOST_CHECK( !react_is_active() );
+	BOOST_REQUIRE( suspend_point.suspended );
+
+	std::thread worker([&suspend_point] () {
+		suspend_point.suspended.resume();
+		BOOST_CHECK( !react_is_active() );
+	});
+	worker.join();
+
+	BOOST_CHECK( task.handle.done() );
+	BOOST_CHECK( output.str().find("COROUTINE_ACTION") != std::string::npos );
+	BOOST_CHECK( output.str().find("suspended_time") == std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( coroutine_suspended_time_test )
+{
+	std::ostringstream output;
+	stream_aggregator_t aggregator(output);
+	suspend_point_t suspend_point;
+
+	task_t<true> task = request<true>(&aggregator, suspend_point);
+	task.handle.resume();
+	suspend_point.suspended.resume();
+
+	BOOST_CHECK( task.handle.done() );
+	BOOST_CHECK( output.str().find("suspended_time") != std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( coroutine_restores_thread_context_test )
+{
+	int action_code = react_define_new_action("ACTION");
+	suspend_point_t suspend_point;
+
+	task_t<false> task = request<false>(NULL, suspend_point);
+	task.handle.resume();
+	BOOST_CHECK( !react_is_active() );
+
+	// Coroutine is resumed by thread with its own context
+	react_activate(NULL);
+	react_start_action(action_code);
+	suspend_point.suspended.resume();
+	BOOST_CHECK( task.handle.done() );
+	BOOST_CHECK( react_is_active() );
+	BOOST_CHECK_EQUAL( react_stop_action(action_code), 0 );
+	react_deactivate();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif
@@ -0,0 +1,205 @@
+#include "tests.hpp"
+
+#include <fstream>
+#include <cstdlib>
+#include <cstdio>
+
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "react/file_aggregator.hpp"
+
+BOOST_AUTO_TEST_SUITE( file_aggregator_suite )
+
+using namespace react;
+
+struct temp_dir {
+	temp_dir() {
+		char path_template[] = "/tmp/react-tests-XXXXXX";
+		path = mkdtemp(path_template);
+	}
+
+	~temp_dir() {
+		std::vector<std::string> entries = list();
+		for (auto it = entries.begin(); it != entries.end(); ++it) {
+			unlink((path + "/" + *it).c_str());
+		}
+		rmdir(path.c_str());
+	}
+
+	std::vector<std::string> list() const {
+		std::vector<std::string> entries;
+		DIR *dir = opendir(path.c_str());
+		while (dirent *entry = readdir(dir)) {
+			std::string name = entry->d_name;
+			if (name != "." && name != "..") {
+				entries.push_back(name);
+			}
+		}
+		closedir(dir);
+		return entries;
+	}
+
+	std::string path;
+};
+
+std::vector<std::string> read_lines(const std::string &path) {
+	std::vector<std::string> lines;
+	std::ifstream input(path.c_str());
+	std::string line;
+	while (std::getline(input, line)) {
+		lines.push_back(line);
+	}
+	return lines;
+}
+
+BOOST_AUTO_TEST_CASE( file_aggregator_write_test )
+{
+	temp_dir dir;
+	file_aggregator_config_t config;
+	config.path = dir.path + "/react.json";
+
+	actions_set_t actions_set;
+	int action_code = actions_set.define_new_action("ACTION");
+	call_tree_t call_tree(actions_set);
+	call_tree.add_new_link(call_tree.root, action_code);
+
+	{
+		file_aggregator_t aggregator(config);
+		for (int i = 0; i < 10; ++i) {
+			aggregator.aggregate(call_tree);
+		}
+		aggregator.flush();
+
+		std::vector<std::string> lines = read_lines(config.path);
+		BOOST_REQUIRE_EQUAL( lines.size(), 10 );
+		for (auto it = lines.begin(); it != lines.end(); ++it) {
+			rapidjson::StringStream stream(it->c_str());
+			rapidjson::BaseReaderHandler<> handler;
+			rapidjson::Reader reader;
+			BOOST_CHECK( reader.Parse<0>(stream, handler) );
+			BOOST_CHECK( it->find("\"actions\"") != std::string::npos );
+		}
+
+		aggregator.aggregate(call_tree);
+	}
+
+	// Destructor writes buffered trees
+	BOOST_CHECK_EQUAL( read_lines(config.path).size(), 11 );
+}
+
+BOOST_AUTO_TEST_CASE( file_aggregator_rotation_test )
+{
+	temp_dir dir;
+	file_aggregator_config_t config;
+	config.path = dir.path + "/react.json";
+	config.batch_size = 1;
+	config.max_file_size = 1;
+
+	actions_set_t actions_set;
+	call_tree_t call_tree(actions_set);
+
+	file_aggregator_t aggregator(config);
+	for (int i = 0; i < 3; ++i) {
+		aggregator.aggregate(call_tree);
+		aggregator.flush();
+	}
+
+	BOOST_CHECK_EQUAL( dir.list().size(), 3 );
+	BOOST_CHECK_EQUAL( read_lines(config.path).size(), 1 );
+}
+
+BOOST_AUTO_TEST_CASE( file_aggregator_reopen_after_failed_rotation_test )
+{
+	temp_dir dir;
+	std::string subdir = dir.path + "/logs";
+	std::string moved_subdir = dir.path + "/moved";
+	BOOST_REQUIRE_EQUAL( mkdir(subdir.c_str(), 0755), 0 );
+
+	file_aggregator_config_t config;
+	config.path = subdir + "/react.json";
+	config.batch_size = 1;
+	config.max_file_size = 1;
+
+	actions_set_t actions_set;
+	call_tree_t call_tree(actions_set);
+
+	{
+		file_aggregator_t aggregator(config);
+		aggregator.aggregate(call_tree);
+		aggregator.flush();
+
+		// Rotation can't reopen file while its directory is missing
+		BOOST_REQUIRE_EQUAL( rename(subdir.c_str(), moved_subdir.c_str()), 0 );
+		for (int i = 0; i < 2; ++i) {
+			aggregator.aggregate(call_tree);
+			aggregator.flush();
+		}
+		BOOST_CHECK_EQUAL( aggregator.get_dropped_trees_count(), 2 );
+
+		BOOST_REQUIRE_EQUAL( mkdir(subdir.c_str(), 0755), 0 );
+		aggregator.aggregate(call_tree);
+		aggregator.flush();
+		BOOST_CHECK_EQUAL( aggregator.get_dropped_trees_count(), 2 );
+		BOOST_CHECK_EQUAL( read_lines(config.path).size(), 1 );
+	}
+
+	unlink(config.path.c_str());
+	unlink((moved_subdir + "/react.json").c_str());
+	rmdir(subdir.c_str());
+	rmdir(moved_subdir.c_str());
+}
+
+BOOST_AUTO_TEST_CASE( file_aggregator_overflow_test )
+{
+	temp_dir dir;
+	file_aggregator_config_t config;
+	config.path = dir.path + "/react.json";
+	config.max_pending_size = 0;
+
+	actions_set_t actions_set;
+	call_tree_t call_tree(actions_set);
+
+	file_aggregator_t aggregator(config);
+	aggregator.aggregate(call_tree);
+	aggregator.flush();
+
+	BOOST_CHECK_EQUAL( aggregator.get_dropped_trees_count(), 1 );
+	BOOST_CHECK( read_lines(config.path).empty() );
+}
+
+#ifdef REACT_HAVE_ZLIB
+BOOST_AUTO_TEST_CASE( file_aggregator_gzip_test )
+{
+	temp_dir dir;
+	file_aggregator_config_t config;
+	config.path = dir.path + "/react.json.gz";
+	config.compression = FILE_COMPRESSION_GZIP;
+
+	actions_set_t actions_set;
+	call_tree_t call_tree(actions_set);
+
+	{
+		file_aggregator_t aggregator(config);
+		aggregator.aggregate(call_tree);
+	}
+
+	std::ifstream input(config.path.c_str(), std::ios::binary);
+	unsigned char magic[2] = {0, 0};
+	input.read(reinterpret_cast<char *>(magic), sizeof(magic));
+	BOOST_CHECK_EQUAL( magic[0], 0x1f );
+	BOOST_CHECK_EQUAL( magic[1], 0x8b );
+}
+#endif
+
+BOOST_AUTO_TEST_CASE( file_aggregator_invalid_path_test )
+{
+	file_aggregator_config_t config;
+	BOOST_CHECK_THROW( file_aggregator_t aggregator(config), std::invalid_argument );
+
+	config.path = "/nonexistent/react.json";
+	BOOST_CHECK_THROW( file_aggregator_t aggregator(config), std::runtime_error );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
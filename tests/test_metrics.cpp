@@ -0,0 +1,210 @@
+#include "tests.hpp"
+
+#include <thread>
+
+#include "react/react.hpp"
+#include "react/metrics.hpp"
+
+BOOST_AUTO_TEST_SUITE( metrics_suite )
+
+using namespace react;
+
+BOOST_AUTO_TEST_CASE( metrics_shard_test )
+{
+	metrics_shard_t shard;
+	shard.add_call(1, 10);
+	shard.add_call(1, 20);
+	shard.add_call(metrics_shard_t::CHUNK_SIZE + 1, 5);
+	shard.add_error(2);
+	shard.add_call(-1, 5);
+	shard.add_call(metrics_shard_t::CHUNK_SIZE * metrics_shard_t::MAX_CHUNKS, 5);
+
+	std::vector<action_metrics_t> totals(1);
+	totals[0].calls = 1;
+	shard.fold_into(totals);
+	BOOST_REQUIRE_EQUAL( totals.size(), metrics_shard_t::CHUNK_SIZE + 2 );
+	BOOST_CHECK_EQUAL( totals[0].calls, 1 );
+	BOOST_CHECK_EQUAL( totals[1].calls, 2 );
+	BOOST_CHECK_EQUAL( totals[1].total_time, 30 );
+	BOOST_CHECK_EQUAL( totals[2].errors, 1 );
+	BOOST_CHECK_EQUAL( totals[2].calls, 0 );
+	BOOST_CHECK_EQUAL( totals[metrics_shard_t::CHUNK_SIZE + 1].total_time, 5 );
+}
+
+BOOST_AUTO_TEST_CASE( metrics_shard_started_calls_test )
+{
+	metrics_shard_t shard;
+	shard.stop_call(1);
+	shard.start_call(1, true);
+	shard.start_call(2, false);
+	BOOST_CHECK_THROW( shard.stop_call(1), std::logic_error );
+	shard.stop_call(2);
+	shard.stop_call(1);
+
+	for (size_t i = 0; i <= metrics_shard_t::MAX_STARTED_CALLS; ++i) {
+		shard.start_call(3, true);
+	}
+	for (size_t i = 0; i <= metrics_shard_t::MAX_STARTED_CALLS; ++i) {
+		shard.stop_call(3);
+	}
+
+	std::vector<action_metrics_t> totals;
+	shard.fold_into(totals);
+	BOOST_REQUIRE_EQUAL( totals.size(), 4 );
+	BOOST_CHECK_EQUAL( totals[1].calls, 1 );
+	BOOST_CHECK_EQUAL( totals[1].errors, 1 );
+	BOOST_CHECK_EQUAL( totals[2].calls, 0 );
+	BOOST_CHECK_EQUAL( totals[3].calls, +metrics_shard_t::MAX_STARTED_CALLS );
+}
+
+BOOST_AUTO_TEST_CASE( metrics_registry_threads_test )
+{
+	actions_set_t actions_set(true);
+	int action_code = actions_set.define_new_action("ACTION");
+	const action_metrics_t initial = metrics_registry().get_action_metrics(action_code);
+
+	const size_t THREADS_COUNT = 4;
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < THREADS_COUNT; ++i) {
+		threads.push_back(std::thread([&actions_set, action_code] () {
+			concurrent_call_tree_t call_tree(actions_set);
+			call_tree_updater_t updater(call_tree);
+			for (int j = 0; j < 100; ++j) {
+				updater.start(action_code);
+				updater.stop(action_code);
+			}
+		}));
+	}
+	for (auto it = threads.begin(); it != threads.end(); ++it) {
+		it->join();
+	}
+
+	// Counters of exited threads are kept
+	const action_metrics_t metrics = metrics_registry().get_action_metrics(action_code);
+	BOOST_CHECK_EQUAL( metrics.calls, initial.calls + THREADS_COUNT * 100 );
+	BOOST_CHECK( metrics.total_time >= initial.total_time );
+	BOOST_CHECK_EQUAL( metrics.errors, initial.errors );
+}
+
+BOOST_AUTO_TEST_CASE( metrics_private_actions_set_test )
+{
+	// Codes of private actions set don't clash with codes of react's global set in metrics
+	actions_set_t actions_set;
+	int action_code = actions_set.define_new_action("ACTION");
+	const action_metrics_t initial = metrics_registry().get_action_metrics(action_code);
+
+	concurrent_call_tree_t call_tree(actions_set);
+	call_tree_updater_t updater(call_tree);
+	updater.start(action_code);
+	updater.stop(action_code);
+	BOOST_CHECK_THROW( updater.stop(action_code), std::logic_error );
+
+	const action_metrics_t metrics = metrics_registry().get_action_metrics(action_code);
+	BOOST_CHECK_EQUAL( metrics.calls, initial.calls );
+	BOOST_CHECK_EQUAL( metrics.errors, initial.errors );
+}
+
+BOOST_AUTO_TEST_CASE( react_action_metrics_test )
+{
+	int action_code = react_define_new_action("METRICS_ACTION");
+	react_action_metrics_t initial;
+	BOOST_REQUIRE_EQUAL( react_get_action_metrics(action_code, &initial), 0 );
+
+	react_activate(NULL);
+	react_start_action(action_code);
+	react_stop_action(action_code);
+	react_deactivate();
+	BOOST_CHECK_EQUAL( react_add_action_error(action_code), 0 );
+
+	react_action_metrics_t metrics;
+	BOOST_REQUIRE_EQUAL( react_get_action_metrics(action_code, &metrics), 0 );
+	BOOST_CHECK_EQUAL( metrics.calls, initial.calls + 1 );
+	BOOST_CHECK_EQUAL( metrics.errors, initial.errors + 1 );
+
+	BOOST_CHECK_EQUAL( react_get_action_metrics(-1, &metrics), -EINVAL );
+	BOOST_CHECK_EQUAL( react_get_action_metrics(action_code, NULL), -EINVAL );
+	BOOST_CHECK_EQUAL( react_add_action_error(-1), -EINVAL );
+}
+
+BOOST_AUTO_TEST_CASE( react_inactive_metrics_test )
+{
+	int action_code = react_define_new_action("INACTIVE_METRICS_ACTION");
+	int nested_action_code = react_define_new_action("INACTIVE_METRICS_NESTED_ACTION");
+	react_action_metrics_t initial, nested_initial;
+	BOOST_REQUIRE_EQUAL( react_get_action_metrics(action_code, &initial), 0 );
+	BOOST_REQUIRE_EQUAL( react_get_action_metrics(nested_action_code, &nested_initial), 0 );
+
+	BOOST_CHECK_EQUAL( react_get_inactive_metrics(), 0 );
+	BOOST_REQUIRE_EQUAL( react_set_inactive_metrics(1), 0 );
+	BOOST_CHECK_EQUAL( react_get_inactive_metrics(), 1 );
+	BOOST_REQUIRE_EQUAL( react_set_record_mode(REACT_RECORD_MODE_OFF, 0), 0 );
+	react_activate(NULL);
+	BOOST_CHECK( !react_is_active() );
+
+	BOOST_CHECK_EQUAL( react_start_action(action_code), 0 );
+	BOOST_CHECK_EQUAL( react_start_action_fast(nested_action_code), 0 );
+	{
+		action_guard guard(action_code);
+	}
+	BOOST_CHECK_EQUAL( react_stop_action(action_code), -EINVAL );
+	BOOST_CHECK_EQUAL( react_stop_action_fast(nested_action_code), 0 );
+	BOOST_CHECK_EQUAL( react_stop_action(action_code), 0 );
+	BOOST_CHECK_EQUAL( react_start_action(-1), -EINVAL );
+
+	BOOST_REQUIRE_EQUAL( react_set_inactive_metrics(0), 0 );
+	BOOST_CHECK_EQUAL( react_get_inactive_metrics(), 0 );
+	react_start_action_fast(action_code);
+	react_stop_action_fast(action_code);
+	{
+		action_guard guard(action_code);
+	}
+
+	react_deactivate();
+	BOOST_REQUIRE_EQUAL( react_set_record_mode(REACT_RECORD_MODE_FULL, 0), 0 );
+
+	react_action_metrics_t metrics;
+	BOOST_REQUIRE_EQUAL( react_get_action_metrics(action_code, &metrics), 0 );
+	BOOST_CHECK_EQUAL( metrics.calls, initial.calls + 2 );
+	BOOST_CHECK_EQUAL( metrics.errors, initial.errors + 1 );
+	BOOST_REQUIRE_EQUAL( react_get_action_metrics(nested_action_code, &metrics), 0 );
+	BOOST_CHECK_EQUAL( metrics.calls, nested_initial.calls + 1 );
+}
+
+BOOST_AUTO_TEST_CASE( react_inactive_action_state_test )
+{
+	int aggregated_action_code = react_define_new_action("INACTIVE_AGGREGATED_ACTION");
+	int disabled_action_code = react_define_new_action("INACTIVE_DISABLED_ACTION");
+	BOOST_REQUIRE_EQUAL( react_set_action_state(aggregated_action_code, REACT_ACTION_AGGREGATE_ONLY), 0 );
+	BOOST_REQUIRE_EQUAL( react_set_action_state(disabled_action_code, REACT_ACTION_DISABLED), 0 );
+	react_action_metrics_t aggregated_initial, disabled_initial;
+	BOOST_REQUIRE_EQUAL( react_get_action_metrics(aggregated_action_code, &aggregated_initial), 0 );
+	BOOST_REQUIRE_EQUAL( react_get_action_metrics(disabled_action_code, &disabled_initial), 0 );
+
+	// Thread that is never activated counts aggregate only actions same as recorded one
+	BOOST_REQUIRE_EQUAL( react_set_inactive_metrics(1), 0 );
+	std::thread thread([aggregated_action_code, disabled_action_code] () {
+		action_guard guard(disabled_action_code);
+		action_guard nested_guard(aggregated_action_code);
+		BOOST_CHECK_EQUAL( react_start_action_fast(disabled_action_code), 0 );
+		BOOST_CHECK_EQUAL( react_stop_action_fast(disabled_action_code), 0 );
+	});
+	thread.join();
+	BOOST_REQUIRE_EQUAL( react_set_inactive_metrics(0), 0 );
+
+	react_activate(NULL);
+	BOOST_CHECK_EQUAL( react_start_action(aggregated_action_code), 0 );
+	BOOST_CHECK_EQUAL( react_stop_action(aggregated_action_code), 0 );
+	react_deactivate();
+
+	BOOST_REQUIRE_EQUAL( react_set_action_state(aggregated_action_code, REACT_ACTION_ENABLED), 0 );
+	BOOST_REQUIRE_EQUAL( react_set_action_state(disabled_action_code, REACT_ACTION_ENABLED), 0 );
+
+	react_action_metrics_t metrics;
+	BOOST_REQUIRE_EQUAL( react_get_action_metrics(aggregated_action_code, &metrics), 0 );
+	BOOST_CHECK_EQUAL( metrics.calls, aggregated_initial.calls + 2 );
+	BOOST_REQUIRE_EQUAL( react_get_action_metrics(disabled_action_code, &metrics), 0 );
+	BOOST_CHECK_EQUAL( metrics.calls, disabled_initial.calls );
+	BOOST_CHECK_EQUAL( metrics.errors, disabled_initial.errors );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -1,3 +1,8 @@
+#include <set>
+#include <sstream>
+#include <thread>
+#include <vector>
+
 #include "tests.hpp"
 
 #include "react/react.hpp"
@@ -26,6 +31,130 @@ BOOST_AUTO_TEST_CASE( react_activate_test )
 	BOOST_CHECK( !react_is_active() );
 }
 
+BOOST_AUTO_TEST_CASE( react_set_time_unit_test )
+{
+	std::ostringstream output;
+	react::stream_aggregator_t aggregator(output);
+	BOOST_CHECK_EQUAL( react_set_time_unit(REACT_TIME_UNIT_NANOSECONDS), 0 );
+
+	react_activate(&aggregator);
+	BOOST_CHECK_EQUAL( react_set_time_unit(static_cast<react_time_unit_t>(42)), -EINVAL );
+	BOOST_CHECK_EQUAL( react_set_time_unit(REACT_TIME_UNIT_NANOSECONDS), 0 );
+	react_deactivate();
+
+	BOOST_CHECK( output.str().find("\"time_unit\": \"ns\"") != std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( react_set_max_nodes_test )
+{
+	std::ostringstream output;
+	react::stream_aggregator_t aggregator(output);
+	int action_code = react_define_new_action("ACTION");
+	BOOST_CHECK_EQUAL( react_set_max_nodes(1), 0 );
+
+	react_activate(&aggregator);
+	BOOST_CHECK_EQUAL( react_set_max_nodes(0), -EINVAL );
+	BOOST_CHECK_EQUAL( react_set_max_nodes(2), 0 );
+	for (int i = 0; i < 1000; ++i) {
+		react_start_action(action_code);
+		react_stop_action(action_code);
+	}
+	react_deactivate();
+
+	BOOST_CHECK( output.str().find("\"truncated\": true") != std::string::npos );
+	BOOST_CHECK( output.str().find("\"dropped_nodes\": 999") != std::string::npos );
+
+	BOOST_CHECK_EQUAL( react_context_set_max_nodes(NULL, 2), -EINVAL );
+}
+
+BOOST_AUTO_TEST_CASE( react_memory_limit_test )
+{
+	std::ostringstream output;
+	react::stream_aggregator_t aggregator(output);
+	const size_t skipped_activations = react_get_skipped_activations();
+
+	react_activate(&aggregator);
+	BOOST_CHECK( react_get_memory_usage() > 0 );
+	BOOST_CHECK_EQUAL( react_deactivate(), 0 );
+
+	// Activation over limit leaves thread not active, but keeps activations balanced
+	react::call_tree_t live_tree(react::get_actions_set());
+	BOOST_CHECK_EQUAL( react_set_memory_limit(1), 0 );
+	BOOST_CHECK_EQUAL( react_activate(&aggregator), 0 );
+	BOOST_CHECK( !react_is_active() );
+	BOOST_CHECK_EQUAL( react_activate(&aggregator), 0 );
+	BOOST_CHECK_EQUAL( react_deactivate(), 0 );
+	BOOST_CHECK_EQUAL( react_deactivate(), 0 );
+	BOOST_CHECK_EQUAL( react_get_skipped_activations(), skipped_activations + 1 );
+
+	BOOST_CHECK_EQUAL( react_set_memory_limit(0), 0 );
+	react_activate(&aggregator);
+	BOOST_CHECK( react_is_active() );
+	react_deactivate();
+
+	BOOST_CHECK_EQUAL( react_set_memory_limit_percent(0), -EINVAL );
+	BOOST_CHECK_EQUAL( react_set_memory_limit_percent(101), -EINVAL );
+	BOOST_CHECK_EQUAL( react_set_memory_limit_percent(50), 0 );
+	react_activate(&aggregator);
+	BOOST_CHECK( react_is_active() );
+	react_deactivate();
+	react_set_memory_limit(0);
+
+	BOOST_CHECK( output.str().find("\"mapped_size\"") != std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( react_activate_ids_test )
+{
+	react_trace_id_t id;
+	BOOST_CHECK_NE( react_get_id(&id), 0 );
+
+	std::set<std::pair<uint64_t, uint64_t>> ids;
+	for (int i = 0; i < 1000; ++i) {
+		react_activate(NULL);
+
+		react_trace_id_t trace_id;
+		BOOST_REQUIRE_EQUAL( react_get_id(&id), 0 );
+		BOOST_REQUIRE_EQUAL( react_get_trace_id(&trace_id), 0 );
+		// New trace is started by default
+		BOOST_CHECK( id.high == trace_id.high && id.low == trace_id.low );
+		ids.insert(std::make_pair(id.high, id.low));
+
+		react_deactivate();
+	}
+	BOOST_CHECK_EQUAL( ids.size(), 1000 );
+}
+
+BOOST_AUTO_TEST_CASE( react_activate_with_parent_test )
+{
+	react_trace_id_t trace_id, parent_id;
+	BOOST_REQUIRE_EQUAL( react_trace_id_from_string("0123456789abcdef0123456789abcdef", &trace_id), 0 );
+	BOOST_REQUIRE_EQUAL( react_trace_id_from_string("42", &parent_id), 0 );
+	BOOST_CHECK_EQUAL( parent_id.high, 0 );
+	BOOST_CHECK_EQUAL( parent_id.low, 0x42 );
+
+	react_activate_with_parent(NULL, trace_id, parent_id);
+
+	react_trace_id_t id, current_trace_id;
+	BOOST_REQUIRE_EQUAL( react_get_id(&id), 0 );
+	BOOST_REQUIRE_EQUAL( react_get_trace_id(&current_trace_id), 0 );
+	BOOST_CHECK( current_trace_id.high == trace_id.high && current_trace_id.low == trace_id.low );
+	BOOST_CHECK( id.high != trace_id.high || id.low != trace_id.low );
+
+	char buffer[33];
+	BOOST_CHECK_NE( react_trace_id_to_string(current_trace_id, buffer, 32), 0 );
+	BOOST_REQUIRE_EQUAL( react_trace_id_to_string(current_trace_id, buffer, sizeof(buffer)), 0 );
+	BOOST_CHECK_EQUAL( std::string(buffer), "0123456789abcdef0123456789abcdef" );
+
+	react_deactivate();
+
+	boost::test_tools::output_test_stream error_output;
+	cerr_redirect guard(error_output.rdbuf());
+	BOOST_CHECK_NE( react_trace_id_from_string("not an id", &trace_id), 0 );
+	BOOST_CHECK_EQUAL( react_trace_id_from_string(NULL, &trace_id), -EINVAL );
+	BOOST_CHECK_EQUAL( react_trace_id_from_string("42", NULL), -EINVAL );
+	BOOST_CHECK_EQUAL( react_trace_id_to_string(current_trace_id, NULL, sizeof(buffer)), -EINVAL );
+}
+
 BOOST_AUTO_TEST_CASE( react_double_activate_test )
 {
 	boost::test_tools::output_test_stream error_output;
@@ -155,6 +284,53 @@ BOOST_AUTO_TEST_CASE( react_add_stat_test_c )
 	react_deactivate();
 }
 
+BOOST_AUTO_TEST_CASE( react_add_stat_by_code_test_c )
+{
+	react_activate(NULL);
+
+	int stat_code = react_define_new_stat("STAT");
+	BOOST_CHECK_EQUAL( react_define_new_stat("STAT"), stat_code );
+
+	BOOST_CHECK_EQUAL( react_add_stat_bool_by_code(stat_code, bool()), 0 );
+	BOOST_CHECK_EQUAL( react_add_stat_int_by_code(stat_code, int()), 0 );
+	BOOST_CHECK_EQUAL( react_add_stat_int64_by_code(stat_code, int64_t()), 0 );
+	BOOST_CHECK_EQUAL( react_add_stat_uint64_by_code(stat_code, uint64_t()), 0 );
+	BOOST_CHECK_EQUAL( react_add_stat_double_by_code(stat_code, double()), 0 );
+	BOOST_CHECK_EQUAL( react_add_stat_string_by_code(stat_code, ""), 0 );
+
+	BOOST_CHECK_EQUAL( react_add_stat_int64("int64", int64_t()), 0 );
+	BOOST_CHECK_EQUAL( react_add_stat_uint64("uint64", uint64_t()), 0 );
+
+	{
+		boost::test_tools::output_test_stream error_output;
+		cerr_redirect guard(error_output.rdbuf());
+		BOOST_CHECK_NE( react_add_stat_int_by_code(react::actions_set_t::NO_STAT, int()), 0 );
+		BOOST_CHECK( !error_output.is_empty() );
+	}
+
+	react_deactivate();
+}
+
+BOOST_AUTO_TEST_CASE( react_update_stat_test_c )
+{
+	react_activate(NULL);
+
+	int stat_code = react_define_new_stat("COUNTER");
+	int action_code = react_define_new_action("ACTION");
+
+	BOOST_CHECK_EQUAL( react_increment_stat(stat_code, 1), 0 );
+	BOOST_CHECK_EQUAL( react_update_stat_max(stat_code, 2), 0 );
+	BOOST_CHECK_EQUAL( react_update_stat_min(stat_code, 1), 0 );
+
+	react_start_action(action_code);
+	BOOST_CHECK_EQUAL( react_increment_node_stat(stat_code, 1), 0 );
+	BOOST_CHECK_EQUAL( react_update_node_stat_max(stat_code, 2), 0 );
+	BOOST_CHECK_EQUAL( react_update_node_stat_min(stat_code, 1), 0 );
+	react_stop_action(action_code);
+
+	react_deactivate();
+}
+
 BOOST_AUTO_TEST_CASE( react_not_active_add_stat_test_c )
 {
 	// Forgot to activate react
@@ -235,6 +411,23 @@ BOOST_AUTO_TEST_CASE( get_actions_set_test )
 	BOOST_CHECK_EQUAL( react::get_actions_set().get_action_name(action_code), "ACTION" );
 }
 
+BOOST_AUTO_TEST_CASE( react_fast_path_test )
+{
+	int action_code = react_define_new_action("ACTION");
+	BOOST_CHECK( !react_is_active_fast() );
+	BOOST_CHECK_EQUAL( react_start_action_fast(action_code), 0 );
+	BOOST_CHECK_EQUAL( react_stop_action_fast(action_code), 0 );
+
+	react_activate(NULL);
+	BOOST_CHECK( react_is_active_fast() );
+	BOOST_CHECK_EQUAL( react_start_action_fast(action_code), 0 );
+	BOOST_CHECK_EQUAL( react_stop_action_fast(action_code + 1), -EINVAL );
+	BOOST_CHECK_EQUAL( react_stop_action_fast(action_code), 0 );
+	react_deactivate();
+
+	BOOST_CHECK( !react_is_active_fast() );
+}
+
 BOOST_AUTO_TEST_CASE( action_guard_test )
 {
 	react_activate(NULL);
@@ -257,6 +450,170 @@ BOOST_AUTO_TEST_CASE( action_guard_stop_test )
 	int action_code = react_define_new_action("ACTION");
 	react::action_guard guard(action_code);
 	guard.stop();
+	BOOST_CHECK_THROW( guard.stop(), std::logic_error );
+	react_deactivate();
+}
+
+BOOST_AUTO_TEST_CASE( action_guard_move_test )
+{
+	std::ostringstream output;
+	react::stream_aggregator_t aggregator(output);
+	int action_code = react_define_new_action("MOVED_ACTION");
+
+	react_activate(&aggregator);
+	{
+		std::vector<react::action_guard> guards;
+		for (int i = 0; i < 3; ++i) {
+			guards.push_back(react::action_guard(action_code));
+		}
+		while (!guards.empty()) {
+			guards.pop_back();
+		}
+
+		react::action_guard guard(action_code);
+		react::action_guard moved_guard(std::move(guard));
+		BOOST_CHECK_THROW( guard.stop(), std::logic_error );
+		moved_guard.stop();
+
+		react::action_guard assigned_guard(action_code);
+		assigned_guard = react::action_guard(action_code);
+	}
+	react_deactivate();
+
+	BOOST_CHECK_EQUAL( sizeof(react::action_guard), sizeof(void *) + sizeof(void *) );
+
+	BOOST_CHECK( output.str().find("MOVED_ACTION") != std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( react_adopt_context_test )
+{
+	std::ostringstream output;
+	react::stream_aggregator_t aggregator(output);
+	int parent_action_code = react_define_new_action("PARENT_ACTION");
+	int task_action_code = react_define_new_action("TASK_ACTION");
+
+	react_activate(&aggregator);
+	react_start_action(parent_action_code);
+
+	react::context_token token = react::capture_context();
+	BOOST_REQUIRE( !token.empty() );
+
+	for (int i = 0; i < 2; ++i) {
+		std::thread worker([&token, task_action_code] () {
+			react::adopt_guard guard(token);
+			react::action_guard action(task_action_code);
+		});
+		worker.join();
+	}
+
+	react_stop_action(parent_action_code);
+	react_deactivate();
+
+	std::string json = output.str();
+	BOOST_CHECK( json.find("TASK_ACTION") != std::string::npos );
+	BOOST_CHECK( json.find("TASK_ACTION") > json.find("PARENT_ACTION") );
+}
+
+BOOST_AUTO_TEST_CASE( react_adopt_context_test_c )
+{
+	int action_code = react_define_new_action("ACTION");
+	BOOST_CHECK( react_capture_context() == NULL );
+	BOOST_CHECK_EQUAL( react_adopt_context(NULL), -EINVAL );
+	BOOST_CHECK_EQUAL( react_leave_context(), -EINVAL );
+
+	react_activate(NULL);
+	void *token = react_capture_context();
+	BOOST_REQUIRE( token != NULL );
+
+	std::thread worker([token, action_code] () {
+		BOOST_CHECK( !react_is_active() );
+		BOOST_CHECK_EQUAL( react_adopt_context(token), 0 );
+		BOOST_CHECK( react_is_active() );
+		BOOST_CHECK_EQUAL( react_start_action(action_code), 0 );
+		BOOST_CHECK_EQUAL( react_stop_action(action_code), 0 );
+		// Adopted context is owned by the thread, task can't deactivate it
+		BOOST_CHECK_EQUAL( react_deactivate(), -EFAULT );
+		BOOST_CHECK( react_is_active() );
+		react_activate(NULL);
+		BOOST_CHECK_EQUAL( react_deactivate(), 0 );
+		BOOST_CHECK_EQUAL( react_leave_context(), 0 );
+		BOOST_CHECK( !react_is_active() );
+	});
+	worker.join();
+
+	react_release_context(token);
+	react_deactivate();
+}
+
+BOOST_AUTO_TEST_CASE( react_not_active_adopt_context_test )
+{
+	react::context_token token = react::capture_context();
+	BOOST_CHECK( token.empty() );
+	react::adopt_guard guard(token);
+	BOOST_CHECK( !react_is_active() );
+}
+
+BOOST_AUTO_TEST_CASE( react_context_handle_test )
+{
+	std::ostringstream output;
+	react::stream_aggregator_t aggregator(output);
+	int first_action_code = react_define_new_action("FIRST_REQUEST");
+	int second_action_code = react_define_new_action("SECOND_REQUEST");
+	int stat_code = react_define_new_stat("requests");
+
+	void *first = react_context_create(&aggregator);
+	void *second = react_context_create(&aggregator);
+	BOOST_REQUIRE( first != NULL );
+	BOOST_REQUIRE( second != NULL );
+	BOOST_CHECK( !react_is_active() );
+
+	// Actions of interleaved requests don't affect each other
+	BOOST_CHECK_EQUAL( react_context_start_action(first, first_action_code), 0 );
+	BOOST_CHECK_EQUAL( react_context_start_action(second, second_action_code), 0 );
+	BOOST_CHECK_EQUAL( react_context_stop_action(first, first_action_code), 0 );
+	BOOST_CHECK_EQUAL( react_context_add_stat_string(first, "key", "value"), 0 );
+	BOOST_CHECK_EQUAL( react_context_increment_stat(second, stat_code, 2), 0 );
+	BOOST_CHECK_EQUAL( react_context_stop_action(second, second_action_code), 0 );
+
+	react_trace_id_t first_id, second_id;
+	BOOST_CHECK_EQUAL( react_context_get_id(first, &first_id), 0 );
+	BOOST_CHECK_EQUAL( react_context_get_id(second, &second_id), 0 );
+	BOOST_CHECK( first_id.high != second_id.high || first_id.low != second_id.low );
+
+	BOOST_CHECK_EQUAL( react_context_finish(first), 0 );
+	std::string first_json = output.str();
+	BOOST_CHECK( first_json.find("FIRST_REQUEST") != std::string::npos );
+	BOOST_CHECK( first_json.find("SECOND_REQUEST") == std::string::npos );
+	BOOST_CHECK( first_json.find("\"value\"") != std::string::npos );
+
+	BOOST_CHECK_EQUAL( react_context_finish(second), 0 );
+	BOOST_CHECK( output.str().find("SECOND_REQUEST") != std::string::npos );
+
+	// Pooled context doesn't keep actions of previous request
+	output.str("");
+	void *third = react_context_create(&aggregator);
+	BOOST_REQUIRE( third != NULL );
+	BOOST_CHECK_EQUAL( react_context_finish(third), 0 );
+	BOOST_CHECK( output.str().find("REQUEST") == std::string::npos );
+	BOOST_CHECK( output.str().find("\"value\"") == std::string::npos );
+}
+
+BOOST_AUTO_TEST_CASE( react_context_handle_invalid_test )
+{
+	int action_code = react_define_new_action("ACTION");
+	BOOST_CHECK_EQUAL( react_context_start_action(NULL, action_code), -EINVAL );
+	BOOST_CHECK_EQUAL( react_context_finish(NULL), -EINVAL );
+
+	void *context = react_context_create(NULL);
+	BOOST_REQUIRE( context != NULL );
+	BOOST_CHECK_EQUAL( react_context_stop_action(context, action_code), -EINVAL );
+	BOOST_CHECK_EQUAL( react_context_start_action(context, action_code), 0 );
+	BOOST_CHECK_EQUAL( react_context_get_id(context, NULL), -EINVAL );
+	BOOST_CHECK_EQUAL( react_context_finish(context), 0 );
+
+	react_activate(NULL);
+	BOOST_CHECK_EQUAL( react_get_id(NULL), -EINVAL );
+	BOOST_CHECK_EQUAL( react_get_trace_id(NULL), -EINVAL );
 	react_deactivate();
 }
 
@@ -1,3 +1,4 @@
+#include <limits>
 #include <stdexcept>
 
 #include "tests.hpp"
@@ -41,6 +42,174 @@ BOOST_AUTO_TEST_CASE( get_stat_test )
 	BOOST_REQUIRE_EQUAL( call_tree.get_stat<std::string>("char*"), "" );
 }
 
+BOOST_AUTO_TEST_CASE( get_stat_64_bit_test )
+{
+	actions_set_t actions_set;
+	call_tree_t call_tree(actions_set);
+
+	call_tree.add_stat("int64", -(int64_t(1) << 40));
+	BOOST_REQUIRE_EQUAL( call_tree.get_stat<int64_t>("int64"), -(int64_t(1) << 40) );
+
+	call_tree.add_stat("uint64", uint64_t(1) << 63);
+	BOOST_REQUIRE_EQUAL( call_tree.get_stat<uint64_t>("uint64"), uint64_t(1) << 63 );
+}
+
+BOOST_AUTO_TEST_CASE( registered_stat_test )
+{
+	actions_set_t actions_set;
+	int stat_code = actions_set.define_new_stat("registered");
+	call_tree_t call_tree(actions_set);
+
+	BOOST_CHECK( !call_tree.has_stat(stat_code) );
+	BOOST_CHECK( !call_tree.has_stat("registered") );
+	BOOST_CHECK_THROW( call_tree.get_stat<int>(stat_code), std::out_of_range );
+
+	call_tree.add_stat(stat_code, 42);
+	BOOST_CHECK( call_tree.has_stat(stat_code) );
+	BOOST_REQUIRE_EQUAL( call_tree.get_stat<int>(stat_code), 42 );
+
+	// Slow path resolves registered names to the same slot
+	BOOST_REQUIRE_EQUAL( call_tree.get_stat<int>("registered"), 42 );
+	call_tree.add_stat("registered", "value");
+	BOOST_REQUIRE_EQUAL( call_tree.get_stat<std::string>(stat_code), "value" );
+}
+
+BOOST_AUTO_TEST_CASE( registered_stat_invalid_code_test )
+{
+	actions_set_t actions_set;
+	call_tree_t call_tree(actions_set);
+
+	BOOST_CHECK_THROW( call_tree.add_stat(0, 42), std::invalid_argument );
+	BOOST_CHECK_THROW( call_tree.add_stat(+actions_set_t::NO_STAT, 42), std::invalid_argument );
+	BOOST_CHECK( !call_tree.has_stat(0) );
+}
+
+BOOST_AUTO_TEST_CASE( registered_stat_to_json_test )
+{
+	actions_set_t actions_set;
+	int stat_code = actions_set.define_new_stat("registered");
+	call_tree_t call_tree(actions_set);
+
+	call_tree.add_stat(stat_code, int64_t(1) << 40);
+	call_tree.add_stat("unregistered", "value");
+
+	rapidjson::Document doc;
+	doc.SetObject();
+	call_tree.to_json(doc, doc.GetAllocator());
+
+	BOOST_REQUIRE( doc.HasMember("registered") );
+	BOOST_CHECK_EQUAL( doc["registered"].GetInt64(), int64_t(1) << 40 );
+	BOOST_REQUIRE( doc.HasMember("unregistered") );
+	BOOST_CHECK_EQUAL( std::string(doc["unregistered"].GetString()), "value" );
+}
+
+BOOST_AUTO_TEST_CASE( counter_stat_test )
+{
+	actions_set_t actions_set;
+	int counter = actions_set.define_new_stat("counter");
+	int max_gauge = actions_set.define_new_stat("max");
+	int min_gauge = actions_set.define_new_stat("min");
+	call_tree_t call_tree(actions_set);
+
+	for (int64_t i = 1; i <= 10; ++i) {
+		call_tree.increment_stat(counter, i);
+		call_tree.update_stat_max(max_gauge, i);
+		call_tree.update_stat_min(min_gauge, i);
+	}
+
+	BOOST_CHECK_EQUAL( call_tree.get_stat<int64_t>(counter), 55 );
+	BOOST_CHECK_EQUAL( call_tree.get_stat<int64_t>(max_gauge), 10 );
+	BOOST_CHECK_EQUAL( call_tree.get_stat<int64_t>(min_gauge), 1 );
+
+	BOOST_CHECK_THROW( call_tree.increment_stat(counter, 0.5), std::invalid_argument );
+	BOOST_CHECK_THROW( call_tree.increment_stat(counter, std::numeric_limits<uint64_t>::max()), std::invalid_argument );
+	BOOST_CHECK_THROW( call_tree.update_stat_max(max_gauge, 1e30), std::invalid_argument );
+	BOOST_CHECK_EQUAL( call_tree.get_stat<int64_t>(counter), 55 );
+	call_tree.increment_stat(counter, 5.0);
+	call_tree.increment_stat(counter, static_cast<uint64_t>(5));
+	BOOST_CHECK_EQUAL( call_tree.get_stat<int64_t>(counter), 65 );
+
+	int unsigned_counter = actions_set.define_new_stat("unsigned_counter");
+	call_tree.increment_stat(unsigned_counter, static_cast<uint64_t>(1));
+	BOOST_CHECK_THROW( call_tree.increment_stat(unsigned_counter, -1), std::invalid_argument );
+	int double_counter = actions_set.define_new_stat("double_counter");
+	call_tree.increment_stat(double_counter, 0.5);
+	call_tree.increment_stat(double_counter, 1);
+	BOOST_CHECK_THROW( call_tree.increment_stat(double_counter, std::numeric_limits<int64_t>::max()), std::invalid_argument );
+	BOOST_CHECK_CLOSE( call_tree.get_stat<double>(double_counter), 1.5, 1e-9 );
+}
+
+BOOST_AUTO_TEST_CASE( counter_non_numeric_stat_test )
+{
+	actions_set_t actions_set;
+	int stat_code = actions_set.define_new_stat("stat");
+	call_tree_t call_tree(actions_set);
+
+	BOOST_CHECK_THROW( call_tree.increment_stat(stat_code, true), std::invalid_argument );
+	BOOST_CHECK( !call_tree.has_stat(stat_code) );
+
+	call_tree.add_stat(stat_code, "string");
+	BOOST_CHECK_THROW( call_tree.increment_stat(stat_code, 1), std::invalid_argument );
+}
+
+BOOST_AUTO_TEST_CASE( node_stat_test )
+{
+	actions_set_t actions_set;
+	int action_code = actions_set.define_new_action("ACTION");
+	int counter = actions_set.define_new_stat("counter");
+	call_tree_t call_tree(actions_set);
+	call_tree_t::p_node_t node = call_tree.add_new_link(call_tree.root, action_code);
+
+	BOOST_CHECK( !call_tree.has_node_stat(node, counter) );
+	call_tree.increment_node_stat(node, counter, int64_t(2));
+	call_tree.increment_node_stat(node, counter, int64_t(3));
+	BOOST_CHECK_EQUAL( call_tree.get_node_stat<int64_t>(node, counter), 5 );
+	BOOST_CHECK_EQUAL( call_tree.get_node_stats(node).size(), 1 );
+	BOOST_CHECK( !call_tree.has_stat(counter) );
+
+	// Stats of root node are stats of the whole tree
+	call_tree.increment_node_stat(call_tree.root, counter, int64_t(7));
+	BOOST_CHECK_EQUAL( call_tree.get_stat<int64_t>(counter), 7 );
+}
+
+BOOST_AUTO_TEST_CASE( merge_stats_test )
+{
+	actions_set_t actions_set;
+	int action_code = actions_set.define_new_action("ACTION");
+	int counter = actions_set.define_new_stat("counter");
+	int max_gauge = actions_set.define_new_stat("max");
+	int value = actions_set.define_new_stat("value");
+
+	call_tree_t parent(actions_set);
+	parent.increment_stat(counter, int64_t(10));
+	parent.update_stat_max(max_gauge, int64_t(5));
+	parent.add_stat(value, "parent");
+	call_tree_t::p_node_t parent_node = parent.add_new_link(parent.root, action_code);
+
+	for (int i = 0; i < 3; ++i) {
+		call_tree_t child(actions_set);
+		child.increment_stat(counter, int64_t(i));
+		child.update_stat_max(max_gauge, int64_t(i * 3));
+		child.add_stat(value, "child");
+		child.add_stat("unregistered", i);
+		call_tree_t::p_node_t child_node = child.add_new_link(child.root, action_code);
+		child.increment_node_stat(child_node, counter, int64_t(1));
+
+		child.merge_into(parent_node, parent);
+	}
+
+	BOOST_CHECK_EQUAL( parent.get_stat<int64_t>(counter), 13 );
+	BOOST_CHECK_EQUAL( parent.get_stat<int64_t>(max_gauge), 6 );
+	BOOST_CHECK_EQUAL( parent.get_stat<std::string>(value), "parent" );
+	BOOST_CHECK_EQUAL( parent.get_stat<int>("unregistered"), 0 );
+
+	const node_t::Container &links = parent.get_node_links(parent_node);
+	BOOST_REQUIRE_EQUAL( links.size(), 3 );
+	for (auto it = links.begin(); it != links.end(); ++it) {
+		BOOST_CHECK_EQUAL( parent.get_node_stat<int64_t>(it->second, counter), 1 );
+	}
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
 
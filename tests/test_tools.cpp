@@ -0,0 +1,154 @@
+#include "tests.hpp"
+
+#include "react/call_tree.hpp"
+#include "react/utils.hpp"
+
+#include "report.hpp"
+
+BOOST_AUTO_TEST_SUITE( tools_suite )
+
+using namespace react;
+using namespace react::tools;
+
+namespace {
+
+std::string make_trees_json(size_t trees_count) {
+	actions_set_t actions_set;
+	int first_action_code = actions_set.define_new_action("FIRST");
+	int second_action_code = actions_set.define_new_action("SECOND");
+	int stat_code = actions_set.define_new_stat("STAT");
+
+	call_tree_t call_tree(actions_set);
+	call_tree.set_time_unit(TIME_UNIT_NANOSECONDS);
+	call_tree_t::p_node_t first = call_tree.add_new_link(call_tree.root, first_action_code);
+	call_tree_t::p_node_t second = call_tree.add_new_link(first, second_action_code);
+	call_tree.set_node_start_ticks(first, 1);
+	call_tree.set_node_stop_ticks(first, 10);
+	call_tree.set_node_start_ticks(second, 2);
+	call_tree.set_node_stop_ticks(second, 5);
+	call_tree.increment_node_stat(second, stat_code, 1);
+
+	std::string json;
+	for (size_t i = 0; i < trees_count; ++i) {
+		json += print_json_to_compact_string(call_tree) + "\n";
+	}
+	return json;
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( profile_call_paths_test )
+{
+	const std::string json = make_trees_json(2);
+
+	profile_t profile;
+	tree_reader_t<profile_t> reader(profile, profile.get_names());
+	BOOST_CHECK_EQUAL( reader.parse_all(json.data(), json.data() + json.size()), 0 );
+	BOOST_CHECK_EQUAL( profile.get_trees_count(), 2 );
+
+	const std::vector<profile_t::path_t> &paths = profile.get_paths();
+	BOOST_REQUIRE_EQUAL( paths.size(), 2 );
+	BOOST_CHECK_EQUAL( profile.get_path_name(0), "FIRST" );
+	BOOST_CHECK_EQUAL( profile.get_path_name(1), "FIRST;SECOND" );
+	BOOST_CHECK_EQUAL( paths[0].stats.calls, 2 );
+	BOOST_CHECK_EQUAL( paths[0].stats.total_time, 18 );
+	BOOST_CHECK_EQUAL( paths[0].stats.self_time, 12 );
+	BOOST_CHECK_EQUAL( paths[1].stats.self_time, 6 );
+	BOOST_CHECK_EQUAL( paths[1].stats.histogram.get_quantile(0.5), 3 );
+
+	profile_t merged;
+	merged.get_names().intern("SECOND", 6);
+	merged.merge(profile);
+	merged.merge(profile);
+	BOOST_CHECK_EQUAL( merged.get_trees_count(), 4 );
+	BOOST_REQUIRE_EQUAL( merged.get_paths().size(), 2 );
+	BOOST_CHECK_EQUAL( merged.get_path_name(1), "FIRST;SECOND" );
+	BOOST_CHECK_EQUAL( merged.get_paths()[1].stats.calls, 4 );
+}
+
+BOOST_AUTO_TEST_CASE( profile_sorted_paths_test )
+{
+	const size_t ACTIONS_COUNT = 12;
+	actions_set_t actions_set;
+	call_tree_t call_tree(actions_set);
+	call_tree.set_time_unit(TIME_UNIT_NANOSECONDS);
+	for (size_t i = 0; i < ACTIONS_COUNT; ++i) {
+		char name[8];
+		snprintf(name, sizeof(name), "A%02d", static_cast<int>(i));
+		call_tree_t::p_node_t node = call_tree.add_new_link(call_tree.root, actions_set.define_new_action(name));
+		call_tree.set_node_start_ticks(node, 0);
+		call_tree.set_node_stop_ticks(node, i + 1);
+	}
+	const std::string json = print_json_to_compact_string(call_tree) + "\n";
+
+	profile_t profile;
+	tree_reader_t<profile_t> reader(profile, profile.get_names());
+	BOOST_REQUIRE_EQUAL( reader.parse_all(json.data(), json.data() + json.size()), 0 );
+
+	for (size_t limit = 0; limit <= ACTIONS_COUNT; limit += 4) {
+		const std::vector<named_stats_t> paths = get_paths(profile, limit);
+		BOOST_REQUIRE_EQUAL( paths.size(), limit ? limit : ACTIONS_COUNT );
+		for (size_t i = 0; i < paths.size(); ++i) {
+			// The slowest action comes first
+			char name[8];
+			snprintf(name, sizeof(name), "A%02d", static_cast<int>(ACTIONS_COUNT - 1 - i));
+			BOOST_CHECK_EQUAL( paths[i].name, name );
+			BOOST_CHECK_EQUAL( paths[i].stats->total_time, static_cast<int64_t>(ACTIONS_COUNT - i) );
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE( tree_reader_malformed_test )
+{
+	const std::string json = make_trees_json(1) + "{\"actions\": [}\n" + make_trees_json(1);
+
+	profile_t profile;
+	tree_reader_t<profile_t> reader(profile, profile.get_names());
+	BOOST_CHECK_EQUAL( reader.parse_all(json.data(), json.data() + json.size()), 1 );
+	BOOST_CHECK_EQUAL( profile.get_trees_count(), 2 );
+}
+
+BOOST_AUTO_TEST_CASE( profile_parse_ranges_test )
+{
+	const std::string json = make_trees_json(10);
+	const char *begin = json.data();
+	const char *end = json.data() + json.size();
+
+	// Every document is read exactly once whatever the ranges are
+	for (size_t range_size = 1; range_size < json.size(); range_size += 7) {
+		profile_t merged;
+		for (const char *it = begin; it < end; it += range_size) {
+			profile_t profile;
+			profile.set_slow_trees_limit(3);
+			profile.load_range(begin, end, it, std::min(end, it + range_size));
+			merged.merge(profile);
+		}
+		BOOST_REQUIRE_EQUAL( merged.get_trees_count(), 10 );
+		BOOST_REQUIRE_EQUAL( merged.get_errors_count(), 0 );
+	}
+
+	profile_t profile;
+	profile.set_slow_trees_limit(3);
+	profile.load_range(begin, end, begin, end);
+	BOOST_CHECK_EQUAL( profile.get_slow_trees().size(), 3 );
+	BOOST_CHECK_EQUAL( profile.get_slow_trees()[0].duration, 9 );
+	BOOST_REQUIRE_EQUAL( profile.get_actions().size(), 2 );
+	BOOST_CHECK_EQUAL( profile.get_actions()[1].calls, 10 );
+	BOOST_CHECK_EQUAL( profile.get_actions()[1].max_time, 3 );
+}
+
+BOOST_AUTO_TEST_CASE( duration_histogram_test )
+{
+	duration_histogram_t histogram;
+	for (int64_t duration = 1; duration <= 1000; ++duration) {
+		histogram.add(duration * 1000);
+	}
+
+	BOOST_CHECK_EQUAL( histogram.get_total(), 1000 );
+	BOOST_CHECK_CLOSE( static_cast<double>(histogram.get_quantile(0.5)), 500000., 4 );
+	BOOST_CHECK_CLOSE( static_cast<double>(histogram.get_quantile(0.99)), 990000., 4 );
+	BOOST_CHECK_EQUAL( duration_histogram_t::get_bucket(15), 15 );
+	BOOST_CHECK_EQUAL( duration_histogram_t::get_lower_bound(duration_histogram_t::get_bucket(1000)), 992 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
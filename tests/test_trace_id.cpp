@@ -0,0 +1,45 @@
+#include <stdexcept>
+
+#include "tests.hpp"
+
+#include "react/trace_id.hpp"
+
+BOOST_AUTO_TEST_SUITE( trace_id_suite )
+
+using namespace react;
+
+BOOST_AUTO_TEST_CASE( trace_id_constructors_test )
+{
+	trace_id_t id;
+	BOOST_CHECK( id.is_null() );
+
+	trace_id_t another_id(1, 2);
+	BOOST_CHECK( !another_id.is_null() );
+	BOOST_CHECK_EQUAL( another_id.high, 1 );
+	BOOST_CHECK_EQUAL( another_id.low, 2 );
+	BOOST_CHECK( id != another_id );
+}
+
+BOOST_AUTO_TEST_CASE( trace_id_to_string_test )
+{
+	trace_id_t id(0x0123456789abcdefULL, 0xfedcba9876543210ULL);
+	BOOST_CHECK_EQUAL( id.to_string(), "0123456789abcdeffedcba9876543210" );
+	BOOST_CHECK_EQUAL( trace_id_t().to_string(), std::string(trace_id_t::STRING_LENGTH, '0') );
+}
+
+BOOST_AUTO_TEST_CASE( trace_id_from_string_test )
+{
+	trace_id_t id(0x0123456789abcdefULL, 0xfedcba9876543210ULL);
+	BOOST_CHECK( trace_id_t::from_string(id.to_string()) == id );
+	BOOST_CHECK( trace_id_t::from_string("0123456789ABCDEFFEDCBA9876543210") == id );
+
+	// Short ids, e.g. 64-bit ones from other tracers, are right aligned
+	BOOST_CHECK( trace_id_t::from_string("ff") == trace_id_t(0, 0xff) );
+	BOOST_CHECK( trace_id_t::from_string("1ffffffffffffffff") == trace_id_t(1, ~0ULL) );
+
+	BOOST_CHECK_THROW( trace_id_t::from_string(""), std::invalid_argument );
+	BOOST_CHECK_THROW( trace_id_t::from_string("xyz"), std::invalid_argument );
+	BOOST_CHECK_THROW( trace_id_t::from_string(std::string(33, '0')), std::invalid_argument );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,127 @@
+#include "tests.hpp"
+
+
+#include "react/call_tree.hpp"
+#include "react/utils.hpp"
+#include "react/tree_reader.h"
+
+BOOST_AUTO_TEST_SUITE( tree_reader_suite )
+
+using namespace react;
+
+namespace {
+
+struct events_t {
+	std::vector<std::string> log;
+	int64_t stat_value;
+};
+
+void on_tree_begin(void *user_data) {
+	static_cast<events_t *>(user_data)->log.push_back("begin");
+}
+
+void on_node_enter(void *user_data, int, const char *name, size_t name_length,
+		int64_t start_time, int64_t stop_time) {
+	static_cast<events_t *>(user_data)->log.push_back(
+		"enter " + std::string(name, name_length) + " " + std::to_string(stop_time - start_time)
+	);
+}
+
+void on_node_exit(void *user_data) {
+	static_cast<events_t *>(user_data)->log.push_back("exit");
+}
+
+void on_stat(void *user_data, const char *key, size_t key_length, const react_json_value_t *value) {
+	events_t *events = static_cast<events_t *>(user_data);
+	events->log.push_back("stat " + std::string(key, key_length));
+	if (value->type == REACT_JSON_INT64) {
+		events->stat_value = value->value.int64_value;
+	}
+}
+
+void on_tree_end(void *user_data, const char *id, size_t id_length) {
+	static_cast<events_t *>(user_data)->log.push_back("end " + std::string(id, id_length));
+}
+
+} // namespace
+
+BOOST_AUTO_TEST_CASE( react_tree_reader_test )
+{
+	actions_set_t actions_set;
+	int first_action_code = actions_set.define_new_action("FIRST");
+	int second_action_code = actions_set.define_new_action("SECOND");
+	int stat_code = actions_set.define_new_stat("STAT");
+
+	call_tree_t call_tree(actions_set);
+	call_tree.set_id(trace_id_t(0, 1));
+	call_tree_t::p_node_t first = call_tree.add_new_link(call_tree.root, first_action_code);
+	call_tree_t::p_node_t second = call_tree.add_new_link(first, second_action_code);
+	call_tree.set_node_start_ticks(first, 1000);
+	call_tree.set_node_stop_ticks(first, 10000);
+	call_tree.set_node_start_ticks(second, 2000);
+	call_tree.set_node_stop_ticks(second, 5000);
+	call_tree.increment_node_stat(second, stat_code, 7);
+
+	const std::string json = print_json_to_string(call_tree) + "\n" + print_json_to_compact_string(call_tree);
+
+	react_tree_reader_callbacks_t callbacks = {
+		on_tree_begin, on_node_enter, on_node_exit, on_stat, on_tree_end
+	};
+	events_t events;
+	events.stat_value = 0;
+	react_tree_reader_t *reader = react_tree_reader_create(&callbacks, &events);
+	BOOST_REQUIRE( reader );
+
+	BOOST_CHECK_EQUAL( react_tree_reader_parse(reader, json.data(), json.size()), 0 );
+
+	const char *expected[] = {
+		"begin", "stat mapped_size", "enter FIRST 9000", "enter SECOND 3000", "stat STAT", "exit", "exit",
+		"end 00000000000000000000000000000001"
+	};
+	const size_t expected_size = sizeof(expected) / sizeof(expected[0]);
+	BOOST_REQUIRE_EQUAL( events.log.size(), 2 * expected_size );
+	for (size_t i = 0; i < events.log.size(); ++i) {
+		BOOST_CHECK_EQUAL( events.log[i], expected[i % expected_size] );
+	}
+	BOOST_CHECK_EQUAL( events.stat_value, 7 );
+
+	BOOST_CHECK_EQUAL( react_tree_reader_get_actions_count(reader), 2 );
+	BOOST_CHECK_EQUAL( react_tree_reader_get_action_name(reader, 1), std::string("SECOND") );
+	BOOST_CHECK( !react_tree_reader_get_action_name(reader, 2) );
+
+	BOOST_CHECK_EQUAL( react_tree_reader_parse(reader, "{\"actions\": [", 13), 1 );
+	BOOST_CHECK_EQUAL( react_tree_reader_parse_file(reader, "/nonexistent/react.json"), -EINVAL );
+
+	react_tree_reader_destroy(reader);
+}
+
+BOOST_AUTO_TEST_CASE( react_tree_reader_long_id_test )
+{
+	// Ids of old dumps aren't limited to hex of trace id
+	const std::string id(64, 'a');
+	const std::string json = "{\"id\": \"" + id + "\", \"actions\": []}\n{\"actions\": []}\n";
+
+	react_tree_reader_callbacks_t callbacks = {
+		on_tree_begin, on_node_enter, on_node_exit, on_stat, on_tree_end
+	};
+	events_t events;
+	events.stat_value = 0;
+	react_tree_reader_t *reader = react_tree_reader_create(&callbacks, &events);
+	BOOST_REQUIRE( reader );
+
+	BOOST_CHECK_EQUAL( react_tree_reader_parse(reader, json.data(), json.size()), 0 );
+	BOOST_REQUIRE_EQUAL( events.log.size(), 4 );
+	BOOST_CHECK_EQUAL( events.log[1], "end " + id );
+	BOOST_CHECK_EQUAL( events.log[3], "end " );
+
+	react_tree_reader_destroy(reader);
+}
+
+BOOST_AUTO_TEST_CASE( react_tree_reader_invalid_test )
+{
+	BOOST_CHECK( !react_tree_reader_create(NULL, NULL) );
+	BOOST_CHECK_EQUAL( react_tree_reader_parse(NULL, NULL, 0), -EINVAL );
+	BOOST_CHECK_EQUAL( react_tree_reader_get_actions_count(NULL), 0 );
+}
+
+BOOST_AUTO_TEST_SUITE_END()
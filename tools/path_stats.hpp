@@ -0,0 +1,432 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef REACT_TOOLS_PATH_STATS_HPP
+#define REACT_TOOLS_PATH_STATS_HPP
+
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <unordered_map>
+#include <stdint.h>
+
+#include "react/tree_reader.hpp"
+
+namespace react { namespace tools {
+
+/*!
+ * \brief Histogram of durations with bounded relative error
+ *
+ * Durations below 16 have exact buckets, every next power of two is split into 16 buckets,
+ * so quantiles are estimated with relative error below 1/32.
+ */
+class duration_histogram_t {
+public:
+	static const size_t SUB_BUCKETS_BITS = 4;
+	static const size_t SUB_BUCKETS = 1 << SUB_BUCKETS_BITS;
+	static const size_t BUCKETS_COUNT = SUB_BUCKETS + (64 - SUB_BUCKETS_BITS) * SUB_BUCKETS;
+
+	duration_histogram_t(): total(0) {}
+
+	/*!
+	 * \brief Adds \a duration to histogram
+	 */
+	void add(int64_t duration) {
+		if (counts.empty()) {
+			counts.resize(BUCKETS_COUNT, 0);
+		}
+		++counts[get_bucket(duration < 0 ? 0 : duration)];
+		++total;
+	}
+
+	/*!
+	 * \brief Adds all durations from \a other
+	 */
+	void merge(const duration_histogram_t &other) {
+		if (other.counts.empty()) {
+			return;
+		}
+		if (counts.empty()) {
+			counts.resize(BUCKETS_COUNT, 0);
+		}
+		for (size_t i = 0; i < BUCKETS_COUNT; ++i) {
+			counts[i] += other.counts[i];
+		}
+		total += other.total;
+	}
+
+	/*!
+	 * \brief Returns estimation of quantile \a q from [0, 1], 0 if histogram is empty
+	 */
+	int64_t get_quantile(double q) const {
+		if (!total) {
+			return 0;
+		}
+
+		uint64_t rank = q * (total - 1);
+		uint64_t seen = 0;
+		for (size_t i = 0; i < BUCKETS_COUNT; ++i) {
+			seen += counts[i];
+			if (seen > rank) {
+				return (get_lower_bound(i) + get_lower_bound(i + 1) - 1) / 2;
+			}
+		}
+		return get_lower_bound(BUCKETS_COUNT - 1);
+	}
+
+	/*!
+	 * \brief Returns number of added durations
+	 */
+	uint64_t get_total() const {
+		return total;
+	}
+
+	static size_t get_bucket(uint64_t duration) {
+		if (duration < SUB_BUCKETS) {
+			return duration;
+		}
+		const size_t exponent = 63 - __builtin_clzll(duration);
+		const size_t shift = exponent - SUB_BUCKETS_BITS;
+		return SUB_BUCKETS + shift * SUB_BUCKETS + ((duration >> shift) & (SUB_BUCKETS - 1));
+	}
+
+	static uint64_t get_lower_bound(size_t bucket) {
+		if (bucket < SUB_BUCKETS) {
+			return bucket;
+		}
+		const size_t shift = (bucket - SUB_BUCKETS) / SUB_BUCKETS;
+		const uint64_t mantissa = SUB_BUCKETS + (bucket - SUB_BUCKETS) % SUB_BUCKETS;
+		return mantissa << shift;
+	}
+
+private:
+	std::vector<uint64_t> counts;
+	uint64_t total;
+};
+
+/*!
+ * \brief Aggregated measurements of single call path
+ */
+struct path_stats_t {
+	path_stats_t(): calls(0), total_time(0), self_time(0), max_time(0) {}
+
+	void add(int64_t duration, int64_t children_time) {
+		++calls;
+		total_time += duration;
+		self_time += duration - children_time;
+		max_time = std::max(max_time, duration);
+		histogram.add(duration);
+	}
+
+	void merge(const path_stats_t &other) {
+		calls += other.calls;
+		total_time += other.total_time;
+		self_time += other.self_time;
+		max_time = std::max(max_time, other.max_time);
+		histogram.merge(other.histogram);
+	}
+
+	/*!
+	 * \brief Number of nodes with this call path
+	 */
+	uint64_t calls;
+
+	/*!
+	 * \brief Sum of node durations in nanoseconds
+	 */
+	int64_t total_time;
+
+	/*!
+	 * \brief Sum of node durations without time of child nodes in nanoseconds
+	 */
+	int64_t self_time;
+
+	/*!
+	 * \brief Duration of the longest node in nanoseconds
+	 */
+	int64_t max_time;
+
+	/*!
+	 * \brief Distribution of node durations
+	 */
+	duration_histogram_t histogram;
+};
+
+/*!
+ * \brief Tree from the list of the slowest trees
+ */
+struct slow_tree_t {
+	slow_tree_t(): duration(0) {}
+
+	bool operator <(const slow_tree_t &other) const {
+		return duration > other.duration;
+	}
+
+	/*!
+	 * \brief Hex id of the tree, empty if tree has no id
+	 */
+	std::string id;
+
+	/*!
+	 * \brief Time from start of the first top level action to stop of the last one in nanoseconds
+	 */
+	int64_t duration;
+};
+
+/*!
+ * \brief Handler of tree_reader_t that aggregates nodes by their call path from the root and by action
+ *
+ * Call paths are interned as (parent path, action) pairs, so node processing doesn't allocate
+ * once all paths were seen.
+ */
+class profile_t {
+public:
+	static const int NO_PARENT = -1;
+
+	struct path_t {
+		int parent;
+		int action_id;
+		path_stats_t stats;
+	};
+
+	profile_t(): trees(0), errors(0), slow_trees_limit(0), tree_start(0), tree_stop(0) {}
+
+	/*!
+	 * \brief Sets number of the slowest trees that are kept, 0 disables tracking
+	 */
+	void set_slow_trees_limit(size_t limit) {
+		slow_trees_limit = limit;
+	}
+
+	size_t get_slow_trees_limit() const {
+		return slow_trees_limit;
+	}
+
+	void tree_begin() {
+		stack.clear();
+		tree_start = std::numeric_limits<int64_t>::max();
+		tree_stop = std::numeric_limits<int64_t>::min();
+	}
+
+	void node_enter(int action_id, int64_t start_time, int64_t stop_time) {
+		if (stack.empty()) {
+			tree_start = std::min(tree_start, start_time);
+			tree_stop = std::max(tree_stop, stop_time);
+		}
+
+		frame_t frame;
+		frame.action_id = action_id;
+		frame.path = get_path(stack.empty() ? NO_PARENT : stack.back().path, action_id);
+		frame.duration = stop_time - start_time;
+		frame.children_time = 0;
+		stack.push_back(frame);
+	}
+
+	void node_exit() {
+		const frame_t frame = stack.back();
+		stack.pop_back();
+
+		paths[frame.path].stats.add(frame.duration, frame.children_time);
+		if (actions.size() <= static_cast<size_t>(frame.action_id)) {
+			actions.resize(frame.action_id + 1);
+		}
+		actions[frame.action_id].add(frame.duration, frame.children_time);
+
+		if (!stack.empty()) {
+			stack.back().children_time += frame.duration;
+		}
+	}
+
+	void stat(const char *, size_t, const json_value_t &) {}
+
+	void tree_end(const tree_info_t &info) {
+		++trees;
+
+		const int64_t duration = tree_stop > tree_start ? tree_stop - tree_start : 0;
+		if (slow_trees_limit && (slow_trees.size() < slow_trees_limit || duration > slow_trees.front().duration)) {
+			slow_tree_t tree;
+			tree.id = info.id;
+			tree.duration = duration;
+			add_slow_tree(tree);
+		}
+	}
+
+	/*!
+	 * \brief Reads all trees from file at \a path, counts documents that failed to parse as errors
+	 */
+	void load_file(const std::string &path) {
+		mapped_file_t file(path);
+		load_range(file.begin(), file.end(), file.begin(), file.end());
+	}
+
+	/*!
+	 * \brief Reads trees that start in [\a range_begin, \a range_end) of [\a data_begin, \a data_end)
+	 */
+	void load_range(const char *data_begin, const char *data_end,
+			const char *range_begin, const char *range_end) {
+		tree_reader_t<profile_t> reader(*this, names);
+		errors += reader.parse_range(data_begin, data_end, range_begin, range_end);
+	}
+
+	/*!
+	 * \brief Adds all paths of \a other, action ids are matched by names
+	 */
+	void merge(const profile_t &other) {
+		std::vector<int> actions_map(other.names.size());
+		for (size_t i = 0; i < other.names.size(); ++i) {
+			const std::string &name = other.names.get_name(i);
+			actions_map[i] = names.intern(name.data(), name.size());
+		}
+
+		// Parents are always interned before their children
+		std::vector<int> paths_map(other.paths.size());
+		for (size_t i = 0; i < other.paths.size(); ++i) {
+			const path_t &path = other.paths[i];
+			const int parent = path.parent == NO_PARENT ? NO_PARENT : paths_map[path.parent];
+			paths_map[i] = get_path(parent, actions_map[path.action_id]);
+			paths[paths_map[i]].stats.merge(path.stats);
+		}
+
+		for (size_t i = 0; i < other.actions.size(); ++i) {
+			if (actions.size() <= static_cast<size_t>(actions_map[i])) {
+				actions.resize(actions_map[i] + 1);
+			}
+			actions[actions_map[i]].merge(other.actions[i]);
+		}
+
+		slow_trees_limit = std::max(slow_trees_limit, other.slow_trees_limit);
+		for (auto it = other.slow_trees.begin(); it != other.slow_trees.end(); ++it) {
+			add_slow_tree(*it);
+		}
+
+		trees += other.trees;
+		errors += other.errors;
+	}
+
+	/*!
+	 * \brief Returns path name: action names from the root joined with ';'
+	 */
+	std::string get_path_name(int path) const {
+		std::vector<int> actions;
+		for (; path != NO_PARENT; path = paths[path].parent) {
+			actions.push_back(paths[path].action_id);
+		}
+
+		std::string name;
+		for (auto it = actions.rbegin(); it != actions.rend(); ++it) {
+			if (!name.empty()) {
+				name += ';';
+			}
+			name += names.get_name(*it);
+		}
+		return name;
+	}
+
+	const std::vector<path_t> &get_paths() const {
+		return paths;
+	}
+
+	/*!
+	 * \brief Returns stats of actions indexed by action id, nodes of recursive actions are counted on every level
+	 */
+	const std::vector<path_stats_t> &get_actions() const {
+		return actions;
+	}
+
+	/*!
+	 * \brief Returns the slowest trees sorted by decreasing duration
+	 */
+	std::vector<slow_tree_t> get_slow_trees() const {
+		std::vector<slow_tree_t> result(slow_trees);
+		std::sort(result.begin(), result.end());
+		return result;
+	}
+
+	names_table_t &get_names() {
+		return names;
+	}
+
+	const names_table_t &get_names() const {
+		return names;
+	}
+
+	/*!
+	 * \brief Returns number of read trees
+	 */
+	uint64_t get_trees_count() const {
+		return trees;
+	}
+
+	/*!
+	 * \brief Returns number of documents that failed to parse
+	 */
+	uint64_t get_errors_count() const {
+		return errors;
+	}
+
+private:
+	struct frame_t {
+		int action_id;
+		int path;
+		int64_t duration;
+		int64_t children_time;
+	};
+
+	int get_path(int parent, int action_id) {
+		const uint64_t key = (static_cast<uint64_t>(parent + 1) << 32) | static_cast<uint32_t>(action_id);
+		auto it = paths_index.find(key);
+		if (it != paths_index.end()) {
+			return it->second;
+		}
+
+		path_t path;
+		path.parent = parent;
+		path.action_id = action_id;
+		paths.push_back(path);
+		paths_index.insert(std::make_pair(key, static_cast<int>(paths.size() - 1)));
+		return paths.size() - 1;
+	}
+
+	/*!
+	 * \brief Keeps slow_trees a min-heap by duration of at most slow_trees_limit trees
+	 */
+	void add_slow_tree(const slow_tree_t &tree) {
+		if (slow_trees.size() < slow_trees_limit) {
+			slow_trees.push_back(tree);
+			std::push_heap(slow_trees.begin(), slow_trees.end());
+		} else if (!slow_trees.empty() && tree.duration > slow_trees.front().duration) {
+			std::pop_heap(slow_trees.begin(), slow_trees.end());
+			slow_trees.back() = tree;
+			std::push_heap(slow_trees.begin(), slow_trees.end());
+		}
+	}
+
+	names_table_t names;
+	std::vector<path_t> paths;
+	std::vector<path_stats_t> actions;
+	std::unordered_map<uint64_t, int> paths_index;
+	std::vector<frame_t> stack;
+	uint64_t trees;
+	uint64_t errors;
+	size_t slow_trees_limit;
+	std::vector<slow_tree_t> slow_trees;
+	int64_t tree_start;
+	int64_t tree_stop;
+};
+
+}} // namespace react::tools
+
+#endif // REACT_TOOLS_PATH_STATS_HPP
@@ -0,0 +1,260 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "rapidjson/prettywriter.h"
+#include "rapidjson/stringbuffer.h"
+
+#include "report.hpp"
+
+using namespace react;
+using namespace react::tools;
+
+namespace {
+
+/*!
+ * \brief Inputs are split into ranges of at least this size
+ */
+const size_t MIN_RANGE_SIZE = 4 << 20;
+
+/*!
+ * \brief Number of ranges per worker, so that workers that got sparse ranges help others
+ */
+const size_t RANGES_PER_WORKER = 4;
+
+/*!
+ * \brief Part of input file processed by single worker
+ */
+struct range_t {
+	const mapped_file_t *file;
+	const char *begin;
+	const char *end;
+};
+
+void usage(const char *program) {
+	std::cerr << "Usage: " << program << " [--json] [-j THREADS] [--limit N] [--slowest N] FILE..." << std::endl
+	          << "Computes per action and per call path stats of trees written by react aggregators." << std::endl
+	          << "  -j THREADS   number of worker threads (default - number of cores)" << std::endl
+	          << "  --limit N    print only N paths with the largest total time (default 50, 0 - all)" << std::endl
+	          << "  --slowest N  print N slowest trees (default 10)" << std::endl
+	          << "  --json       print result as json" << std::endl;
+}
+
+std::vector<range_t> split(const std::vector<std::unique_ptr<mapped_file_t>> &files, size_t workers) {
+	std::vector<range_t> ranges;
+	for (auto it = files.begin(); it != files.end(); ++it) {
+		const mapped_file_t &file = **it;
+		const size_t size = file.end() - file.begin();
+		const size_t range_size = std::max(MIN_RANGE_SIZE, size / (workers * RANGES_PER_WORKER) + 1);
+
+		for (size_t offset = 0; offset < size; offset += range_size) {
+			range_t range;
+			range.file = &file;
+			range.begin = file.begin() + offset;
+			range.end = file.begin() + std::min(size, offset + range_size);
+			ranges.push_back(range);
+		}
+	}
+	return ranges;
+}
+
+/*!
+ * \brief Processes ranges in parallel, every worker aggregates its own profile, they are merged at the end
+ */
+void analyze(const std::vector<range_t> &ranges, size_t workers_count, profile_t &result) {
+	std::vector<profile_t> profiles(workers_count);
+	std::atomic<size_t> next_range(0);
+
+	std::vector<std::thread> workers;
+	for (size_t i = 0; i < workers_count; ++i) {
+		profiles[i].set_slow_trees_limit(result.get_slow_trees_limit());
+		workers.push_back(std::thread([&ranges, &next_range, &profiles, i] () {
+			for (size_t index = next_range++; index < ranges.size(); index = next_range++) {
+				const range_t &range = ranges[index];
+				profiles[i].load_range(range.file->begin(), range.file->end(), range.begin, range.end);
+			}
+		}));
+	}
+
+	for (auto it = workers.begin(); it != workers.end(); ++it) {
+		it->join();
+	}
+
+	for (auto it = profiles.begin(); it != profiles.end(); ++it) {
+		result.merge(*it);
+	}
+}
+
+template<typename Writer>
+void write_named_stats(Writer &writer, const char *key, const char *name_key,
+		const std::vector<named_stats_t> &stats) {
+	writer.String(key);
+	writer.StartArray();
+	for (auto it = stats.begin(); it != stats.end(); ++it) {
+		writer.StartObject();
+		writer.String(name_key);
+		writer.String(it->name.c_str(), it->name.size());
+		write_stats_members(writer, *it->stats);
+		writer.EndObject();
+	}
+	writer.EndArray();
+}
+
+void print_json(const profile_t &profile, size_t limit) {
+	rapidjson::StringBuffer buffer;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+
+	writer.StartObject();
+	writer.String("time_unit");
+	writer.String("ns");
+	writer.String("trees");
+	writer.Uint64(profile.get_trees_count());
+	writer.String("errors");
+	writer.Uint64(profile.get_errors_count());
+	write_named_stats(writer, "actions", "name", get_actions(profile));
+	write_named_stats(writer, "paths", "path", get_paths(profile, limit));
+
+	writer.String("slowest_trees");
+	writer.StartArray();
+	const std::vector<slow_tree_t> slow_trees = profile.get_slow_trees();
+	for (auto it = slow_trees.begin(); it != slow_trees.end(); ++it) {
+		writer.StartObject();
+		writer.String("id");
+		writer.String(it->id.c_str(), it->id.size());
+		writer.String("duration");
+		writer.Int64(it->duration);
+		writer.EndObject();
+	}
+	writer.EndArray();
+	writer.EndObject();
+
+	std::cout << buffer.GetString() << std::endl;
+}
+
+void print_named_stats(const char *title, const std::vector<named_stats_t> &stats) {
+	printf("%-6s %12s %10s %10s %10s %10s %10s %10s %10s  %s\n",
+		"", "calls", "total", "self", "mean", "p50", "p90", "p99", "max", title);
+	for (auto it = stats.begin(); it != stats.end(); ++it) {
+		const path_stats_t &value = *it->stats;
+		printf("%-6s %12llu %10s %10s %10s %10s %10s %10s %10s  %s\n", "",
+			static_cast<unsigned long long>(value.calls),
+			format_time(value.total_time).c_str(),
+			format_time(value.self_time).c_str(),
+			format_time(value.calls ? static_cast<double>(value.total_time) / value.calls : 0).c_str(),
+			format_time(value.histogram.get_quantile(0.5)).c_str(),
+			format_time(value.histogram.get_quantile(0.9)).c_str(),
+			format_time(value.histogram.get_quantile(0.99)).c_str(),
+			format_time(value.max_time).c_str(),
+			it->name.c_str());
+	}
+	printf("\n");
+}
+
+void print_text(const profile_t &profile, size_t limit) {
+	printf("trees: %llu, malformed: %llu\n\n",
+		static_cast<unsigned long long>(profile.get_trees_count()),
+		static_cast<unsigned long long>(profile.get_errors_count()));
+
+	print_named_stats("action", get_actions(profile));
+	print_named_stats("path", get_paths(profile, limit));
+
+	const std::vector<slow_tree_t> slow_trees = profile.get_slow_trees();
+	if (!slow_trees.empty()) {
+		printf("%-6s %12s  %s\n", "", "duration", "slowest trees");
+		for (auto it = slow_trees.begin(); it != slow_trees.end(); ++it) {
+			printf("%-6s %12s  %s\n", "", format_time(it->duration).c_str(),
+				it->id.empty() ? "-" : it->id.c_str());
+		}
+	}
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	std::vector<std::string> paths;
+	bool json = false;
+	size_t limit = 50;
+	size_t slowest = 10;
+	size_t workers_count = std::max(1u, std::thread::hardware_concurrency());
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "--json")) {
+			json = true;
+		} else if (!strcmp(argv[i], "-j") && i + 1 < argc) {
+			workers_count = std::max(1ul, strtoul(argv[++i], NULL, 10));
+		} else if (!strcmp(argv[i], "--limit") && i + 1 < argc) {
+			limit = strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "--slowest") && i + 1 < argc) {
+			slowest = strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+			usage(argv[0]);
+			return 0;
+		} else if (argv[i][0] != '-') {
+			paths.push_back(argv[i]);
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (paths.empty()) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	std::vector<std::unique_ptr<mapped_file_t>> files;
+	size_t total_size = 0;
+	try {
+		for (auto it = paths.begin(); it != paths.end(); ++it) {
+			files.push_back(std::unique_ptr<mapped_file_t>(new mapped_file_t(*it)));
+			total_size += files.back()->end() - files.back()->begin();
+		}
+	} catch (const std::exception &e) {
+		std::cerr << "react-analyze: " << e.what() << std::endl;
+		return 1;
+	}
+
+	const std::vector<range_t> ranges = split(files, workers_count);
+	workers_count = std::max<size_t>(1, std::min(workers_count, ranges.size()));
+
+	profile_t profile;
+	profile.set_slow_trees_limit(slowest);
+
+	const auto start = std::chrono::steady_clock::now();
+	analyze(ranges, workers_count, profile);
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	std::cerr << "react-analyze: read " << (total_size >> 20) << " MB with " << workers_count
+	          << " threads in " << seconds << " s" << std::endl;
+
+	if (json) {
+		print_json(profile, limit);
+	} else {
+		print_text(profile, limit);
+	}
+
+	return 0;
+}
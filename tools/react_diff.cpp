@@ -0,0 +1,242 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "rapidjson/prettywriter.h"
+#include "rapidjson/stringbuffer.h"
+
+#include "report.hpp"
+
+using namespace react;
+using namespace react::tools;
+
+namespace {
+
+/*!
+ * \brief Call path present in at least one of compared profiles
+ */
+struct path_diff_t {
+	path_diff_t(): before(NULL), after(NULL), impact(0) {}
+
+	std::string name;
+	const path_stats_t *before;
+	const path_stats_t *after;
+
+	/*!
+	 * \brief Change of total time per tree in nanoseconds
+	 */
+	double impact;
+};
+
+void usage(const char *program) {
+	std::cerr << "Usage: " << program << " [--json] [--limit N] -a FILE... -b FILE..." << std::endl
+	          << "Compares call trees written by react aggregators (json or json lines)." << std::endl
+	          << "  -a FILE...   files of baseline profile" << std::endl
+	          << "  -b FILE...   files of compared profile" << std::endl
+	          << "  --limit N    print only N paths with the largest change (default 50, 0 - all)" << std::endl
+	          << "  --json       print result as json" << std::endl;
+}
+
+double per_tree(const path_stats_t *stats, const profile_t &profile, int64_t path_stats_t::*field) {
+	if (!stats || !profile.get_trees_count()) {
+		return 0;
+	}
+	return static_cast<double>(stats->*field) / profile.get_trees_count();
+}
+
+std::vector<path_diff_t> compare(const profile_t &before, const profile_t &after) {
+	std::map<std::string, path_diff_t> diffs;
+
+	for (size_t i = 0; i < before.get_paths().size(); ++i) {
+		path_diff_t &diff = diffs[before.get_path_name(i)];
+		diff.before = &before.get_paths()[i].stats;
+	}
+	for (size_t i = 0; i < after.get_paths().size(); ++i) {
+		path_diff_t &diff = diffs[after.get_path_name(i)];
+		diff.after = &after.get_paths()[i].stats;
+	}
+
+	std::vector<path_diff_t> result;
+	result.reserve(diffs.size());
+	for (auto it = diffs.begin(); it != diffs.end(); ++it) {
+		path_diff_t diff = it->second;
+		diff.name = it->first;
+		diff.impact = per_tree(diff.after, after, &path_stats_t::total_time) -
+		              per_tree(diff.before, before, &path_stats_t::total_time);
+		result.push_back(diff);
+	}
+
+	std::stable_sort(result.begin(), result.end(), [] (const path_diff_t &lhs, const path_diff_t &rhs) {
+		return std::fabs(lhs.impact) > std::fabs(rhs.impact);
+	});
+	return result;
+}
+
+template<typename Writer>
+void write_side(Writer &writer, const char *name, const path_stats_t *stats, const profile_t &profile) {
+	writer.String(name);
+	if (!stats) {
+		writer.Null();
+		return;
+	}
+
+	writer.StartObject();
+	write_stats_members(writer, *stats);
+	writer.String("total_time_per_tree");
+	writer.Double(per_tree(stats, profile, &path_stats_t::total_time));
+	writer.String("self_time_per_tree");
+	writer.Double(per_tree(stats, profile, &path_stats_t::self_time));
+	writer.EndObject();
+}
+
+void print_json(const std::vector<path_diff_t> &diffs, size_t limit,
+		const profile_t &before, const profile_t &after) {
+	rapidjson::StringBuffer buffer;
+	rapidjson::PrettyWriter<rapidjson::StringBuffer> writer(buffer);
+
+	writer.StartObject();
+	writer.String("time_unit");
+	writer.String("ns");
+	writer.String("trees_before");
+	writer.Uint64(before.get_trees_count());
+	writer.String("trees_after");
+	writer.Uint64(after.get_trees_count());
+	writer.String("paths");
+	writer.StartArray();
+	for (size_t i = 0; i < diffs.size() && (!limit || i < limit); ++i) {
+		const path_diff_t &diff = diffs[i];
+		writer.StartObject();
+		writer.String("path");
+		writer.String(diff.name.c_str(), diff.name.size());
+		writer.String("impact");
+		writer.Double(diff.impact);
+		write_side(writer, "before", diff.before, before);
+		write_side(writer, "after", diff.after, after);
+		writer.EndObject();
+	}
+	writer.EndArray();
+	writer.EndObject();
+
+	std::cout << buffer.GetString() << std::endl;
+}
+
+std::string format_change(double before, double after) {
+	if (before == 0) {
+		return after == 0 ? "0%" : "new";
+	}
+	char buffer[32];
+	snprintf(buffer, sizeof(buffer), "%+.1f%%", (after - before) * 100 / before);
+	return buffer;
+}
+
+void print_text(const std::vector<path_diff_t> &diffs, size_t limit,
+		const profile_t &before, const profile_t &after) {
+	printf("trees: %llu -> %llu\n\n",
+		static_cast<unsigned long long>(before.get_trees_count()),
+		static_cast<unsigned long long>(after.get_trees_count()));
+	printf("%12s %8s %21s %21s %21s %21s  %s\n",
+		"impact/tree", "change", "total/tree", "self/tree", "calls", "p50 / p99 (after)", "path");
+
+	for (size_t i = 0; i < diffs.size() && (!limit || i < limit); ++i) {
+		const path_diff_t &diff = diffs[i];
+		const double total_before = per_tree(diff.before, before, &path_stats_t::total_time);
+		const double total_after = per_tree(diff.after, after, &path_stats_t::total_time);
+		const double self_before = per_tree(diff.before, before, &path_stats_t::self_time);
+		const double self_after = per_tree(diff.after, after, &path_stats_t::self_time);
+		const unsigned long long calls_before = diff.before ? diff.before->calls : 0;
+		const unsigned long long calls_after = diff.after ? diff.after->calls : 0;
+		const path_stats_t *latest = diff.after ? diff.after : diff.before;
+
+		printf("%12s %8s %10s>%10s %10s>%10s %10llu>%10llu %10s/%10s  %s\n",
+			format_time(diff.impact).c_str(),
+			format_change(total_before, total_after).c_str(),
+			format_time(total_before).c_str(), format_time(total_after).c_str(),
+			format_time(self_before).c_str(), format_time(self_after).c_str(),
+			calls_before, calls_after,
+			format_time(latest->histogram.get_quantile(0.5)).c_str(),
+			format_time(latest->histogram.get_quantile(0.99)).c_str(),
+			diff.name.c_str());
+	}
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+	std::vector<std::string> files_before, files_after;
+	std::vector<std::string> *files = NULL;
+	bool json = false;
+	size_t limit = 50;
+
+	for (int i = 1; i < argc; ++i) {
+		if (!strcmp(argv[i], "-a")) {
+			files = &files_before;
+		} else if (!strcmp(argv[i], "-b")) {
+			files = &files_after;
+		} else if (!strcmp(argv[i], "--json")) {
+			json = true;
+		} else if (!strcmp(argv[i], "--limit") && i + 1 < argc) {
+			limit = strtoul(argv[++i], NULL, 10);
+		} else if (!strcmp(argv[i], "-h") || !strcmp(argv[i], "--help")) {
+			usage(argv[0]);
+			return 0;
+		} else if (files && argv[i][0] != '-') {
+			files->push_back(argv[i]);
+		} else {
+			usage(argv[0]);
+			return 1;
+		}
+	}
+
+	if (files_before.empty() || files_after.empty()) {
+		usage(argv[0]);
+		return 1;
+	}
+
+	profile_t before, after;
+	try {
+		for (auto it = files_before.begin(); it != files_before.end(); ++it) {
+			before.load_file(*it);
+		}
+		for (auto it = files_after.begin(); it != files_after.end(); ++it) {
+			after.load_file(*it);
+		}
+	} catch (const std::exception &e) {
+		std::cerr << "react-diff: " << e.what() << std::endl;
+		return 1;
+	}
+
+	if (before.get_errors_count() || after.get_errors_count()) {
+		std::cerr << "react-diff: skipped " << before.get_errors_count() + after.get_errors_count()
+		          << " malformed trees" << std::endl;
+	}
+
+	std::vector<path_diff_t> diffs = compare(before, after);
+	if (json) {
+		print_json(diffs, limit, before, after);
+	} else {
+		print_text(diffs, limit, before, after);
+	}
+
+	return 0;
+}
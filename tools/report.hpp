@@ -0,0 +1,131 @@
+/*
+* 2014+ Copyright (c) Andrey Kashin <kashin.andrej@gmail.com>
+* All rights reserved.
+*
+* This program is free software; you can redistribute it and/or modify
+* it under the terms of the GNU Lesser General Public License as published by
+* the Free Software Foundation; either version 2 of the License, or
+* (at your option) any later version.
+*
+* This program is distributed in the hope that it will be useful,
+* but WITHOUT ANY WARRANTY; without even the implied warranty of
+* MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+* GNU Lesser General Public License for more details.
+*/
+
+#ifndef REACT_TOOLS_REPORT_HPP
+#define REACT_TOOLS_REPORT_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "path_stats.hpp"
+
+namespace react { namespace tools {
+
+/*!
+ * \brief Quantiles of durations included into reports
+ */
+const double REPORT_QUANTILES[] = {0.5, 0.9, 0.99};
+const char * const REPORT_QUANTILE_NAMES[] = {"p50", "p90", "p99"};
+const size_t REPORT_QUANTILES_COUNT = sizeof(REPORT_QUANTILES) / sizeof(REPORT_QUANTILES[0]);
+
+/*!
+ * \brief Formats duration in nanoseconds with the most suitable unit
+ */
+inline std::string format_time(double ns) {
+	char buffer[32];
+	const double value = std::fabs(ns);
+	if (value >= 1e9) {
+		snprintf(buffer, sizeof(buffer), "%.2fs", ns / 1e9);
+	} else if (value >= 1e6) {
+		snprintf(buffer, sizeof(buffer), "%.2fms", ns / 1e6);
+	} else if (value >= 1e3) {
+		snprintf(buffer, sizeof(buffer), "%.2fus", ns / 1e3);
+	} else {
+		snprintf(buffer, sizeof(buffer), "%.0fns", ns);
+	}
+	return buffer;
+}
+
+/*!
+ * \brief Writes members of json object with \a stats, times are in nanoseconds
+ */
+template<typename Writer>
+void write_stats_members(Writer &writer, const path_stats_t &stats) {
+	writer.String("calls");
+	writer.Uint64(stats.calls);
+	writer.String("total_time");
+	writer.Int64(stats.total_time);
+	writer.String("self_time");
+	writer.Int64(stats.self_time);
+	writer.String("max_time");
+	writer.Int64(stats.max_time);
+	for (size_t i = 0; i < REPORT_QUANTILES_COUNT; ++i) {
+		writer.String(REPORT_QUANTILE_NAMES[i]);
+		writer.Int64(stats.histogram.get_quantile(REPORT_QUANTILES[i]));
+	}
+}
+
+/*!
+ * \brief Stats of action or call path with its name, ordered by descending total time
+ */
+struct named_stats_t {
+	std::string name;
+	const path_stats_t *stats;
+
+	/*!
+	 * \brief Index of action or path in profile
+	 */
+	size_t index;
+
+	bool operator <(const named_stats_t &other) const {
+		return stats->total_time > other.stats->total_time;
+	}
+};
+
+/*!
+ * \brief Returns stats of actions that were called, sorted by total time
+ */
+inline std::vector<named_stats_t> get_actions(const profile_t &profile) {
+	std::vector<named_stats_t> result;
+	for (size_t i = 0; i < profile.get_actions().size(); ++i) {
+		if (profile.get_actions()[i].calls) {
+			named_stats_t action = {profile.get_names().get_name(i), &profile.get_actions()[i], i};
+			result.push_back(action);
+		}
+	}
+	std::sort(result.begin(), result.end());
+	return result;
+}
+
+/*!
+ * \brief Returns stats of \a limit call paths with the largest total time, all paths if \a limit is 0
+ */
+inline std::vector<named_stats_t> get_paths(const profile_t &profile, size_t limit) {
+	std::vector<named_stats_t> result;
+	for (size_t i = 0; i < profile.get_paths().size(); ++i) {
+		named_stats_t path = {std::string(), &profile.get_paths()[i].stats, i};
+		result.push_back(path);
+	}
+
+	if (limit && limit < result.size()) {
+		std::partial_sort(result.begin(), result.begin() + limit, result.end());
+		result.resize(limit);
+	} else {
+		std::sort(result.begin(), result.end());
+	}
+
+	// Names are built only for printed paths
+	for (auto it = result.begin(); it != result.end(); ++it) {
+		it->name = profile.get_path_name(it->index);
+	}
+	return result;
+}
+
+}} // namespace react::tools
+
+#endif // REACT_TOOLS_REPORT_HPP
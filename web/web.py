@@ -89,6 +89,14 @@ else:
     print("Unknown argument 1")
     sys.exit(1)
 
+# Action times are normalized to microseconds, trees may use other units
+time_unit_scales = {'ns': 0.001, 'us': 1, 'ms': 1000}
+
+
+def get_time_scale(tree):
+    return time_unit_scales.get(tree.get('time_unit', 'us'), 1)
+
+
 def process_tree(tree):
     tree_id = tree['id']
     global trees
@@ -100,7 +108,7 @@ def process_tree(tree):
     actions = []
     main_action_name = tree['actions'][0]['name']
     last_actions_trees[main_action_name] = tree
-    get_actions(tree, actions, 0, True)
+    get_actions(tree, actions, 0, True, get_time_scale(tree))
     for action in actions:
         action_name = action['name']
         if not action_name in actions_with_name:
@@ -119,22 +127,22 @@ def process_tree(tree):
 
 
 
-def get_actions(tree, actions, delta, root):
+def get_actions(tree, actions, delta, root, scale):
     if not root:
         actions.append({"name": tree['name'],
-                        "startTime": tree['start_time'] - delta,
-                        "endTime": tree['stop_time'] - delta,
+                        "startTime": (tree['start_time'] - delta) * scale,
+                        "endTime": (tree['stop_time'] - delta) * scale,
                         "color": "#%06x" % randint(0, 0xFFFFFF)})
 
     if 'actions' in tree:
         for action in tree['actions']:
-            get_actions(action, actions, delta, False)
+            get_actions(action, actions, delta, False, scale)
 
 
 def render_tree(tree):
     actions = []
     delta = tree['actions'][0]['start_time']
-    get_actions(tree, actions, delta, True)
+    get_actions(tree, actions, delta, True, get_time_scale(tree))
 
     if 'mapped_size' in tree:
         mapped_size = tree['mapped_size']